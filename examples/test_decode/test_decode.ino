@@ -631,6 +631,120 @@ bool test_pair2()
 	return false;
 }
 
+bool test_array_index()
+{
+	uint8_t cbor_data[] = {0x98, 0x19, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06,  \
+								0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, \
+								0x0f, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, \
+								0x17, 0x18, 0x18, 0x18, 0x19};
+	CBOR cbor = CBOR(cbor_data, 29, true);
+
+	if (!cbor.build_index()) {
+		return false;
+	}
+
+	for (int i=24 ; i >= 0 ; --i) {
+		if ((int)cbor[i] != (i+1)) {
+			return false;
+		}
+	}
+
+	return cbor.at(25).is_null();
+}
+
+bool test_pair_index()
+{
+	const uint8_t cbor_data[] = {0xa3, 0x61, 0x61, 0x82, 0x01, 0x02, 0x61, 0x62, \
+								0x18, 0x20, 0x61, 0x63, 0xf5};
+	CBOR cbor = CBOR(cbor_data, 13);
+
+	cbor.use_index();
+
+	if (cbor.key_at(2).to_string() != "c" || !(bool)cbor.at(2)) {
+		return false;
+	}
+
+	if (cbor.key_at(1).to_string() != "b" || (int)cbor.at(1) != 32) {
+		return false;
+	}
+
+	if (cbor.key_at(0).to_string() != "a" || (int)cbor.at(0)[1] != 2) {
+		return false;
+	}
+
+	return true;
+}
+
+bool test_pair_key_index()
+{
+	const uint8_t cbor_data[] = {0xa5, 0x61, 0x61, 0x61, 0x41, 0x61, 0x62, 0x61, \
+								0x42, 0x61, 0x63, 0x61, 0x43, 0x01, 0x61, 0x44, \
+								0x61, 0x61, 0x61, 0x45};
+	CBOR cbor = CBOR(cbor_data, 20);
+	size_t table[8];
+
+	if (!cbor.build_key_index(table, 8)) {
+		return false;
+	}
+
+	//Duplicate key "a": the first value is returned
+	if (cbor["a"].to_string() != "A" || cbor["b"].to_string() != "B" \
+		|| cbor["c"].to_string() != "C" || cbor[1].to_string() != "D") {
+		return false;
+	}
+
+	if (!cbor["d"].is_null() || !cbor[2].is_null()) {
+		return false;
+	}
+
+	//Table too small
+	return !cbor.build_key_index(table, 4);
+}
+
+bool test_array_iterator()
+{
+	const uint8_t cbor_data[] = {0x83, 0x01, 0x82, 0x02, 0x03, 0x64, 0x74, 0x65, 0x73, 0x74};
+	CBOR cbor = CBOR(cbor_data, 10);
+	size_t i = 0;
+
+	for (CBOR ele : cbor) {
+		if ((i == 0 && (int)ele != 1) || (i == 1 && (int)ele[1] != 3) \
+			|| (i == 2 && ele.to_string() != "test")) {
+			return false;
+		}
+		++i;
+	}
+
+	//Not a composed object: nothing to iterate
+	CBOR scalar = CBOR(1);
+	for (CBOR ele : scalar) {
+		return false;
+	}
+
+	return (i == 3);
+}
+
+bool test_pair_iterator()
+{
+	const uint8_t cbor_data[] = {0xa3, 0x61, 0x61, 0x01, 0x61, 0x62, 0x82, 0x02, \
+								0x03, 0x61, 0x63, 0x03};
+	CBOR cbor = CBOR(cbor_data, 12);
+	const char* keys[] = {"a", "b", "c"};
+	size_t i = 0;
+
+	for (const CBOR::pair_iterator &it : cbor.pairs()) {
+		if (it.key().to_string() != keys[i]) {
+			return false;
+		}
+		if ((i != 1 && (int)it.value() != (int)(i+1)) || (i == 1 && !it.value().is_array())) {
+			return false;
+		}
+		++i;
+	}
+
+	return (i == 3);
+}
+
 bool test_tag()
 {
 	const uint8_t cbor_data[6] = {0xC4, 0x82, 0x21, 0x19, 0x6A, 0xB3};
@@ -692,6 +806,857 @@ bool test_bytestr1()
 	return false;
 }
 
+void append_num(String &str, unsigned long long value)
+{
+	char digits[21];
+	int n = 0;
+
+	do {
+		digits[n++] = '0' + (value % 10);
+		value /= 10;
+	} while (value > 0);
+
+	while (n > 0) {
+		str += digits[--n];
+	}
+}
+
+//! Feed a message to a CBORParser in chunks, and record its events.
+bool parse_chunks(const uint8_t *buffer, size_t buffer_len, size_t chunk_size, String &trace)
+{
+	CBORParser parser;
+	uint8_t status = CBOR_PARSER_NEED_MORE;
+
+	for (size_t offset=0 ; offset < buffer_len ; offset += chunk_size) {
+		size_t len = ((buffer_len - offset) < chunk_size)?(buffer_len - offset):chunk_size;
+
+		parser.feed(buffer + offset, len);
+		while ((status = parser.next()) == CBOR_PARSER_EVENT) {
+			switch (parser.event()) {
+				case CBOR_EVENT_UINT:
+					append_num(trace, parser.get_uint());
+					break;
+				case CBOR_EVENT_NEGINT:
+					trace += '-';
+					append_num(trace, -(parser.get_int() + 1) + 1);
+					break;
+				case CBOR_EVENT_FLOAT:
+					trace += 'f';
+					append_num(trace, (unsigned long long)(parser.get_float()*10));
+					break;
+				case CBOR_EVENT_TEXT:
+					if (parser.is_indefinite()) {
+						trace += '(';
+					}
+					for (size_t i=0 ; i < parser.data_len() ; ++i) {
+						trace += (char)parser.data()[i];
+					}
+					break;
+				case CBOR_EVENT_BYTES:
+					if (parser.is_indefinite()) {
+						trace += '(';
+					}
+					for (size_t i=0 ; i < parser.data_len() ; ++i) {
+						trace += 'A' + parser.data()[i];
+					}
+					break;
+				case CBOR_EVENT_ARRAY:
+					trace += '[';
+					break;
+				case CBOR_EVENT_MAP:
+					trace += '{';
+					break;
+				case CBOR_EVENT_TAG:
+					trace += '#';
+					append_num(trace, parser.get_uint());
+					break;
+				case CBOR_EVENT_SIMPLE:
+					trace += parser.is_null()?'N':(parser.get_bool()?'T':'F');
+					break;
+				case CBOR_EVENT_END:
+					trace += ']';
+					break;
+			}
+
+			//Strings may be split in several chunks
+			if (parser.string_remaining() == 0) {
+				trace += ' ';
+			}
+		}
+
+		if (status == CBOR_PARSER_ERROR) {
+			return false;
+		}
+	}
+
+	return (parser.depth() == 0);
+}
+
+bool test_parser()
+{
+	const uint8_t bytes[] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19};
+	const char *expected = "{ name sensor-42 values [ 1 -2 f35 1000000 ] raw ABCDEFGHIJKLMNOPQRST "
+		"date #1 1700000000 ok T none N empty [ ] ] [ ( ab cde ] [ ] ( AB C ] ] ";
+	CBORPair msg = CBORPair();
+	CBORArray values = CBORArray();
+	//[_ (_ "ab", "cde"), [_ ], (_ h'0001', h'02')]
+	const uint8_t indefinite[] = {0x9F, 0x7F, 0x62, 0x61, 0x62, 0x63, 0x63, 0x64, 0x65,
+		0xFF, 0x9F, 0xFF, 0x5F, 0x42, 0x00, 0x01, 0x41, 0x02, 0xFF, 0xFF};
+	uint8_t buffer[128];
+
+	values.append(1);
+	values.append(-2);
+	values.append(3.5f);
+	values.append(1000000);
+	msg.append("name", "sensor-42");
+	msg.append("values", values);
+	CBOR raw = CBOR();
+	raw.encode(bytes, sizeof(bytes));
+	msg.append("raw", raw);
+	msg.append("date", CBOR(1, CBOR(1700000000)));
+	msg.append("ok", true);
+	msg.append("none", CBOR());
+	msg.append("empty", CBORArray());
+
+	//Two items in a row
+	memcpy(buffer, msg.to_CBOR(), msg.length());
+	memcpy(buffer + msg.length(), indefinite, sizeof(indefinite));
+	size_t len = msg.length() + sizeof(indefinite);
+
+	const size_t chunk_sizes[] = {1, 3, 7, 64, len};
+	for (size_t i=0 ; i < 5 ; ++i) {
+		String trace;
+		if (!parse_chunks(buffer, len, chunk_sizes[i], trace) || (trace != expected)) {
+			Serial.println(trace.c_str());
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool test_parser_malformed()
+{
+	//Break outside of an indefinite-length item
+	const uint8_t bad_break[] = {0x82, 0x01, 0xFF};
+	//Reserved additional information
+	const uint8_t bad_info[] = {0x1C};
+	//Integer chunk in an indefinite-length string
+	const uint8_t bad_chunk[] = {0x5F, 0x01, 0xFF};
+	//Key without a value in an indefinite-length map
+	const uint8_t odd_map[] = {0xBF, 0x01, 0xFF};
+	const uint8_t odd_nested_map[] = {0xBF, 0x01, 0x9F, 0xFF, 0x02, 0xFF};
+	//Tag without a tagged item
+	const uint8_t tag_break[] = {0x9F, 0xC1, 0xFF};
+	//{_ "a": [1, 2], 1(1): 2}
+	const uint8_t indef_map[] = {0xBF, 0x61, 0x61, 0x82, 0x01, 0x02, 0xC1, 0x01, 0x02, 0xFF};
+	String trace;
+
+	return !parse_chunks(bad_break, sizeof(bad_break), 1, trace) &&
+		!parse_chunks(bad_info, sizeof(bad_info), 1, trace) &&
+		!parse_chunks(bad_chunk, sizeof(bad_chunk), 1, trace) &&
+		!parse_chunks(odd_map, sizeof(odd_map), 1, trace) &&
+		!parse_chunks(odd_nested_map, sizeof(odd_nested_map), 1, trace) &&
+		!parse_chunks(tag_break, sizeof(tag_break), 1, trace) &&
+		parse_chunks(indef_map, sizeof(indef_map), 1, trace);
+}
+
+bool test_validate()
+{
+	//{"a": [1, -2, 3.5, h'0102'], "b": 1("x"), "c": [_ (_ "ab", "c")]}
+	const uint8_t msg[] = {0xA3, 0x61, 0x61, 0x84, 0x01, 0x21, 0xF9, 0x43, 0x00,
+		0x42, 0x01, 0x02, 0x61, 0x62, 0xC1, 0x61, 0x78, 0x61, 0x63, 0x9F, 0x7F,
+		0x62, 0x61, 0x62, 0x61, 0x63, 0xFF, 0xFF, 0x00};
+	size_t len = sizeof(msg) - 1; //Trailing byte is not part of the item
+	//Malformed items
+	const uint8_t bad_break[] = {0x82, 0x01, 0xFF};
+	const uint8_t bad_info[] = {0x81, 0x1C};
+	const uint8_t bad_chunk[] = {0x7F, 0x41, 0x00, 0xFF};
+	const uint8_t bad_simple[] = {0xF8, 0x10};
+	const uint8_t huge_count[] = {0x9B, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00};
+	const uint8_t huge_string[] = {0x5A, 0xFF, 0xFF, 0xFF, 0xFF, 0x00};
+	const uint8_t odd_map[] = {0xBF, 0x01, 0xFF};
+	const uint8_t odd_nested_map[] = {0xBF, 0x01, 0x9F, 0xFF, 0x02, 0xFF};
+	//Tags without a tagged item
+	const uint8_t tag_break[] = {0x9F, 0xC1, 0xFF};
+	const uint8_t tag_break_map[] = {0xBF, 0xC1, 0xFF};
+	const uint8_t tag_break_nested[] = {0x82, 0x9F, 0xC1, 0xFF, 0x00};
+	//{_ "a": [1, 2], 1(1): 2}
+	const uint8_t indef_map[] = {0xBF, 0x61, 0x61, 0x82, 0x01, 0x02, 0xC1, 0x01, 0x02, 0xFF};
+	uint8_t nested[CBOR_VALIDATE_MAX_DEPTH + 2];
+
+	if (CBOR::validate(msg, sizeof(msg)) != len) {
+		return false;
+	}
+
+	//Every truncation is detected
+	for (size_t i=0 ; i < len ; ++i) {
+		if (CBOR::validate(msg, i) != 0) {
+			return false;
+		}
+	}
+
+	if (CBOR::validate(bad_break, sizeof(bad_break)) ||
+			CBOR::validate(bad_info, sizeof(bad_info)) ||
+			CBOR::validate(bad_chunk, sizeof(bad_chunk)) ||
+			CBOR::validate(bad_simple, sizeof(bad_simple)) ||
+			CBOR::validate(huge_count, sizeof(huge_count)) ||
+			CBOR::validate(huge_string, sizeof(huge_string)) ||
+			CBOR::validate(odd_map, sizeof(odd_map)) ||
+			CBOR::validate(odd_nested_map, sizeof(odd_nested_map)) ||
+			CBOR::validate(tag_break, sizeof(tag_break)) ||
+			CBOR::validate(tag_break_map, sizeof(tag_break_map)) ||
+			CBOR::validate(tag_break_nested, sizeof(tag_break_nested))) {
+		return false;
+	}
+	if (CBOR::validate(indef_map, sizeof(indef_map)) != sizeof(indef_map)) {
+		return false;
+	}
+
+	//Nesting depth
+	memset(nested, 0x81, sizeof(nested));
+	nested[CBOR_VALIDATE_MAX_DEPTH] = 0x00;
+	if (CBOR::validate(nested, CBOR_VALIDATE_MAX_DEPTH + 1) != CBOR_VALIDATE_MAX_DEPTH + 1) {
+		return false;
+	}
+	nested[CBOR_VALIDATE_MAX_DEPTH] = 0x81;
+	nested[CBOR_VALIDATE_MAX_DEPTH + 1] = 0x00;
+	if (CBOR::validate(nested, sizeof(nested)) != 0) {
+		return false;
+	}
+
+	//Validated view
+	CBOR cbor = CBOR((uint8_t*)msg, len, true);
+	if (!cbor.is_valid() || ((int)cbor["a"][1] != -2)) {
+		return false;
+	}
+
+	return !CBOR((uint8_t*)msg, sizeof(msg), true).is_valid();
+}
+
+bool test_sorted_lookup()
+{
+	CBORPair pair = CBORPair();
+	char key[4] = "k";
+	bool ret_val = true;
+
+	//Appended in reverse order
+	for (int i=29 ; i >= 0 ; --i) {
+		key[1] = 'a' + i;
+		key[2] = '\0';
+		pair.append(key, i);
+	}
+	pair.append(7, "seven");
+
+	if (!pair.canonicalize()) {
+		return false;
+	}
+
+	//Binary search
+	for (int i=0 ; i < 30 ; ++i) {
+		key[1] = 'a' + i;
+		ret_val &= ((int)pair[key] == i);
+	}
+	ret_val &= pair["k"].is_null() && pair["kz{"].is_null() && pair["a"].is_null() && pair["l"].is_null();
+	ret_val &= (pair[7].get_string_len() == 5);
+
+	//Appended keys are found again (linear search)
+	pair.append("a", 100);
+	ret_val &= ((int)pair["a"] == 100) && ((int)pair["kc"] == 2);
+
+	return ret_val;
+}
+
+bool test_typed_array()
+{
+	int16_t values[] = {-2, 300, 0x1234};
+	int16_t copy[3] = {0, 0, 0};
+	const int16_t *view = NULL;
+	const uint32_t *view32 = NULL;
+	size_t len = 0;
+	uint8_t be_float64[] = {0xD8, 0x52, 0x48, 0x3F, 0xF8, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
+	uint8_t not_typed[] = {0xD8, 0x40, 0x01};
+	CBOR native = CBOR();
+	CBOR swapped = CBOR();
+	bool ret_val = true;
+
+	native.encode_typed_array(values, 3);
+	swapped.encode_typed_array(values, 3, !CBOR_BIG_ENDIAN);
+
+	ret_val &= native.is_typed_array() && (native.get_typed_array_len() == 3);
+	ret_val &= (native.get_typed_array(copy, 3) == 3) && (copy[0] == -2) && (copy[2] == 0x1234);
+
+	//Zero-copy only in native byte order (the content of a CBOR built
+	//from scratch starts at an odd address)
+	CBORArray arr = CBORArray();
+	arr.append_typed_array(values, 3);
+	CBOR ele = arr[0];
+	if (ele.get_typed_array_view(view, len)) {
+		ret_val &= (len == 3) && (view[1] == 300);
+	}
+	ret_val &= !swapped.get_typed_array_view(view, len);
+	ret_val &= !native.get_typed_array_view(view32, len);
+
+	//Byte swap, capacity and type mismatch
+	copy[0] = copy[1] = copy[2] = 0;
+	ret_val &= (swapped.get_typed_array(copy, 2) == 2) && (copy[0] == -2) && (copy[1] == 300) && (copy[2] == 0);
+	ret_val &= (swapped.get_typed_array((uint16_t*)copy, 3) == 0);
+
+	CBOR cbor_double = CBOR(be_float64, sizeof(be_float64), true);
+	double d = 0.0;
+	ret_val &= (cbor_double.get_typed_array_len() == 1) && (cbor_double.get_typed_array(&d, 1) == 1) && (d == 1.5);
+
+	ret_val &= !CBOR(not_typed, sizeof(not_typed), true).is_typed_array() && !CBOR(1).is_typed_array();
+
+	return ret_val;
+}
+
+bool test_decode_into()
+{
+	//[0, -24, 255, -256, 65535, -65536, 4294967295, 4294967296,
+	// 1.5 (half), 2.5 (single), -0.25 (double), 1e300 (double)]
+	uint8_t arr_buf[] = {0x8C, 0x00, 0x37, 0x18, 0xFF, 0x38, 0xFF,
+		0x19, 0xFF, 0xFF, 0x39, 0xFF, 0xFF, 0x1A, 0xFF, 0xFF, 0xFF, 0xFF,
+		0x1B, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00,
+		0xF9, 0x3E, 0x00, 0xFA, 0x40, 0x20, 0x00, 0x00,
+		0xFB, 0xBF, 0xD0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+		0xFB, 0x7E, 0x37, 0xE4, 0x3C, 0x88, 0x00, 0x75, 0x9C};
+	//[_ 1, -2, 3]
+	uint8_t indef_buf[] = {0x9F, 0x01, 0x21, 0x03, 0xFF};
+	int64_t ints[12];
+	int16_t shorts[12];
+	uint32_t uints[12];
+	float floats[12];
+	double doubles[12];
+	uint16_t samples[100];
+	bool ret_val = true;
+
+	CBOR arr = CBOR(arr_buf, sizeof(arr_buf), true);
+
+	//Stops at the first float
+	ret_val &= (arr.decode_into(ints, 12) == 8);
+	ret_val &= (ints[0] == 0) && (ints[1] == -24) && (ints[2] == 255) && (ints[3] == -256);
+	ret_val &= (ints[4] == 65535) && (ints[5] == -65536) && (ints[6] == 4294967295LL) && (ints[7] == 4294967296LL);
+
+	//Stops at the first integer out of range
+	ret_val &= (arr.decode_into(shorts, 12) == 4) && (shorts[3] == -256);
+	ret_val &= (arr.decode_into(uints, 12) == 1) && (uints[0] == 0);
+
+	//Every number fits a double, but 1e300 does not fit a float
+	ret_val &= (arr.decode_into(doubles, 12) == 12);
+	ret_val &= (doubles[1] == -24.0) && (doubles[7] == 4294967296.0) && (doubles[8] == 1.5);
+	ret_val &= (doubles[9] == 2.5) && (doubles[10] == -0.25);
+	if (sizeof(double) == 8) {
+		ret_val &= (doubles[11] == 1e300);
+	}
+	ret_val &= (arr.decode_into(floats, 12) == ((sizeof(double) == 8)?11:12));
+	ret_val &= (floats[5] == -65536.0f) && (floats[8] == 1.5f) && (floats[9] == 2.5f) && (floats[10] == -0.25f);
+
+	//Capacity of the output buffer
+	ret_val &= (arr.decode_into(doubles, 3) == 3);
+
+	CBOR indef = CBOR(indef_buf, sizeof(indef_buf), true);
+	ret_val &= (indef.decode_into(ints, 12) == 3) && (ints[1] == -2) && (ints[2] == 3);
+	ret_val &= (CBOR(5).decode_into(ints, 12) == 0);
+
+	//Homogeneous run, with an element out of range at the end
+	CBORArray block = CBORArray();
+	for (int i=0 ; i < 99 ; ++i) {
+		block.append(1000 + 500*i);
+	}
+	block.append(70000);
+	ret_val &= (block.decode_into(samples, 100) == 99) && (samples[0] == 1000) && (samples[98] == 50000);
+	ret_val &= (block.decode_into(floats, 12) == 12) && (floats[11] == 6500.0f);
+
+	//Largest float, infinity, then a double just above the largest float
+	if (sizeof(double) == 8) {
+		CBORArray limits = CBORArray();
+		limits.append((double)FLT_MAX);
+		limits.append((double)INFINITY);
+		limits.append((double)FLT_MAX*(1.0 + 1.0/(1UL << 30)));
+		ret_val &= (limits.decode_into(floats, 12) == 2) && (floats[0] == FLT_MAX) && isinf(floats[1]);
+	}
+
+	return ret_val;
+}
+
+struct Location
+{
+	float lat;
+	float lon;
+};
+YACL_FIELDS(Location, lat, lon)
+
+struct Status
+{
+	unsigned long id;
+	short temp;
+	unsigned char level;
+	bool valid;
+	double ratio;
+	char name[8];
+	Location loc;
+};
+YACL_FIELDS(Status, id, temp, level, valid, ratio, name, loc)
+
+bool test_decode_fields()
+{
+	CBORPair msg = CBORPair();
+	CBORPair loc = CBORPair();
+	char key[8] = "x";
+	Status status;
+	uint32_t missing = 0;
+	size_t unknown = 0;
+
+	//Keys out of order, among unknown ones
+	loc.append("lon", 2.35f);
+	loc.append("lat", 48.85);
+	loc.append("alt", 35);
+	for (int i=0 ; i < 10 ; ++i) {
+		key[1] = 'A' + i;
+		key[2] = '\0';
+		msg.append(key, i);
+	}
+	msg.append("valid", true);
+	msg.append("name", "probe");
+	msg.append("loc", loc);
+	msg.append("id", 100000);
+	msg.append("temp", -40);
+	msg.append("level", 200);
+	msg.append("ratio", 0.5);
+	msg.append("temp", 0); //Duplicate
+	for (int i=10 ; i < 20 ; ++i) {
+		key[1] = 'A' + i;
+		key[2] = '\0';
+		msg.append(key, i);
+	}
+
+	if (!msg.decode_fields(status, &missing, &unknown) || (missing != 0) || (unknown != 21)) {
+		return false;
+	}
+	if ((status.id != 100000) || (status.temp != -40) || (status.level != 200) || !status.valid
+			|| (status.ratio != 0.5) || (strcmp(status.name, "probe") != 0)
+			|| ((float)status.loc.lat != 48.85f) || (status.loc.lon != 2.35f)) {
+		return false;
+	}
+
+	//Missing fields, and values of the wrong type
+	CBORPair partial = CBORPair();
+	partial.append("level", 256);
+	partial.append("name", "too long!");
+	partial.append("ratio", 1);
+	partial.append("valid", false);
+
+	return !partial.decode_fields(status, &missing, &unknown) && (unknown == 0)
+		&& (missing == 0x77) && !status.valid && (status.level == 200)
+		&& !CBOR(1).decode_fields(status);
+}
+
+bool test_indefinite()
+{
+	//[(_ h'FF01', h'FF'), (_ "ab", "c"), [_ 1, [_ 2, 3], 4], 5]
+	uint8_t arr_buf[] = {0x84, 0x5F, 0x42, 0xFF, 0x01, 0x41, 0xFF, 0xFF,
+		0x7F, 0x62, 'a', 'b', 0x61, 'c', 0xFF,
+		0x9F, 0x01, 0x9F, 0x02, 0x03, 0xFF, 0x04, 0xFF, 0x05};
+	//{_ "a": 1, "b": [_ ], "c": (_ "xy", ""), "d": 4}
+	uint8_t map_buf[] = {0xBF, 0x61, 'a', 0x01, 0x61, 'b', 0x9F, 0xFF,
+		0x61, 'c', 0x7F, 0x62, 'x', 'y', 0x60, 0xFF, 0x61, 'd', 0x04, 0xFF};
+	uint8_t bytes[4];
+	char str[4];
+	bool ret_val = true;
+
+	CBORArray arr = CBORArray(arr_buf, sizeof(arr_buf), true);
+	ret_val &= (CBOR::validate(arr_buf, sizeof(arr_buf)) == sizeof(arr_buf));
+	ret_val &= (arr.length() == sizeof(arr_buf)) && (arr.n_elements() == 4) && ((int)arr[3] == 5);
+
+	//Chunked strings, with break bytes in their data
+	CBOR bytestring = arr[0];
+	ret_val &= bytestring.is_indefinite() && (bytestring.length() == 7);
+	ret_val &= (bytestring.get_bytestring_len() == 3);
+	bytestring.get_bytestring(bytes);
+	ret_val &= (bytes[0] == 0xFF) && (bytes[1] == 0x01) && (bytes[2] == 0xFF);
+	CBOR text = arr[1];
+	text.get_string(str);
+	ret_val &= (text.get_string_len() == 3) && (strcmp(str, "abc") == 0) && (text.to_string() == "abc");
+
+	//Nested indefinite-length arrays
+	CBOR nested = arr[2];
+	ret_val &= nested.is_indefinite() && (nested.length() == 8) && (nested.n_elements() == 3);
+	ret_val &= ((int)nested[2] == 4) && (nested[1].n_elements() == 2) && ((int)nested[1][1] == 3);
+	int sum = 0;
+	for (CBOR ele : nested[1]) {
+		sum += (int)ele;
+	}
+	ret_val &= (sum == 5);
+
+	//Indefinite-length map, with and without key index
+	CBORPair pair = CBORPair(map_buf, sizeof(map_buf));
+	ret_val &= pair.is_indefinite() && (pair.length() == sizeof(map_buf)) && (pair.n_elements() == 4);
+	ret_val &= (pair["b"].n_elements() == 0) && (pair["c"].to_string() == "xy") && ((int)pair["d"] == 4);
+	ret_val &= pair["e"].is_null();
+	ret_val &= pair.build_key_index() && ((int)pair["a"] == 1) && ((int)pair["d"] == 4);
+	ret_val &= !pair.canonicalize();
+
+	//Chunked strings and indefinite-length maps in structs
+	CBOR name = CBOR(arr_buf + 8, 7, true);
+	uint8_t loc_buf[] = {0xBF, 0x63, 'l', 'a', 't', 0xF9, 0x3C, 0x00, 0x63, 'l', 'o', 'n', 0xF9, 0x40, 0x00, 0xFF};
+	CBORPair loc = CBORPair(loc_buf, sizeof(loc_buf), true);
+	CBORPair msg = CBORPair();
+	Status status;
+	uint32_t missing = 0;
+	msg.begin_indefinite();
+	msg.append("name", name);
+	msg.append("loc", loc);
+	msg.end_indefinite();
+	ret_val &= !msg.decode_fields(status, &missing) && (missing == 0x1F);
+	ret_val &= (strcmp(status.name, "abc") == 0) && (status.loc.lat == 1.0f) && (status.loc.lon == 2.0f);
+
+	return ret_val;
+}
+
+bool test_skip()
+{
+	//[0, 24, 256, 65536, 4294967296, -1, 1.5 (half, float, double), true,
+	// null, 1("ab"), h'00...00' (24 bytes), [[]], {1: {2: 3}}, 7]
+	uint8_t arr_buf[] = {0x90, 0x00, 0x18, 0x18, 0x19, 0x01, 0x00,
+		0x1A, 0x00, 0x01, 0x00, 0x00, 0x1B, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00,
+		0x20, 0xF9, 0x3E, 0x00, 0xFA, 0x3F, 0xC0, 0x00, 0x00,
+		0xFB, 0x3F, 0xF8, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xF5, 0xF6,
+		0xC1, 0x62, 'a', 'b', 0x58, 0x18, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+		0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+		0x00, 0x00, 0x81, 0x80, 0xA1, 0x01, 0xA1, 0x02, 0x03, 0x07};
+	//[[[...[1]...]], 5], nested up to and beyond CBOR_SKIP_MAX_DEPTH
+	uint8_t deep_buf[CBOR_SKIP_MAX_DEPTH + 4];
+	bool ret_val = true;
+
+	CBORArray arr = CBORArray(arr_buf, sizeof(arr_buf), true);
+	ret_val &= (arr.n_elements() == 16) && ((int)arr[15] == 7);
+	ret_val &= (arr[4].length() == 9) && (arr[11].length() == 4) && (arr[12].length() == 26);
+	ret_val &= (arr[13].length() == 2) && (arr[14].length() == 5) && ((int)arr[14][1][2] == 3);
+
+	deep_buf[0] = 0x82;
+	for (uint8_t i=1 ; i <= CBOR_SKIP_MAX_DEPTH ; ++i) {
+		deep_buf[i] = 0x81;
+	}
+	deep_buf[CBOR_SKIP_MAX_DEPTH + 1] = 0x01;
+	deep_buf[CBOR_SKIP_MAX_DEPTH + 2] = 0x05;
+	CBORArray deep = CBORArray(deep_buf, CBOR_SKIP_MAX_DEPTH + 3, true);
+	ret_val &= (deep[0].length() == CBOR_SKIP_MAX_DEPTH + 1) && ((int)deep[1] == 5);
+
+	//One level too deep: reported as malformed
+	deep_buf[CBOR_SKIP_MAX_DEPTH + 1] = 0x81;
+	deep_buf[CBOR_SKIP_MAX_DEPTH + 2] = 0x01;
+	deep_buf[CBOR_SKIP_MAX_DEPTH + 3] = 0x05;
+	deep = CBORArray(deep_buf, CBOR_SKIP_MAX_DEPTH + 4, true);
+	ret_val &= (deep[0].length() == 0);
+
+	return ret_val;
+}
+
+bool test_small_runs()
+{
+	CBORArray arr = CBORArray();
+	CBORPair pair = CBORPair();
+	bool ret_val = true;
+
+	//Runs of one-byte items of various lengths, broken by longer items
+	for (int i=0 ; i < 300 ; ++i) {
+		if ((i%37 == 0) || (i%101 == 0)) {
+			arr.append(1000 + i);
+		}
+		else if (i%5 == 0) {
+			arr.append((i%10) == 0);
+		}
+		else {
+			arr.append(i%48 - 24);
+		}
+	}
+	arr.append("end");
+
+	for (int i=0 ; i < 300 ; ++i) {
+		int expected = (i%48 - 24);
+		if ((i%37 == 0) || (i%101 == 0)) {
+			ret_val &= ((int)arr[i] == 1000 + i);
+		}
+		else if (i%5 == 0) {
+			ret_val &= ((bool)arr[i] == ((i%10) == 0));
+		}
+		else {
+			ret_val &= ((int)arr[i] == expected);
+		}
+	}
+	ret_val &= (arr[300].to_string() == "end");
+
+	//Integer keys and values: pairs of one-byte items
+	for (int i=0 ; i < 100 ; ++i) {
+		pair.append(i%24, (i%30 == 0)?300:i%10);
+	}
+	for (int i=0 ; i < 100 ; ++i) {
+		ret_val &= ((int)pair.key_at(i) == i%24) && ((int)pair.at(i) == ((i%30 == 0)?300:i%10));
+	}
+
+	return ret_val;
+}
+
+bool test_indefinite_encode()
+{
+	CBORArray log = CBORArray();
+	bool ret_val = true;
+
+	//Header is not updated while appending
+	log.append(0);
+	log.begin_indefinite();
+	for (int i=1 ; i < 30 ; ++i) {
+		log.append(i);
+	}
+	ret_val &= (log.length() == 37) && (log.get_buffer()[0] == 0x9F) && (log.n_elements() == 30);
+	ret_val &= log.end_indefinite() && log.end_indefinite();
+	ret_val &= (log.length() == 38) && (log.get_buffer()[37] == 0xFF);
+	ret_val &= (CBOR::validate(log.get_buffer(), log.length()) == 38);
+
+	//Appending after the break
+	log.append("end");
+	ret_val &= !log.is_null() && (log.n_elements() == 31) && ((int)log[29] == 29);
+	ret_val &= log.end_indefinite() && (log.length() == 42) && (log[30].to_string() == "end");
+
+	//Copies keep the indefinite-length encoding
+	CBORArray copy = log;
+	ret_val &= copy.shrink_to_fit() && (copy.length() == log.length())
+		&& (memcmp(copy.get_buffer(), log.get_buffer(), log.length()) == 0);
+	copy.append(true);
+	ret_val &= copy.end_indefinite() && (copy.n_elements() == 32) && (bool)copy[31];
+
+	CBORPair map = CBORPair();
+	map.begin_indefinite();
+	map.append("a", 1);
+	map.append("b", log);
+	ret_val &= map.end_indefinite() && (map.length() == 49) && (map.n_elements() == 2);
+	ret_val &= (map["b"].n_elements() == 31) && ((int)map["a"] == 1);
+
+	//Nested in a definite-length object
+	CBORArray outer = CBORArray();
+	outer.append(map);
+	outer.append(7);
+	ret_val &= (CBOR::validate(outer.get_buffer(), outer.length()) == outer.length());
+	ret_val &= ((int)outer[1] == 7) && ((int)outer[0]["b"][30].get_string_len() == 3);
+
+	//Only indefinite-length objects can be closed
+	ret_val &= !outer.end_indefinite();
+
+	return ret_val;
+}
+
+bool test_find_by_keys()
+{
+	CBORPair pair = CBORPair();
+	CBOR keys[] = {CBOR("d"), CBOR("a"), CBOR(7), CBOR("missing"), CBOR("n")};
+	CBOR values[5];
+	char key[4] = "k";
+	bool ret_val = true;
+
+	pair.append("a", 1);
+	for (int i=0 ; i < 20 ; ++i) {
+		key[1] = 'a' + i;
+		key[2] = '\0';
+		pair.append(key, i);
+	}
+	pair.append(7, "seven");
+	pair.append("n", CBOR());
+	pair.append("d", 4);
+	pair.append("a", 2); //Duplicate
+
+	//Single scan
+	ret_val &= (pair.find_by_keys(keys, 5, values) == 4);
+	ret_val &= ((int)values[0] == 4) && ((int)values[1] == 1) && (values[2].to_string() == "seven");
+	ret_val &= values[3].is_null() && values[4].is_null();
+
+	//Early stop: keys found before the end, values are still views
+	ret_val &= (pair.find_by_keys(keys + 1, 2, values) == 2);
+	ret_val &= ((int)values[0] == 1) && (values[1].get_string_len() == 5);
+
+	//Hashed and sorted lookups
+	ret_val &= pair.build_key_index() && (pair.find_by_keys(keys, 5, values) == 4);
+	ret_val &= ((int)values[0] == 4) && ((int)values[1] == 1) && values[4].is_null();
+	pair.drop_key_index();
+	CBORPair sorted = CBORPair();
+	sorted.append("n", 0);
+	sorted.append("d", 3);
+	ret_val &= sorted.canonicalize() && (sorted.find_by_keys(keys, 5, values) == 2);
+	ret_val &= ((int)values[0] == 3) && ((int)values[4] == 0) && values[1].is_null();
+
+	//On a view, and on indefinite-length maps
+	CBORArray arr = CBORArray();
+	pair.begin_indefinite();
+	pair.end_indefinite();
+	arr.append(pair);
+	CBOR view = arr[0];
+	ret_val &= (view.find_by_keys(keys, 5, values) == 4) && ((int)values[0] == 4);
+
+	//Not a map
+	ret_val &= (CBOR(1).find_by_keys(keys, 5, values) == 0) && values[0].is_null();
+
+	//More than 32 keys: "ka" to "kt", then 20 missing keys
+	CBOR many_keys[40];
+	CBOR many_values[40];
+	for (int i=0 ; i < 40 ; ++i) {
+		key[1] = 'a' + i;
+		key[2] = '\0';
+		many_keys[i] = CBOR(key);
+	}
+	ret_val &= (pair.find_by_keys(many_keys, 40, many_values) == 20);
+	ret_val &= ((int)many_values[0] == 0) && ((int)many_values[19] == 19);
+	ret_val &= many_values[20].is_null() && many_values[39].is_null();
+
+	return ret_val;
+}
+
+struct TextSink
+{
+	char text[256];
+	size_t len = 0;
+
+	size_t write(const uint8_t *buffer, size_t size)
+	{
+		if (len + size >= sizeof(text)) {
+			size = sizeof(text) - 1 - len;
+		}
+		memcpy(text + len, buffer, size);
+		len += size;
+		text[len] = '\0';
+
+		return size;
+	}
+};
+
+bool test_json()
+{
+	uint8_t raw[] = {0x44, 0xFB, 0xFF, 0x01, 0x02};
+	bool ret_val = true;
+
+	//Definite-length items
+	CBORPair msg = CBORPair();
+	CBORArray arr = CBORArray();
+	arr.append(1);
+	arr.append(CBORArray());
+	arr.append(CBORPair());
+	msg.append("id", 42);
+	msg.append("name", "a \"q\"\n\\\x01");
+	msg.append("neg", -5);
+	msg.append("t", 21.5f);
+	msg.append("d", 0.1);
+	msg.append("ok", true);
+	msg.append("n", CBOR());
+	msg.append("raw", CBOR(raw, sizeof(raw), true));
+	msg.append("arr", arr);
+	msg.append(7, false);
+	msg.append(-1.5f, 0);
+	{
+		TextSink sink;
+		CBORJSONWriter json(sink);
+		ret_val &= json.write(msg) && json.flush();
+		ret_val &= (strcmp(sink.text, "{\"id\":42,\"name\":\"a \\\"q\\\"\\n\\\\\\u0001\",\"neg\":-5,\"t\":21.5,"
+				"\"d\":0.1,\"ok\":true,\"n\":null,\"raw\":\"-_8BAg\",\"arr\":[1,[],{}],\"7\":false,\"-1.5\":0}") == 0);
+	}
+
+	//Indefinite-length items, tags, big integers, special floats
+	uint8_t indef[] = {0x9F, 0x7F, 0x62, 'a', 'b', 0x61, 'c', 0xFF, 0x5F, 0x41, 0x01, 0x42, 0x02, 0x03, 0xFF,
+		0xC1, 0x19, 0x03, 0xE8, 0x3B, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xF7, 0xF9, 0x7E, 0x00,
+		0xFB, 0x44, 0x15, 0xAF, 0x1D, 0x78, 0xB5, 0x8C, 0x40, 0xF9, 0x2E, 0x66, 0xBF, 0x41, 0xFF, 0x80, 0xFF, 0xFF};
+	{
+		TextSink sink;
+		CBORJSONWriter json(sink);
+		ret_val &= json.write(indef, sizeof(indef)) && json.flush();
+		ret_val &= (strcmp(sink.text, "[\"abc\",\"AQID\",1000,-18446744073709551616,null,null,1e+20,0.1,{\"_w\":[]}]") == 0);
+	}
+
+	//Float formatting, and strings longer than the staging buffer
+	CBORArray floats = CBORArray();
+	floats.append(3.14159);
+	floats.append(0.1f);
+	floats.append(1.0e-7);
+	floats.append(-0.0);
+	{
+		TextSink sink;
+		CBORJSONWriter json(sink);
+		ret_val &= json.write(floats) && json.flush() && (strcmp(sink.text, "[3.14159,0.1,0.0000001,-0]") == 0);
+
+		sink.len = 0;
+		json.set_float_digits(3);
+		ret_val &= json.write(floats) && json.flush() && (strcmp(sink.text, "[3.14,0.1,1e-07,-0]") == 0);
+	}
+	{
+		TextSink sink;
+		CBORJSONWriter json(sink);
+		CBOR long_str = CBOR("a string longer than the staging buffer of the JSON writer,\twith a tab");
+		ret_val &= json.write(long_str) && json.flush();
+		ret_val &= (strcmp(sink.text, "\"a string longer than the staging buffer of the JSON writer,\\twith a tab\"") == 0);
+	}
+
+	//Malformed input
+	uint8_t truncated[] = {0x82, 0x01};
+	uint8_t bad_break[] = {0x82, 0x01, 0xFF};
+	uint8_t array_key[] = {0xA1, 0x80, 0x01};
+	uint8_t deep[17];
+	memset(deep, 0x81, sizeof(deep));
+	{
+		TextSink sink;
+		CBORJSONWriter json(sink);
+		ret_val &= !json.write(truncated, sizeof(truncated)) && !json.write(bad_break, sizeof(bad_break));
+		ret_val &= !json.write(array_key, sizeof(array_key)) && !json.write(deep, sizeof(deep));
+	}
+
+	return ret_val;
+}
+
+#ifdef YACL_PROFILE
+//! Clock advancing by one tick on every reading.
+unsigned long profile_ticks = 0;
+unsigned long profile_clock()
+{
+	return profile_ticks++;
+}
+
+bool test_profile()
+{
+	bool ret_val = true;
+	CBORPair pair = CBORPair();
+	pair.append("a", 1);
+	pair.append("b", 2);
+
+	//operator[] calls find_by_key(), then the value is converted
+	CBORProfile::reset();
+	CBORProfile::set_clock(profile_clock);
+	int b = pair["b"];
+	pair.append("c", 3);
+	CBORProfile::set_clock(NULL);
+	ret_val &= (b == 2);
+
+	CBORProfileStats stats = CBORProfile::get(CBOR_PROFILE_INDEX);
+	ret_val &= (stats.calls == 1) && (stats.total == 3) && (stats.min == 3) && (stats.max == 3);
+	ret_val &= (stats.histogram[2] == 1);
+	stats = CBORProfile::get(CBOR_PROFILE_FIND_BY_KEY);
+	ret_val &= (stats.calls == 1) && (stats.total == 1) && (stats.histogram[1] == 1);
+	stats = CBORProfile::get(CBOR_PROFILE_CAST);
+	ret_val &= (stats.calls == 1) && (stats.total == 1);
+
+	//append() calls add() for the key and for the value
+	stats = CBORProfile::get(CBOR_PROFILE_APPEND);
+	ret_val &= (stats.calls == 1) && (stats.total == 5) && (stats.histogram[3] == 1);
+	stats = CBORProfile::get(CBOR_PROFILE_ADD);
+	ret_val &= (stats.calls == 2) && (stats.total == 2);
+
+	//Nothing is recorded without a clock
+	b = pair["a"];
+	ret_val &= (CBORProfile::get(CBOR_PROFILE_INDEX).calls == 1);
+	ret_val &= (strcmp(CBORProfile::name(CBOR_PROFILE_INDEX), "operator[]") == 0);
+
+	CBORProfile::reset();
+	ret_val &= (CBORProfile::get(CBOR_PROFILE_ADD).calls == 0);
+
+	return ret_val;
+}
+#endif
+
 void setup()
 {
 	//Basic CBOR types
@@ -1082,6 +2047,46 @@ void setup()
 		Serial.println("NOK");
 	}
 
+	Serial.print("[1, ..., 25] (indexed) : ");
+	if (test_array_index()) {
+		Serial.println("OK");
+	}
+	else {
+		Serial.println("NOK");
+	}
+
+	Serial.print("{\"a\": [1, 2], \"b\": 32, \"c\": true} (indexed) : ");
+	if (test_pair_index()) {
+		Serial.println("OK");
+	}
+	else {
+		Serial.println("NOK");
+	}
+
+	Serial.print("{\"a\": \"A\", \"b\": \"B\", \"c\": \"C\", 1: \"D\", \"a\": \"E\"} (hashed) : ");
+	if (test_pair_key_index()) {
+		Serial.println("OK");
+	}
+	else {
+		Serial.println("NOK");
+	}
+
+	Serial.print("[1, [2, 3], \"test\"] (iterator) : ");
+	if (test_array_iterator()) {
+		Serial.println("OK");
+	}
+	else {
+		Serial.println("NOK");
+	}
+
+	Serial.print("{\"a\": 1, \"b\": [2, 3], \"c\": 3} (iterator) : ");
+	if (test_pair_iterator()) {
+		Serial.println("OK");
+	}
+	else {
+		Serial.println("NOK");
+	}
+
 	Serial.print("Custom tag : ");
 	if (test_tag()) {
 		Serial.println("OK");
@@ -1105,6 +2110,120 @@ void setup()
 	else {
 		Serial.println("NOK");
 	}
+
+	Serial.print("Pull parser, chunked input : ");
+	if (test_parser()) {
+		Serial.println("OK");
+	}
+	else {
+		Serial.println("NOK");
+	}
+
+	Serial.print("Pull parser, malformed input : ");
+	if (test_parser_malformed()) {
+		Serial.println("OK");
+	}
+	else {
+		Serial.println("NOK");
+	}
+
+	Serial.print("Validation : ");
+	if (test_validate()) {
+		Serial.println("OK");
+	}
+	else {
+		Serial.println("NOK");
+	}
+
+	Serial.print("Sorted key lookup : ");
+	if (test_sorted_lookup()) {
+		Serial.println("OK");
+	}
+	else {
+		Serial.println("NOK");
+	}
+
+	Serial.print("Typed arrays : ");
+	if (test_typed_array()) {
+		Serial.println("OK");
+	}
+	else {
+		Serial.println("NOK");
+	}
+
+	Serial.print("Decode arrays of numbers : ");
+	if (test_decode_into()) {
+		Serial.println("OK");
+	}
+	else {
+		Serial.println("NOK");
+	}
+
+	Serial.print("Decode into a struct : ");
+	if (test_decode_fields()) {
+		Serial.println("OK");
+	}
+	else {
+		Serial.println("NOK");
+	}
+
+	Serial.print("Indefinite-length items : ");
+	if (test_indefinite()) {
+		Serial.println("OK");
+	}
+	else {
+		Serial.println("NOK");
+	}
+
+	Serial.print("Skipping nested items : ");
+	if (test_skip()) {
+		Serial.println("OK");
+	}
+	else {
+		Serial.println("NOK");
+	}
+
+	Serial.print("Skipping runs of small items : ");
+	if (test_small_runs()) {
+		Serial.println("OK");
+	}
+	else {
+		Serial.println("NOK");
+	}
+
+	Serial.print("Indefinite-length encoding : ");
+	if (test_indefinite_encode()) {
+		Serial.println("OK");
+	}
+	else {
+		Serial.println("NOK");
+	}
+
+	Serial.print("Multiple key lookup : ");
+	if (test_find_by_keys()) {
+		Serial.println("OK");
+	}
+	else {
+		Serial.println("NOK");
+	}
+
+	Serial.print("JSON transcoding : ");
+	if (test_json()) {
+		Serial.println("OK");
+	}
+	else {
+		Serial.println("NOK");
+	}
+
+#ifdef YACL_PROFILE
+	Serial.print("Latency profiling : ");
+	if (test_profile()) {
+		Serial.println("OK");
+	}
+	else {
+		Serial.println("NOK");
+	}
+#endif
 }
 
 void loop()
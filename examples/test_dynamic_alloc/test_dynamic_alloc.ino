@@ -94,6 +94,372 @@ bool test_pair()
 	return false;
 }
 
+bool test_capacity()
+{
+	CBORArray cbor = CBORArray();
+	size_t n_growth = 0;
+	size_t last_capacity = cbor.capacity();
+
+	for (int i=0 ; i < 1000 ; ++i) {
+		if (!cbor.append(i)) {
+			Serial.println("Cannot test: bad alloc.");
+			return false;
+		}
+
+		if (cbor.capacity() != last_capacity) {
+			last_capacity = cbor.capacity();
+			++n_growth;
+		}
+
+		if (cbor.capacity() < cbor.length()) {
+			return false;
+		}
+	}
+
+	//Geometric growth: far less reallocations than appended elements
+	if (n_growth > 100) {
+		Serial.print("Too many reallocations: ");
+		Serial.println((unsigned int)n_growth);
+		return false;
+	}
+
+	if (!cbor.shrink_to_fit() || (cbor.capacity() != cbor.length())) {
+		return false;
+	}
+
+	//Content is preserved
+	for (int i=0 ; i < 1000 ; ++i) {
+		if ((int)cbor[i] != i) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool test_arena()
+{
+	const uint8_t expected[] = {0xa2, 0x61, 0x61, 0x01, 0x61, 0x62, 0x82, 0x02, 0x03};
+	size_t len_expected = 9;
+	static size_t arena_buffer[128/sizeof(size_t)];
+	uint8_t *arena_begin = (uint8_t*)arena_buffer;
+	CBORArenaAllocator arena(arena_begin, sizeof(arena_buffer));
+	bool good_alloc = true;
+
+	{
+		CBORPair cbor = CBORPair(arena);
+		CBORArray array = CBORArray(arena);
+
+		good_alloc &= array.append(2);
+		good_alloc &= array.append(3);
+		good_alloc &= cbor.append("a", 1);
+		good_alloc &= cbor.append("b", array);
+
+		if (!good_alloc) {
+			Serial.println("Cannot test: bad alloc.");
+			return false;
+		}
+
+		//Data must live in the arena
+		if ((cbor.to_CBOR() < arena_begin) ||
+				(cbor.to_CBOR() + cbor.length() > arena_begin + sizeof(arena_buffer))) {
+			return false;
+		}
+
+		if (!buffer_equals(expected, len_expected, cbor.to_CBOR(), cbor.length())) {
+			return false;
+		}
+	}
+
+	arena.reset();
+	if ((arena.used() != 0) || (arena.available() != sizeof(arena_buffer))) {
+		return false;
+	}
+
+	//Arena is exhausted: allocation fails gracefully
+	CBORArray big = CBORArray(arena);
+	for (int i=0 ; i < 128 ; ++i) {
+		if (!big.append(i)) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+//! Copy and copy-assign `src` once `allocator` is exhausted.
+bool copy_exhausted(CBORAllocator &allocator)
+{
+	const uint8_t expected[] = {0x81, 0x07};
+	CBORArray kept = CBORArray(allocator);
+	CBORArray src = CBORArray(allocator);
+
+	if (!kept.append(7)) {
+		Serial.println("Cannot test: bad alloc.");
+		return false;
+	}
+	for (int i=0 ; (i < 40) && src.append(i) ; ++i);
+	while (allocator.allocate(1) != NULL);
+
+	//Copy construction fails: the copy is empty
+	CBORArray copied = src;
+	if (copied.length() != 0) {
+		return false;
+	}
+
+	//Copy assignment fails: the content is kept
+	kept = src;
+	copied = src;
+
+	return buffer_equals(expected, sizeof(expected), kept.to_CBOR(), kept.length()) &&
+		(copied.length() == 0);
+}
+
+bool test_copy_exhausted()
+{
+	static size_t arena_buffer[128/sizeof(size_t)];
+	CBORArenaAllocator arena((uint8_t*)arena_buffer, sizeof(arena_buffer));
+	static size_t pool_buffer[4*32/sizeof(size_t)];
+	CBORPoolAllocator pool((uint8_t*)pool_buffer, sizeof(pool_buffer), 32);
+
+	return copy_exhausted(arena) && copy_exhausted(pool);
+}
+
+bool test_pool()
+{
+	static size_t pool_buffer[4*32/sizeof(size_t)];
+	CBORPoolAllocator pool((uint8_t*)pool_buffer, sizeof(pool_buffer), 32);
+
+	if (pool.available() != 4) {
+		return false;
+	}
+
+	{
+		CBORArray array1 = CBORArray(pool);
+		CBORArray array2 = CBORArray(pool);
+
+		if (pool.available() != 2) {
+			return false;
+		}
+
+		//Grows in place, up to the block size
+		for (int i=0 ; i < 23 ; ++i) {
+			if (!array1.append(i)) {
+				return false;
+			}
+		}
+		if (array1.append(23)) {
+			return false;
+		}
+
+		for (int i=0 ; i < 23 ; ++i) {
+			if ((int)array1[i] != i) {
+				return false;
+			}
+		}
+	}
+
+	//Blocks are given back to the pool
+	return (pool.available() == 4);
+}
+
+//! Heap allocator counting allocations, to check that moves do not copy.
+class CountingAllocator: public CBORHeapAllocator
+{
+	public:
+		size_t n_alloc = 0;
+		size_t n_free = 0;
+
+		void* allocate(size_t len)
+		{
+			++n_alloc;
+			return CBORHeapAllocator::allocate(len);
+		}
+
+		void* reallocate(void *ptr, size_t old_len, size_t new_len)
+		{
+			if (ptr == NULL) {
+				++n_alloc;
+			}
+			return CBORHeapAllocator::reallocate(ptr, old_len, new_len);
+		}
+
+		void deallocate(void *ptr, size_t len)
+		{
+			if (ptr != NULL) {
+				++n_free;
+			}
+			CBORHeapAllocator::deallocate(ptr, len);
+		}
+};
+
+CountingAllocator counting;
+
+CBORArray make_array(size_t n)
+{
+	CBORArray cbor = CBORArray(64, counting);
+
+	for (size_t i=0 ; i < n ; ++i) {
+		cbor.append((int)i);
+	}
+
+	return cbor;
+}
+
+bool test_move()
+{
+	const uint8_t expected[] = {0x83, 0x00, 0x01, 0x02};
+	size_t len_expected = 4;
+
+	counting.n_alloc = 0;
+	counting.n_free = 0;
+
+	{
+		CBORArray built = make_array(3);
+		size_t n_alloc = counting.n_alloc;
+
+		//Move construction and assignment do not allocate
+		CBORArray moved = static_cast<CBORArray&&>(built);
+		CBORArray target = CBORArray(counting);
+		target = static_cast<CBORArray&&>(moved);
+		if (counting.n_alloc != n_alloc + 1) {
+			return false;
+		}
+
+		//Copy construction and assignment do
+		CBORArray copied = target;
+		CBORArray assigned = CBORArray(counting);
+		assigned = copied;
+		if (counting.n_alloc != n_alloc + 4) {
+			return false;
+		}
+
+		if (!buffer_equals(expected, len_expected, target.to_CBOR(), target.length()) ||
+				!buffer_equals(expected, len_expected, copied.to_CBOR(), copied.length()) ||
+				!buffer_equals(expected, len_expected, assigned.to_CBOR(), assigned.length())) {
+			return false;
+		}
+
+		//Strings longer than the static buffer are moved too
+		CBOR str = CBOR("a long enough string", counting);
+		n_alloc = counting.n_alloc;
+		CBOR str_moved = static_cast<CBOR&&>(str);
+		CBOR small = CBOR(42);
+		small = static_cast<CBOR&&>(str_moved);
+		if ((counting.n_alloc != n_alloc) || !str.is_null() || !str_moved.is_null()) {
+			return false;
+		}
+		String decoded_str;
+		small.get_string(decoded_str);
+		if (decoded_str != "a long enough string") {
+			return false;
+		}
+
+		//Indexes are freed when an indexed object is assigned to
+		CBORArray indexed = make_array(3);
+		if (!indexed.build_index()) {
+			return false;
+		}
+		indexed = make_array(3);
+		if (!indexed.build_index() || ((int)indexed[2] != 2)) {
+			return false;
+		}
+
+		//Assigning an element of itself
+		CBOR nested = CBOR(assigned.to_CBOR(), assigned.length());
+		nested = nested[1];
+		if ((int)nested != 1) {
+			return false;
+		}
+	}
+
+	//Everything was freed exactly once
+	return (counting.n_alloc == counting.n_free);
+}
+
+bool test_move_composed()
+{
+	counting.n_alloc = 0;
+	counting.n_free = 0;
+
+	{
+		//A composed object moved into a CBOR object is copied, and keeps
+		//its buffer
+		CBORArray arr = make_array(40);
+		CBOR expected = arr;
+		CBOR constructed = static_cast<CBOR&&>(arr);
+		if (!buffer_equals(expected.to_CBOR(), expected.length(), constructed.to_CBOR(), constructed.length()) ||
+				!buffer_equals(expected.to_CBOR(), expected.length(), arr.to_CBOR(), arr.length())) {
+			return false;
+		}
+		CBOR converted = static_cast<CBORArray&&>(arr);
+		if (!buffer_equals(expected.to_CBOR(), expected.length(), converted.to_CBOR(), converted.length())) {
+			return false;
+		}
+
+		CBOR assigned;
+		assigned = make_array(40);
+		if (!buffer_equals(expected.to_CBOR(), expected.length(), assigned.to_CBOR(), assigned.length())) {
+			return false;
+		}
+
+		CBORPair pair = CBORPair(64, counting);
+		pair.append("samples", expected);
+		CBOR pair_copy = pair;
+		CBOR pair_moved = static_cast<CBOR&&>(pair);
+		if (!buffer_equals(pair_copy.to_CBOR(), pair_copy.length(), pair_moved.to_CBOR(), pair_moved.length())) {
+			return false;
+		}
+	}
+
+	//Everything was freed exactly once
+	return (counting.n_alloc == counting.n_free);
+}
+
+#ifdef YACL_STATS
+bool test_stats()
+{
+	bool ret_val = true;
+	CBORStats stats;
+
+	CBORStats::reset();
+	{
+		CBORArray arr = CBORArray(64);
+		CBOR str = CBOR("a string that does not fit in the static buffer");
+
+		stats = CBORStats::get();
+		ret_val &= (stats.allocations == 2) && (stats.reallocations == 0) && (stats.bytes_copied == 0);
+
+		//One copy of str, then one copy of arr
+		arr.append(1);
+		arr.append(2);
+		CBOR str_copy = str;
+		CBORArray copy = arr;
+		stats = CBORStats::get();
+		ret_val &= (stats.allocations == 4) && (stats.bytes_copied == str.length() + arr.length());
+
+		//Walks over the elements
+		ret_val &= ((int)copy.at(1) == 2);
+		ret_val &= (CBORStats::get().element_size_calls > stats.element_size_calls);
+
+		//Growth
+		for (int i=0 ; i < 100 ; ++i) {
+			arr.append(i);
+		}
+		ret_val &= (CBORStats::get().reallocations > 0);
+	}
+	stats = CBORStats::get();
+	ret_val &= (stats.deallocations == stats.allocations);
+
+	CBORStats::reset();
+	stats = CBORStats::get();
+	ret_val &= (stats.allocations == 0) && (stats.reallocations == 0) && (stats.deallocations == 0)
+		&& (stats.bytes_allocated == 0) && (stats.bytes_copied == 0) && (stats.element_size_calls == 0);
+
+	return ret_val;
+}
+#endif
+
 void setup()
 {
 	//Basic CBOR types
@@ -115,6 +481,64 @@ void setup()
 	else {
 		Serial.println("NOK");
 	}
+
+	Serial.print("[0, ..., 999] (capacity) : ");
+	if (test_capacity()) {
+		Serial.println("OK");
+	}
+	else {
+		Serial.println("NOK");
+	}
+
+	Serial.print("{\"a\": 1, \"b\": [2, 3]} (arena) : ");
+	if (test_arena()) {
+		Serial.println("OK");
+	}
+	else {
+		Serial.println("NOK");
+	}
+
+	Serial.print("[0, ..., 22] (pool) : ");
+	if (test_pool()) {
+		Serial.println("OK");
+	}
+	else {
+		Serial.println("NOK");
+	}
+
+	Serial.print("Copy with an exhausted allocator : ");
+	if (test_copy_exhausted()) {
+		Serial.println("OK");
+	}
+	else {
+		Serial.println("NOK");
+	}
+
+	Serial.print("[0, 1, 2] (move) : ");
+	if (test_move()) {
+		Serial.println("OK");
+	}
+	else {
+		Serial.println("NOK");
+	}
+
+	Serial.print("[0, ..., 39] (move into CBOR) : ");
+	if (test_move_composed()) {
+		Serial.println("OK");
+	}
+	else {
+		Serial.println("NOK");
+	}
+
+#ifdef YACL_STATS
+	Serial.print("Allocation and copy counters : ");
+	if (test_stats()) {
+		Serial.println("OK");
+	}
+	else {
+		Serial.println("NOK");
+	}
+#endif
 }
 
 void loop()
@@ -257,6 +257,80 @@ bool test_double()
 	return false;
 }
 
+bool test_shortest_float()
+{
+	const uint8_t half_21_5[] = {0xf9, 0x4d, 0x60};
+	const uint8_t half_neg_zero[] = {0xf9, 0x80, 0x00};
+	const uint8_t half_max[] = {0xf9, 0x7b, 0xff};
+	const uint8_t half_min[] = {0xf9, 0x00, 0x01};
+	const uint8_t half_inf[] = {0xf9, 0x7c, 0x00};
+	const uint8_t half_nan[] = {0xf9, 0x7e, 0x00};
+	const uint8_t float_100000[] = {0xfa, 0x47, 0xc3, 0x50, 0x00};
+	const uint8_t float_3_14[] = {0xfa, 0x40, 0x48, 0xf5, 0xc3};
+	const uint8_t double_0_1[] = {0xfb, 0x3f, 0xb9, 0x99, 0x99, 0x99, 0x99, 0x99, 0x9a};
+	CBOR cbor = CBOR();
+	bool ret_val = true;
+
+	CBOR::set_shortest_float(true);
+
+	cbor.encode(21.5f);
+	ret_val &= buffer_equals(half_21_5, 3, cbor.to_CBOR(), cbor.length());
+	cbor.encode(21.5);
+	ret_val &= buffer_equals(half_21_5, 3, cbor.to_CBOR(), cbor.length());
+	cbor.encode(-0.0f);
+	ret_val &= buffer_equals(half_neg_zero, 3, cbor.to_CBOR(), cbor.length());
+	cbor.encode(65504.0f);
+	ret_val &= buffer_equals(half_max, 3, cbor.to_CBOR(), cbor.length());
+	cbor.encode(5.960464477539063e-8f);
+	ret_val &= buffer_equals(half_min, 3, cbor.to_CBOR(), cbor.length());
+	cbor.encode((float)INFINITY);
+	ret_val &= buffer_equals(half_inf, 3, cbor.to_CBOR(), cbor.length());
+	cbor.encode((double)NAN);
+	ret_val &= buffer_equals(half_nan, 3, cbor.to_CBOR(), cbor.length());
+	cbor.encode(100000.0f);
+	ret_val &= buffer_equals(float_100000, 5, cbor.to_CBOR(), cbor.length());
+	cbor.encode(3.14f);
+	ret_val &= buffer_equals(float_3_14, 5, cbor.to_CBOR(), cbor.length());
+	cbor.encode((double)3.14f);
+	ret_val &= buffer_equals(float_3_14, 5, cbor.to_CBOR(), cbor.length());
+	cbor.encode(0.1);
+	ret_val &= (sizeof(double) == 4) || buffer_equals(double_0_1, 9, cbor.to_CBOR(), cbor.length());
+
+	//Sizes computed for append_fields()
+	ret_val &= (CBOR::encoded_len(21.5) == 3) && (CBOR::encoded_len(3.14f) == 5);
+
+	CBOR::set_shortest_float(false);
+
+	cbor.encode(21.5f);
+	ret_val &= (cbor.length() == 5) && (CBOR::encoded_len(21.5f) == 5);
+
+	return ret_val;
+}
+
+bool test_half_round_trip()
+{
+	uint8_t half[3] = {0xf9, 0x00, 0x00};
+	CBOR cbor = CBOR();
+	bool ret_val = true;
+
+	CBOR::set_shortest_float(true);
+
+	//Every half precision value is decoded, then encoded back to itself
+	for (uint32_t i=0 ; i <= 0xFFFF ; ++i) {
+		half[1] = (uint8_t)(i>>8);
+		half[2] = (uint8_t)i;
+		cbor.encode((float)CBOR(half, 3, true));
+		if (!buffer_equals(half, 3, cbor.to_CBOR(), cbor.length(), false)) {
+			ret_val = false;
+			break;
+		}
+	}
+
+	CBOR::set_shortest_float(false);
+
+	return ret_val;
+}
+
 bool test_string1()
 {
 	const uint8_t expected[9] = {0x68, 0x61, 0x6f, 0x65, 0x75, 0x31, 0x32, 0x33, 0x34};
@@ -421,6 +495,401 @@ bool test_bytestr1()
 	return false;
 }
 
+//! A sink storing written bytes in memory.
+struct BufferSink
+{
+	uint8_t data[128];
+	size_t len = 0;
+
+	size_t write(const uint8_t *buffer, size_t size)
+	{
+		if (len + size > sizeof(data)) {
+			size = sizeof(data) - len;
+		}
+		memcpy(data + len, buffer, size);
+		len += size;
+
+		return size;
+	}
+};
+
+bool test_writer()
+{
+	const char *long_str = "a string longer than the staging buffer";
+	BufferSink sink;
+	CBORPair expected = CBORPair();
+	CBORArray expected_arr = CBORArray();
+
+	for (int i=0 ; i < 20 ; ++i) {
+		expected_arr.append(i*100);
+	}
+	expected.append("id", 42);
+	expected.append("name", long_str);
+	expected.append("values", expected_arr);
+
+	{
+		CBORWriter writer(sink);
+
+		writer.begin_map(3);
+		writer.add("id");
+		writer.add(42);
+		writer.add("name");
+		writer.add(long_str);
+		writer.add("values");
+		writer.begin_array(20);
+		for (int i=0 ; i < 20 ; ++i) {
+			writer.add(i*100);
+		}
+
+		if (!writer.flush() || (writer.bytes_written() != sink.len)) {
+			return false;
+		}
+	}
+
+	return buffer_equals(expected.to_CBOR(), expected.length(), sink.data, sink.len);
+}
+
+bool test_writer_indefinite()
+{
+	//[_ 1, {_ "a": 1("x")}, (_ h'0102', h'03')]
+	const uint8_t expected[] = {0x9F, 0x01, 0xBF, 0x61, 0x61, 0xC1, 0x61, 0x78,
+		0xFF, 0x5F, 0x42, 0x01, 0x02, 0x41, 0x03, 0xFF, 0xFF};
+	const uint8_t bytes[] = {0x01, 0x02, 0x03};
+	BufferSink sink;
+
+	{
+		CBORWriter writer(sink);
+
+		writer.begin_array();
+		writer.add(1);
+		writer.begin_map();
+		writer.add("a");
+		writer.add(1, CBOR("x"));
+		writer.end();
+		writer.begin_bytes();
+		writer.add(bytes, 2);
+		writer.add(bytes + 2, 1);
+		writer.end();
+		writer.end();
+	} //Flushed by destructor
+
+	return buffer_equals(expected, sizeof(expected), sink.data, sink.len);
+}
+
+bool test_writer_error()
+{
+	BufferSink sink;
+	CBORWriter writer(sink);
+
+	//Sink overflows
+	for (int i=0 ; i < 200 ; ++i) {
+		writer.add(i);
+	}
+
+	return !writer.flush() && writer.error() && !writer.add(0) &&
+		(writer.bytes_written() == sizeof(sink.data));
+}
+
+bool test_canonicalize()
+{
+	//{"b": [{"z": 1, "a": 2}], 10: 0, "aa": 1, "a": true} sorts as
+	//{10: 0, "a": true, "b": [{"a": 2, "z": 1}], "aa": 1}
+	const uint8_t expected[] = {0xa4, 0x0a, 0x00, 0x61, 0x61, 0xf5, 0x61, 0x62, 0x81, 0xa2,
+		0x61, 0x61, 0x02, 0x61, 0x7a, 0x01, 0x62, 0x61, 0x61, 0x01};
+	uint8_t not_shortest[] = {0xa1, 0x61, 0x61, 0x18, 0x01};
+	uint8_t not_shortest_float[] = {0xa1, 0x61, 0x61, 0xfa, 0x3f, 0xc0, 0x00, 0x00};
+	uint8_t indefinite[] = {0xa1, 0x61, 0x61, 0x9f, 0xff};
+	CBORPair pair = CBORPair();
+	CBORPair nested = CBORPair();
+	CBORArray arr = CBORArray();
+	CBORPair dup = CBORPair();
+	bool ret_val = true;
+
+	nested.append("z", 1);
+	nested.append("a", 2);
+	arr.append(nested);
+	pair.append("b", arr);
+	pair.append(10, 0);
+	pair.append("aa", 1);
+	pair.append("a", true);
+
+	ret_val &= pair.canonicalize();
+	ret_val &= buffer_equals(expected, sizeof(expected), pair.to_CBOR(), pair.length());
+	//Already sorted
+	ret_val &= pair.canonicalize();
+	ret_val &= buffer_equals(expected, sizeof(expected), pair.to_CBOR(), pair.length());
+
+	//Duplicate keys, adjacent or not once sorted
+	dup.append("b", 1);
+	dup.append("a", 2);
+	dup.append("b", 3);
+	ret_val &= !dup.canonicalize();
+
+	//Not deterministic
+	ret_val &= !CBOR(not_shortest, sizeof(not_shortest), true).canonicalize();
+	ret_val &= !CBOR(not_shortest_float, sizeof(not_shortest_float), true).canonicalize();
+	ret_val &= !CBOR(indefinite, sizeof(indefinite), true).canonicalize();
+
+	return ret_val;
+}
+
+bool test_append_bulk()
+{
+	uint16_t values[300];
+	CBORArray bulk = CBORArray();
+	CBORArray expected = CBORArray();
+
+	for (int i=0 ; i < 300 ; ++i) {
+		values[i] = i*200;
+		expected.append(values[i]);
+	}
+
+	//Length field grows from 1 to 3 bytes at once
+	bulk.append(values, 300);
+
+	return buffer_equals(expected.to_CBOR(), expected.length(), bulk.to_CBOR(), bulk.length());
+}
+
+bool test_append_int_arrays()
+{
+	//Limits of every encoded size, truncated to each element type
+	const int64_t limits[] = {0, 1, 23, 24, 255, 256, 65535, 65536, 4294967295LL, 4294967296LL,
+		INT64_MAX, -1, -24, -25, -256, -257, -65536, -65537, -4294967296LL, -4294967297LL, INT64_MIN};
+	const size_t n_limits = sizeof(limits)/sizeof(limits[0]);
+	//Not a multiple of the number of integers classified at once
+	const size_t n = 37;
+	int8_t i8[n];
+	uint8_t u8[n];
+	int16_t i16[n];
+	uint16_t u16[n];
+	int32_t i32[n];
+	uint32_t u32[n];
+	int64_t i64[n];
+	uint64_t u64[n];
+	bool flags[n];
+	CBORArray expected[9];
+	CBORArray bulk[9];
+	bool ret_val = true;
+
+	for (size_t i=0 ; i < n ; ++i) {
+		int64_t value = limits[(i*7)%n_limits];
+		i8[i] = (int8_t)value;
+		u8[i] = (uint8_t)value;
+		i16[i] = (int16_t)value;
+		u16[i] = (uint16_t)value;
+		i32[i] = (int32_t)value;
+		u32[i] = (uint32_t)value;
+		i64[i] = value;
+		u64[i] = (uint64_t)value;
+		flags[i] = (value > 0);
+
+		expected[0].append(i8[i]);
+		expected[1].append(u8[i]);
+		expected[2].append(i16[i]);
+		expected[3].append(u16[i]);
+		expected[4].append(i32[i]);
+		expected[5].append(u32[i]);
+		expected[6].append(i64[i]);
+		expected[7].append(u64[i]);
+		expected[8].append(flags[i]);
+	}
+
+	bulk[0].append(i8, n);
+	bulk[1].append(u8, n);
+	bulk[2].append(i16, n);
+	bulk[3].append(u16, n);
+	bulk[4].append(i32, n);
+	bulk[5].append(u32, n);
+	bulk[6].append(i64, n);
+	bulk[7].append(u64, n);
+	bulk[8].append(flags, n);
+
+	for (int i=0 ; i < 9 ; ++i) {
+		ret_val &= buffer_equals(expected[i].to_CBOR(), expected[i].length(), bulk[i].to_CBOR(), bulk[i].length());
+	}
+
+	return ret_val;
+}
+
+bool test_typed_array()
+{
+	uint16_t u16[] = {1, 0x0203};
+	int8_t s8[] = {-1, 2};
+	float f32[] = {1.0f};
+	uint8_t expected_le[] = {0xD8, 0x45, 0x44, 0x01, 0x00, 0x03, 0x02};
+	uint8_t expected_be[] = {0xD8, 0x41, 0x44, 0x00, 0x01, 0x02, 0x03};
+	uint8_t expected_s8[] = {0xD8, 0x48, 0x42, 0xFF, 0x02};
+	uint8_t expected_f32[] = {0xD8, 0x55, 0x44, 0x00, 0x00, 0x80, 0x3F};
+	uint8_t expected_arr[] = {0x82, 0xD8, 0x48, 0x42, 0xFF, 0x02, 0x01};
+	uint8_t expected_pair[] = {0xA1, 0x61, 0x61, 0xD8, 0x41, 0x44, 0x00, 0x01, 0x02, 0x03};
+	CBOR cbor = CBOR();
+	CBORArray arr = CBORArray();
+	CBORPair pair = CBORPair();
+	bool ret_val = true;
+
+	cbor.encode_typed_array(u16, 2, false);
+	ret_val &= buffer_equals(expected_le, sizeof(expected_le), cbor.to_CBOR(), cbor.length());
+	cbor.encode_typed_array(u16, 2, true);
+	ret_val &= buffer_equals(expected_be, sizeof(expected_be), cbor.to_CBOR(), cbor.length());
+	cbor.encode_typed_array(s8, 2);
+	ret_val &= buffer_equals(expected_s8, sizeof(expected_s8), cbor.to_CBOR(), cbor.length());
+	cbor.encode_typed_array(f32, 1, false);
+	ret_val &= buffer_equals(expected_f32, sizeof(expected_f32), cbor.to_CBOR(), cbor.length());
+
+	arr.append_typed_array(s8, 2);
+	arr.append(1);
+	ret_val &= buffer_equals(expected_arr, sizeof(expected_arr), arr.to_CBOR(), arr.length());
+
+	pair.append_typed_array("a", u16, 2, true);
+	ret_val &= buffer_equals(expected_pair, sizeof(expected_pair), pair.to_CBOR(), pair.length());
+
+	return ret_val;
+}
+
+bool test_writer_typed_array()
+{
+	uint32_t samples[25];
+	CBOR expected = CBOR();
+	bool ret_val = true;
+
+	for (uint32_t i=0 ; i < 25 ; ++i) {
+		samples[i] = i*0x01020304;
+	}
+
+	//Larger than the staging buffer, in both byte orders
+	for (int big_endian=0 ; big_endian < 2 ; ++big_endian) {
+		BufferSink sink;
+		{
+			CBORWriter writer(sink);
+			writer.add_typed_array(samples, 25, big_endian);
+		}
+		expected.encode_typed_array(samples, 25, big_endian);
+		ret_val &= buffer_equals(expected.to_CBOR(), expected.length(), sink.data, sink.len);
+	}
+
+	return ret_val;
+}
+
+struct Position
+{
+	float lat;
+	float lon;
+};
+YACL_FIELDS(Position, lat, lon)
+
+struct Reading
+{
+	unsigned long long id;
+	int temp;
+	bool valid;
+	char name[8];
+	Position pos;
+	double ratio;
+};
+YACL_FIELDS(Reading, id, temp, valid, name, pos, ratio)
+
+bool test_fields()
+{
+	Reading reading = {5000000000ULL, -40, true, "probe", {48.85f, 2.35f}, 0.5};
+	CBORPair expected = CBORPair();
+	CBORPair expected_pos = CBORPair();
+	CBORPair pair = CBORPair();
+
+	expected_pos.append("lat", 48.85f);
+	expected_pos.append("lon", 2.35f);
+	expected.append("first", 1);
+	expected.append("id", 5000000000ULL);
+	expected.append("temp", -40);
+	expected.append("valid", true);
+	expected.append("name", "probe");
+	expected.append("pos", expected_pos);
+	expected.append("ratio", 0.5);
+
+	pair.append("first", 1);
+	if (!pair.append_fields(reading)) {
+		return false;
+	}
+
+	return (pair.n_elements() == 7) &&
+		buffer_equals(expected.to_CBOR(), expected.length(), pair.to_CBOR(), pair.length());
+}
+
+bool test_fields_external()
+{
+	Reading reading = {1, 2, false, "", {0.0f, 0.0f}, 0.0};
+	uint8_t buffer[32];
+	CBORPair pair = CBORPair(buffer, sizeof(buffer), false);
+
+	//Does not fit: nothing is written
+	return !pair.append_fields(reading) && (pair.n_elements() == 0) && (pair.length() == 1);
+}
+
+bool test_json()
+{
+	bool ret_val = true;
+	CBOR msg = CBOR();
+
+	//All JSON types, with escape sequences and 64-bit integers
+	uint8_t expected[] = {0xA9, 0x62, 'i', 'd', 0x18, 0x2A, 0x64, 'n', 'a', 'm', 'e',
+		0x66, 'd', 'e', 'v', 0xC3, 0xA9, 0x0A, 0x63, 'n', 'e', 'g', 0x24,
+		0x63, 'b', 'i', 'g', 0x1B, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+		0x63, 'm', 'i', 'n', 0x3B, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+		0x61, 'f', 0xFB, 0x40, 0x35, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00,
+		0x62, 'o', 'k', 0xF5, 0x61, 'n', 0xF6, 0x63, 'a', 'r', 'r', 0x83, 0x01, 0x80, 0xA0};
+	ret_val &= msg.encode_json("{\"id\": 42, \"name\": \"dev\\u00e9\\n\", \"neg\": -5,\n"
+			"\t\"big\": 18446744073709551615, \"min\": -18446744073709551616, \"f\": 21.5,\r\n"
+			"\"ok\": true, \"n\": null, \"arr\": [1, [ ], {}]} ");
+	ret_val &= buffer_equals(msg.to_CBOR(), msg.length(), expected, sizeof(expected));
+
+	//Shortest floats
+	uint8_t expected_floats[] = {0x85, 0xF9, 0x4D, 0x60, 0xFB, 0x3F, 0xB9, 0x99, 0x99, 0x99, 0x99, 0x99, 0x9A,
+		0xFA, 0x47, 0xC3, 0x50, 0x00, 0xF9, 0x80, 0x00, 0xFA, 0x7F, 0x7F, 0xFF, 0xFF};
+	CBOR::set_shortest_float(true);
+	ret_val &= msg.encode_json("[21.5, 0.1, 1e5, -0.0, 3.4028234663852886e38]");
+	CBOR::set_shortest_float(false);
+	ret_val &= buffer_equals(msg.to_CBOR(), msg.length(), expected_floats, sizeof(expected_floats));
+
+	//Headers longer than 1 byte, nested
+	CBORArray arr = CBORArray();
+	CBORPair pair = CBORPair();
+	for (int i=0 ; i < 30 ; ++i) {
+		arr.append(i*100);
+	}
+	pair.append("k", arr);
+	pair.append("s", "a string longer than 23 bytes");
+	ret_val &= msg.encode_json("{\"k\":[0,100,200,300,400,500,600,700,800,900,1000,1100,1200,1300,1400,"
+			"1500,1600,1700,1800,1900,2000,2100,2200,2300,2400,2500,2600,2700,2800,2900],"
+			"\"s\":\"a string longer than 23 bytes\"}");
+	ret_val &= buffer_equals(msg.to_CBOR(), msg.length(), pair.to_CBOR(), pair.length());
+
+	//Escaped strings whose header gets shorter, surrogate pairs
+	uint8_t expected_str[] = {0x82, 0x65, 'A', 'B', 'C', 'D', 'E', 0x66, 0xF0, 0x9F, 0x98, 0x80, '"', '/'};
+	ret_val &= msg.encode_json("[\"\\u0041\\u0042\\u0043\\u0044\\u0045\", \"\\ud83d\\ude00\\\"\\/\"]");
+	ret_val &= buffer_equals(msg.to_CBOR(), msg.length(), expected_str, sizeof(expected_str));
+
+	//Text that is not null-terminated, external buffer
+	uint8_t buffer[8];
+	CBOR ext = CBOR(buffer, sizeof(buffer), false);
+	uint8_t expected_ext[] = {0x82, 0x0C, 0x20};
+	ret_val &= ext.encode_json("[12, -1]xyz", 8);
+	ret_val &= buffer_equals(ext.to_CBOR(), ext.length(), expected_ext, sizeof(expected_ext));
+	ret_val &= !ext.encode_json("[\"does not fit\"]") && ext.is_null();
+
+	//Malformed documents
+	const char *invalid[] = {"", " ", "[1,]", "{\"a\" 1}", "{\"a\":1,}", "{1:2}", "[1", "[1}", "01", "1.", "1e",
+		"-", "+1", "\"\\x\"", "\"\\udc00\"", "\"\\ud83d\"", "\"a\tb\"", "\"abc", "tru", "nul", "[1] 2",
+		"[[[[[[[[[[[[[[[[[1]]]]]]]]]]]]]]]]]"};
+	for (size_t i=0 ; i < sizeof(invalid)/sizeof(invalid[0]) ; ++i) {
+		if (msg.encode_json(invalid[i]) || !msg.is_null()) {
+			Serial.print("Accepted: ");
+			Serial.println(invalid[i]);
+			ret_val = false;
+		}
+	}
+
+	return ret_val;
+}
+
 void setup()
 {
 	//Basic CBOR types
@@ -636,6 +1105,110 @@ void setup()
 	else {
 		Serial.println("NOK");
 	}
+
+	Serial.print("{\"id\": 42, \"name\": \"...\", \"values\": [0, ..., 1900]} (writer) : ");
+	if (test_writer()) {
+		Serial.println("OK");
+	}
+	else {
+		Serial.println("NOK");
+	}
+
+	Serial.print("[_ 1, {_ \"a\": 1(\"x\")}, (_ h'0102', h'03')] (writer) : ");
+	if (test_writer_indefinite()) {
+		Serial.println("OK");
+	}
+	else {
+		Serial.println("NOK");
+	}
+
+	Serial.print("Writer sink error : ");
+	if (test_writer_error()) {
+		Serial.println("OK");
+	}
+	else {
+		Serial.println("NOK");
+	}
+
+	Serial.print("Deterministic encoding (canonicalize) : ");
+	if (test_canonicalize()) {
+		Serial.println("OK");
+	}
+	else {
+		Serial.println("NOK");
+	}
+
+	Serial.print("[0, 200, ..., 59800] (bulk append) : ");
+	if (test_append_bulk()) {
+		Serial.println("OK");
+	}
+	else {
+		Serial.println("NOK");
+	}
+
+	Serial.print("Bulk append of integer arrays : ");
+	if (test_append_int_arrays()) {
+		Serial.println("OK");
+	}
+	else {
+		Serial.println("NOK");
+	}
+
+	Serial.print("Shortest floats : ");
+	if (test_shortest_float()) {
+		Serial.println("OK");
+	}
+	else {
+		Serial.println("NOK");
+	}
+
+	Serial.print("Float16 round trip : ");
+	if (test_half_round_trip()) {
+		Serial.println("OK");
+	}
+	else {
+		Serial.println("NOK");
+	}
+
+	Serial.print("Typed arrays : ");
+	if (test_typed_array()) {
+		Serial.println("OK");
+	}
+	else {
+		Serial.println("NOK");
+	}
+
+	Serial.print("Typed arrays (writer) : ");
+	if (test_writer_typed_array()) {
+		Serial.println("OK");
+	}
+	else {
+		Serial.println("NOK");
+	}
+
+	Serial.print("{\"first\": 1, \"id\": ..., \"pos\": {...}, ...} (append_fields) : ");
+	if (test_fields()) {
+		Serial.println("OK");
+	}
+	else {
+		Serial.println("NOK");
+	}
+
+	Serial.print("append_fields() into a too small buffer : ");
+	if (test_fields_external()) {
+		Serial.println("OK");
+	}
+	else {
+		Serial.println("NOK");
+	}
+
+	Serial.print("{\"id\": 42, ...} (encode_json) : ");
+	if (test_json()) {
+		Serial.println("OK");
+	}
+	else {
+		Serial.println("NOK");
+	}
 }
 
 void loop()
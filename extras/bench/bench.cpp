@@ -0,0 +1,653 @@
+//Host micro-benchmarks of YACL.
+//
+//Usage: yacl_bench [--quick]
+//
+//Reports, for each operation, the time per operation and the memory
+//allocated per operation (through the default CBORAllocator).
+#include "YACL.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+
+//! Heap allocator counting allocated bytes.
+class CountingAllocator: public CBORHeapAllocator
+{
+	public:
+		size_t n_alloc = 0;
+		size_t n_bytes = 0;
+
+		void* allocate(size_t len)
+		{
+			++n_alloc;
+			n_bytes += len;
+			return CBORHeapAllocator::allocate(len);
+		}
+
+		void* reallocate(void *ptr, size_t old_len, size_t new_len)
+		{
+			++n_alloc;
+			if (new_len > old_len) {
+				n_bytes += new_len - old_len;
+			}
+			return CBORHeapAllocator::reallocate(ptr, old_len, new_len);
+		}
+};
+
+//! Gives access to protected helpers.
+class BenchCBOR: public CBOR
+{
+	public:
+		static size_t size_of(uint8_t *ptr) { return element_size(ptr); }
+};
+
+struct BenchReading
+{
+	unsigned long id;
+	int temp;
+	int humidity;
+	bool valid;
+	float lat;
+	float lon;
+	double ratio;
+	const char *name;
+};
+YACL_FIELDS(BenchReading, id, temp, humidity, valid, lat, lon, ratio, name)
+
+struct BenchTelemetry
+{
+	float temp;
+	float humidity;
+	float pressure;
+	float battery;
+	double lat;
+	double lon;
+};
+YACL_FIELDS(BenchTelemetry, temp, humidity, pressure, battery, lat, lon)
+
+struct BenchStatus
+{
+	int k02;
+	int k05;
+	int k08;
+	int k11;
+	int k14;
+	int k17;
+	int k20;
+	int k23;
+};
+YACL_FIELDS(BenchStatus, k02, k05, k08, k11, k14, k17, k20, k23)
+
+//! Sink discarding bytes.
+struct NullSink
+{
+	size_t len = 0;
+
+	size_t write(const uint8_t *, size_t size)
+	{
+		len += size;
+		return size;
+	}
+};
+
+static CountingAllocator counting;
+static volatile size_t sink;
+static size_t scale = 1;
+
+#ifdef YACL_PROFILE
+//! Profiling clock, in nanoseconds.
+static unsigned long bench_clock()
+{
+	return (unsigned long)std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+#endif
+
+//! Run `op` `n` times and print the time and memory per operation.
+template <typename Op> void bench(const char *name, size_t n, Op op)
+{
+	n = (n + scale - 1)/scale;
+
+	//Warm up
+	op();
+
+	counting.n_alloc = 0;
+	counting.n_bytes = 0;
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (size_t i=0 ; i < n ; ++i) {
+		op();
+	}
+	std::chrono::steady_clock::time_point stop = std::chrono::steady_clock::now();
+
+	double ns = std::chrono::duration<double, std::nano>(stop - start).count();
+	printf("%-32s %10.1f ns/op %10.1f B/op %8.2f allocs/op\n", name, ns/n,
+			(double)counting.n_bytes/n, (double)counting.n_alloc/n);
+}
+
+//! Skip a document `n` times with `element_size()` and print the throughput.
+static void bench_skip(const char *name, size_t n, CBOR &doc)
+{
+	n = (n + scale - 1)/scale;
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (size_t i=0 ; i < n ; ++i) {
+		sink += BenchCBOR::size_of(doc.get_buffer());
+	}
+	std::chrono::steady_clock::time_point stop = std::chrono::steady_clock::now();
+
+	double ns = std::chrono::duration<double, std::nano>(stop - start).count();
+	printf("%-32s %10.1f ns/op %10.1f MB/s (%zu bytes)\n", name, ns/n, doc.length()*n/ns*1e3, doc.length());
+}
+
+//! Validate a document `n` times with `validate()` and print the throughput.
+static void bench_validate(const char *name, size_t n, CBOR &doc)
+{
+	n = (n + scale - 1)/scale;
+
+	//Nested deeper than CBOR_VALIDATE_MAX_DEPTH
+	if (CBOR::validate(doc.to_CBOR(), doc.length()) != doc.length()) {
+		printf("%-32s %10s (%zu bytes)\n", name, "rejected", doc.length());
+		return;
+	}
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (size_t i=0 ; i < n ; ++i) {
+		sink += CBOR::validate(doc.to_CBOR(), doc.length());
+	}
+	std::chrono::steady_clock::time_point stop = std::chrono::steady_clock::now();
+
+	double ns = std::chrono::duration<double, std::nano>(stop - start).count();
+	printf("%-32s %10.1f ns/op %10.1f MB/s (%zu bytes)\n", name, ns/n, doc.length()*n/ns*1e3, doc.length());
+}
+
+//! Encode `n` integers per element and with `append(const T*, size_t)`, and print both times.
+template <typename T> void bench_append(const char *type, const T *values, size_t n)
+{
+	char name[64];
+
+	snprintf(name, sizeof(name), "append(T) x%zu %s", n, type);
+	bench(name, 200000, [&]() {
+		CBORArray block;
+		for (size_t i=0 ; i < n ; ++i) {
+			block.append(values[i]);
+		}
+		sink += block.length();
+	});
+	snprintf(name, sizeof(name), "append(T*) %zu %s", n, type);
+	bench(name, 200000, [&]() {
+		CBORArray block;
+		block.append(values, n);
+		sink += block.length();
+	});
+}
+
+//! Look up every key of a Pair of `n` keys, linearly and with a hashed key index, and print both times.
+static void bench_find_by_key(size_t n)
+{
+	char name[64];
+	char keys[200][8];
+	CBORPair pair;
+
+	for (size_t i=0 ; i < n ; ++i) {
+		char key[8] = {'k', 'e', 'y', (char)('A' + i%26), (char)('A' + i/26), '\0'};
+		pair.append(key, (int)i);
+	}
+	//Visit the keys in a scattered order
+	for (size_t i=0 ; i < n ; ++i) {
+		size_t k = (i*37)%n;
+		char key[8] = {'k', 'e', 'y', (char)('A' + k%26), (char)('A' + k/26), '\0'};
+		memcpy(keys[i], key, sizeof(key));
+	}
+
+	size_t lookup = 0;
+	snprintf(name, sizeof(name), "find_by_key() on %zu keys", n);
+	bench(name, 1000000, [&]() { sink += (int)pair[keys[lookup++ % n]]; });
+	pair.build_key_index();
+	snprintf(name, sizeof(name), "find_by_key() on %zu keys hashed", n);
+	bench(name, 1000000, [&]() { sink += (int)pair[keys[lookup++ % n]]; });
+}
+
+int main(int argc, char **argv)
+{
+	if ((argc > 1) && (strcmp(argv[1], "--quick") == 0)) {
+		scale = 1000;
+	}
+
+	CBORAllocator::set_default(&counting);
+#ifdef YACL_PROFILE
+	CBORProfile::set_clock(bench_clock);
+#endif
+
+	const char *short_str = "temp";
+	const char *long_str = "a string that does not fit in the static buffer";
+	uint8_t bytes[64];
+	memset(bytes, 0xA5, sizeof(bytes));
+
+	//add() for every type, through encode()
+	{
+		CBOR cbor;
+		bench("add(bool)", 10000000, [&]() { cbor.encode(true); sink += cbor.length(); });
+		bench("add(int) 1 byte", 10000000, [&]() { cbor.encode(23); sink += cbor.length(); });
+		bench("add(int) 5 bytes", 10000000, [&]() { cbor.encode(-1000000000); sink += cbor.length(); });
+		bench("add(unsigned long long)", 10000000, [&]() { cbor.encode(1000000000000ULL); sink += cbor.length(); });
+		bench("add(float)", 10000000, [&]() { cbor.encode(3.14f); sink += cbor.length(); });
+		bench("add(double)", 10000000, [&]() { cbor.encode(3.14); sink += cbor.length(); });
+		bench("add(const char*) 4 bytes", 10000000, [&]() { cbor.encode(short_str); sink += cbor.length(); });
+	}
+	bench("CBOR(const char*) 47 bytes", 2000000, [&]() { CBOR cbor = CBOR(long_str); sink += cbor.length(); });
+	bench("CBOR(bytes) 64 bytes", 2000000, [&]() { CBOR cbor; cbor.encode(bytes, sizeof(bytes)); sink += cbor.length(); });
+
+	//Composed objects
+	bench("CBORArray::append(int) x1000", 2000, [&]() {
+		CBORArray arr;
+		for (int i=0 ; i < 1000 ; ++i) {
+			arr.append(i);
+		}
+		sink += arr.length();
+	});
+	bench("CBORPair::append(str, int) x100", 20000, [&]() {
+		CBORPair pair;
+		char key[8] = "key";
+		for (int i=0 ; i < 100 ; ++i) {
+			key[3] = 'A' + i%26;
+			key[4] = 'A' + i/26;
+			key[5] = '\0';
+			pair.append(key, i);
+		}
+		sink += pair.length();
+	});
+
+	//Structs
+	BenchReading reading = {123456, -40, 55, true, 48.85f, 2.35f, 0.5, "probe"};
+	bench("CBORPair::append() x8 fields", 2000000, [&]() {
+		CBORPair pair;
+		pair.append("id", reading.id);
+		pair.append("temp", reading.temp);
+		pair.append("humidity", reading.humidity);
+		pair.append("valid", reading.valid);
+		pair.append("lat", reading.lat);
+		pair.append("lon", reading.lon);
+		pair.append("ratio", reading.ratio);
+		pair.append("name", reading.name);
+		sink += pair.length();
+	});
+	bench("CBORPair::append_fields() 8 fields", 2000000, [&]() {
+		CBORPair pair;
+		pair.append_fields(reading);
+		sink += pair.length();
+	});
+
+	//Numeric blocks
+	uint16_t samples[256];
+	for (int i=0 ; i < 256 ; ++i) {
+		samples[i] = (uint16_t)(i*257);
+	}
+	bench("CBORArray::append(T*) 256 uint16", 200000, [&]() {
+		CBORArray block;
+		block.append(samples, 256);
+		sink += block.length();
+	});
+	bench("append_typed_array() 256 uint16", 200000, [&]() {
+		CBORArray block;
+		block.append_typed_array(samples, 256);
+		sink += block.length();
+	});
+	CBORArray block_array;
+	block_array.append(samples, 256);
+	CBORArray block_typed;
+	block_typed.append_typed_array(samples, 256);
+	CBOR typed = block_typed[0];
+	uint16_t decoded[256];
+	bench("at() x256 uint16", 2000, [&]() {
+		for (int i=0 ; i < 256 ; ++i) {
+			decoded[i] = block_array.at(i);
+		}
+		sink += decoded[255];
+	});
+	bench("get_typed_array() 256 uint16", 200000, [&]() {
+		sink += typed.get_typed_array(decoded, 256);
+	});
+	bench("iterator x256 uint16", 20000, [&]() {
+		int i = 0;
+		for (CBOR ele : block_array) {
+			decoded[i++] = ele;
+		}
+		sink += decoded[255];
+	});
+	bench("decode_into() 256 uint16", 200000, [&]() {
+		sink += block_array.decode_into(decoded, 256);
+	});
+	CBORArray float_array;
+	for (int i=0 ; i < 256 ; ++i) {
+		float_array.append((float)samples[i]/64.0f);
+	}
+	float decoded_float[256];
+	bench("at() x256 float", 2000, [&]() {
+		for (int i=0 ; i < 256 ; ++i) {
+			decoded_float[i] = float_array.at(i);
+		}
+		sink += (int)decoded_float[255];
+	});
+	bench("decode_into() 256 float", 200000, [&]() {
+		sink += float_array.decode_into(decoded_float, 256);
+	});
+	printf("%-32s %10u bytes (array) %6u bytes (typed array)\n", "256 uint16 payload",
+			(unsigned)block_array.length(), (unsigned)block_typed.length());
+
+	//Bulk integer encoding, against one append() per element: samples
+	//spanning several header sizes
+	uint8_t samples_u8[256];
+	int16_t samples_i16[256];
+	int32_t samples_i32[256];
+	int64_t samples_i64[256];
+	for (int i=0 ; i < 256 ; ++i) {
+		samples_u8[i] = (uint8_t)(i*37);
+		samples_i16[i] = (int16_t)(i*251 - 32000);
+		samples_i32[i] = (int32_t)(i - 128)*(1 << (i%24));
+		samples_i64[i] = (int64_t)(i - 128)*((int64_t)1 << (i%56));
+	}
+	bench_append("uint8", samples_u8, 256);
+	bench_append("int16", samples_i16, 256);
+	bench_append("int32", samples_i32, 256);
+	bench_append("int64", samples_i64, 256);
+
+	//Float encoding modes, on a telemetry corpus: DS18B20 temperatures
+	//(1/16 degree), integer humidity, pressure (1/4 hPa), battery voltage
+	//(mV) and a fixed GPS position
+	BenchTelemetry corpus[64];
+	uint32_t seed = 1;
+	for (int i=0 ; i < 64 ; ++i) {
+		seed = seed*1103515245 + 12345;
+		corpus[i].temp = (float)((int)(seed>>16)%960 - 320)/16.0f;
+		corpus[i].humidity = (float)((seed>>8)%101);
+		corpus[i].pressure = 950.0f + (float)((seed>>4)%400)/4.0f;
+		corpus[i].battery = (float)(3000 + seed%1200)/1000.0f;
+		corpus[i].lat = 48.8566;
+		corpus[i].lon = 2.3522;
+	}
+	for (int shortest=0 ; shortest < 2 ; ++shortest) {
+		CBOR::set_shortest_float(shortest);
+		size_t corpus_len = 0;
+		for (int i=0 ; i < 64 ; ++i) {
+			CBORPair msg;
+			msg.append_fields(corpus[i]);
+			corpus_len += msg.length();
+		}
+		int i = 0;
+		bench(shortest?"telemetry append_fields() shortest":"telemetry append_fields()", 1000000, [&]() {
+			CBORPair msg;
+			msg.append_fields(corpus[i++ & 63]);
+			sink += msg.length();
+		});
+		printf("%-32s %10.1f bytes/message\n", shortest?"telemetry payload shortest":"telemetry payload",
+				corpus_len/64.0);
+	}
+	CBOR::set_shortest_float(false);
+
+	//Decoding
+	CBORArray arr;
+	for (int i=0 ; i < 1000 ; ++i) {
+		arr.append(i*1000);
+	}
+	CBORPair pair;
+	char key[8] = "key";
+	for (int i=0 ; i < 20 ; ++i) {
+		key[3] = 'A' + i;
+		key[4] = '\0';
+		pair.append(key, i);
+	}
+	bench("at(500) on 1000 elements", 200000, [&]() { sink += (int)arr.at(500); });
+	//Sensor-like samples: small integers, booleans and nulls
+	CBORArray small_arr;
+	for (int i=0 ; i < 4096 ; ++i) {
+		if (i%97 == 0) {
+			small_arr.append(i);
+		}
+		else if (i%10 == 0) {
+			small_arr.append(i%20 == 0);
+		}
+		else {
+			small_arr.append(i%24 - 12);
+		}
+	}
+	bench("at(4000) on 4096 small items", 20000, [&]() { sink += (int)small_arr.at(4000); });
+	bench("find_by_key() on 20 keys", 2000000, [&]() { sink += (int)pair["keyT"]; });
+	CBORPair big_pair;
+	for (int i=0 ; i < 100 ; ++i) {
+		char big_key[8] = {'k', 'e', 'y', (char)('A' + i%26), (char)('A' + i/26), '\0'};
+		big_pair.append(big_key, i);
+	}
+	int lookup = 0;
+	char big_keys[100][8];
+	for (int i=0 ; i < 100 ; ++i) {
+		char big_key[8] = {'k', 'e', 'y', (char)('A' + (i*37)%100%26), (char)('A' + (i*37)%100/26), '\0'};
+		memcpy(big_keys[i], big_key, sizeof(big_key));
+	}
+	bench("find_by_key() on 100 keys", 1000000, [&]() { sink += (int)big_pair[big_keys[lookup++ % 100]]; });
+	CBORPair hashed_pair = big_pair;
+	hashed_pair.build_key_index();
+	bench("find_by_key() on 100 keys hashed", 1000000, [&]() { sink += (int)hashed_pair[big_keys[lookup++ % 100]]; });
+	//Crossover of the hashed key index versus the linear scan
+	bench_find_by_key(4);
+	bench_find_by_key(8);
+	bench_find_by_key(32);
+	bench_find_by_key(200);
+	bench("canonicalize() 100 keys", 100000, [&]() {
+		CBORPair copy = big_pair;
+		sink += copy.canonicalize();
+	});
+	big_pair.canonicalize();
+	big_pair.build_index();
+	bench("find_by_key() on 100 sorted keys", 1000000, [&]() { sink += (int)big_pair[big_keys[lookup++ % 100]]; });
+	CBORPair status_msg;
+	for (int i=0 ; i < 24 ; ++i) {
+		char status_key[4] = {'k', (char)('0' + i/10), (char)('0' + i%10), '\0'};
+		status_msg.append(status_key, i);
+	}
+	BenchStatus status;
+	bench("operator[] x8 on 24 keys", 200000, [&]() {
+		status.k02 = status_msg["k02"];
+		status.k05 = status_msg["k05"];
+		status.k08 = status_msg["k08"];
+		status.k11 = status_msg["k11"];
+		status.k14 = status_msg["k14"];
+		status.k17 = status_msg["k17"];
+		status.k20 = status_msg["k20"];
+		status.k23 = status_msg["k23"];
+		sink += status.k23;
+	});
+	bench("decode_fields() 8 fields, 24 keys", 200000, [&]() {
+		sink += status_msg.decode_fields(status);
+	});
+	CBOR status_keys[] = {CBOR("k02"), CBOR("k05"), CBOR("k08"), CBOR("k11"),
+		CBOR("k14"), CBOR("k17"), CBOR("k20"), CBOR("k23")};
+	CBOR status_values[8];
+	bench("find_by_keys() 8 keys, 24 keys", 200000, [&]() {
+		sink += status_msg.find_by_keys(status_keys, 8, status_values);
+		sink += (int)status_values[7];
+	});
+	bench("element_size() on 1000 elements", 200000, [&]() { sink += BenchCBOR::size_of(arr.get_buffer()); });
+
+	//Skipping and validating whole documents: wide (small integers), deep
+	//(24 nested arrays, repeated) and mixed (maps of strings, floats, tags,
+	//arrays)
+	{
+		CBORArray wide;
+		for (int i=0 ; i < 16384 ; ++i) {
+			wide.append((i%3)?i:-1000*i);
+		}
+
+		CBORArray nest;
+		CBORArray deep_valid;
+		nest.append(1);
+		nest.append(2);
+		for (int level=0 ; level < 23 ; ++level) {
+			CBORArray outer;
+			outer.append(nest);
+			outer.append(level);
+			nest = outer;
+			//Same shape, as deep as validate() accepts
+			if (level == CBOR_VALIDATE_MAX_DEPTH - 3) {
+				for (int i=0 ; i < 256 ; ++i) {
+					deep_valid.append(nest);
+				}
+			}
+		}
+		CBORArray deep;
+		for (int i=0 ; i < 256 ; ++i) {
+			deep.append(nest);
+		}
+
+		CBORArray mixed;
+		for (int i=0 ; i < 512 ; ++i) {
+			CBORArray values;
+			values.append(i);
+			values.append(1.5f);
+			values.append("x");
+			values.append(true);
+			CBORPair pos;
+			pos.append("lat", 48.85);
+			pos.append("lon", 2.35);
+			CBORPair entry;
+			entry.append("id", i);
+			entry.append("name", "sensor-name");
+			entry.append("ts", CBOR(1, CBOR(1700000000UL + i)));
+			entry.append("values", values);
+			entry.append("pos", pos);
+			CBOR raw;
+			raw.encode(bytes, 16);
+			entry.append("raw", raw);
+			mixed.append(entry);
+		}
+
+		bench_skip("element_size() wide", 2000, wide);
+		bench_skip("element_size() deep", 2000, deep);
+		bench_skip("element_size() deep, max depth", 2000, deep_valid);
+		bench_skip("element_size() mixed", 2000, mixed);
+		bench_validate("validate() wide", 2000, wide);
+		bench_validate("validate() deep", 2000, deep);
+		bench_validate("validate() deep, max depth", 2000, deep_valid);
+		bench_validate("validate() mixed", 2000, mixed);
+	}
+
+	//JSON transcoding: a telemetry message and a log message
+	CBORArray json_samples;
+	for (int i=0 ; i < 16 ; ++i) {
+		json_samples.append(i*37 - 100);
+	}
+	CBORPair json_msg;
+	json_msg.append("id", 123456);
+	json_msg.append("name", "device-042");
+	json_msg.append("temp", 21.5f);
+	json_msg.append("humidity", 55.25f);
+	json_msg.append("samples", json_samples);
+	CBOR json_raw;
+	json_raw.encode(bytes, 16);
+	json_msg.append("raw", json_raw);
+	CBORPair json_log;
+	json_log.append("level", "info");
+	json_log.append("message", "connection to the broker established after 3 retries, \"qos\": 1");
+	json_log.append("source", "mqtt_client.cpp");
+	NullSink null_sink;
+	CBORJSONWriter json(null_sink);
+	bench("CBORJSONWriter telemetry", 1000000, [&]() { sink += json.write(json_msg); });
+	bench("CBORJSONWriter log", 1000000, [&]() { sink += json.write(json_log); });
+	for (int corpus_type=0 ; corpus_type < 2 ; ++corpus_type) {
+		const CBOR &json_in = corpus_type?(const CBOR&)json_log:(const CBOR&)json_msg;
+		size_t n = 2000000/scale;
+		json.flush();
+		null_sink.len = 0;
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (size_t i=0 ; i < n ; ++i) {
+			json.write(json_in);
+		}
+		json.flush();
+		std::chrono::steady_clock::time_point stop = std::chrono::steady_clock::now();
+		double seconds = std::chrono::duration<double>(stop - start).count();
+		printf("%-32s %10.1f MB/s (CBOR in) %6.1f MB/s (JSON out)\n",
+				corpus_type?"CBORJSONWriter log":"CBORJSONWriter telemetry",
+				json_in.length()*n/seconds/1e6, null_sink.len/seconds/1e6);
+	}
+
+	//JSON to CBOR: a configuration document of 10000 entries (about 1 MB)
+	size_t config_cap = 10000*128;
+	char *config = (char*)malloc(config_cap);
+	size_t config_len = 0;
+	config[config_len++] = '[';
+	for (int i=0 ; i < 10000 ; ++i) {
+		config_len += snprintf(config + config_len, config_cap - config_len,
+				"%s{\"id\": %d, \"name\": \"device-%05d\", \"enabled\": true, \"threshold\": %d.5,"
+				" \"tags\": [\"a\", \"b\"], \"note\": \"line\\n\"}", i?",\n":"", i, i, i%100);
+	}
+	config[config_len++] = ']';
+	{
+		CBOR config_cbor;
+		bench("encode_json() 10000 entries", 200, [&]() {
+			CBOR cbor;
+			cbor.encode_json(config, config_len);
+			sink += cbor.length();
+		});
+		config_cbor.encode_json(config, config_len);
+		bench("CBORArray of CBORPair 10000", 200, [&]() {
+			CBORArray arr;
+			for (int i=0 ; i < 10000 ; ++i) {
+				char name[16];
+				snprintf(name, sizeof(name), "device-%05d", i);
+				CBORArray tags;
+				tags.append("a");
+				tags.append("b");
+				CBORPair entry;
+				entry.append("id", i);
+				entry.append("name", name);
+				entry.append("enabled", true);
+				entry.append("threshold", (i%100) + 0.5);
+				entry.append("tags", tags);
+				entry.append("note", "line\n");
+				arr.append(entry);
+			}
+			sink += arr.length();
+		});
+
+		size_t n = (2000 + scale - 1)/scale;
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (size_t i=0 ; i < n ; ++i) {
+			config_cbor.encode_json(config, config_len);
+		}
+		std::chrono::steady_clock::time_point stop = std::chrono::steady_clock::now();
+		double seconds = std::chrono::duration<double>(stop - start).count();
+		printf("%-32s %10.1f MB/s (JSON in) %6.1f MB/s (CBOR out)\n", "encode_json() 10000 entries",
+				config_len*n/seconds/1e6, config_cbor.length()*n/seconds/1e6);
+	}
+	free(config);
+
+	//Float conversions
+	uint8_t half[] = {0xF9, 0x3C, 0x00};
+	CBOR cbor_half = CBOR(half, sizeof(half), true);
+	CBOR cbor_float = CBOR(3.14f);
+	CBOR cbor_double = CBOR(3.14);
+	bench("(float) FLOAT16", 10000000, [&]() { sink += (size_t)(float)cbor_half; });
+	bench("(float) FLOAT32", 10000000, [&]() { sink += (size_t)(float)cbor_float; });
+	bench("(double) FLOAT64", 10000000, [&]() { sink += (size_t)(double)cbor_double; });
+
+	//Copies
+	CBOR cbor_str = CBOR(long_str);
+	bench("CBOR(const CBOR&) 47 bytes", 2000000, [&]() { CBOR copy = cbor_str; sink += copy.length(); });
+	bench("CBORArray(const CBORArray&) x1000", 200000, [&]() { CBORArray copy = arr; sink += copy.length(); });
+
+#ifdef YACL_PROFILE
+	//Latency of the entry points over all the benchmarks (profiling overhead included)
+	CBORProfile::set_clock(NULL);
+	for (uint8_t api=0 ; api < CBOR_PROFILE_N_API ; ++api) {
+		CBORProfileStats stats = CBORProfile::get(api);
+		if (stats.calls > 0) {
+			printf("%-32s %10lu calls %8.1f ns avg %8lu ns min %10lu ns max\n", CBORProfile::name(api),
+					stats.calls, (double)stats.total/stats.calls, stats.min, stats.max);
+		}
+	}
+#endif
+
+	CBORAllocator::set_default(NULL);
+
+	return 0;
+}
@@ -0,0 +1,52 @@
+#include "Arduino.h"
+#include <stdio.h>
+#include <time.h>
+
+HostSerial Serial;
+
+size_t HostSerial::write(uint8_t byte)
+{
+	return (putchar(byte) == EOF)?0:1;
+}
+
+size_t HostSerial::write(const uint8_t *buffer, size_t size)
+{
+	return fwrite(buffer, 1, size, stdout);
+}
+
+size_t HostSerial::print(const char *str)
+{
+	return write((const uint8_t*)str, strlen(str));
+}
+
+size_t HostSerial::print(unsigned long long value, int base)
+{
+	return printf((base == HEX)?"%llX":"%llu", value);
+}
+
+size_t HostSerial::print(long long value, int base)
+{
+	if (base == HEX) {
+		return printf("%llX", (unsigned long long)value);
+	}
+
+	return printf("%lld", value);
+}
+
+size_t HostSerial::print(double value, int digits)
+{
+	return printf("%.*f", digits, value);
+}
+
+unsigned long micros()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (unsigned long)(now.tv_sec*1000000ULL + now.tv_nsec/1000);
+}
+
+unsigned long millis()
+{
+	return micros()/1000;
+}
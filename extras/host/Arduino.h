@@ -0,0 +1,47 @@
+#ifndef INCLUDED_ARDUINO_H
+#define INCLUDED_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+#include "WString.h"
+
+#define DEC 10
+#define HEX 16
+
+//! Minimal host replacement for the Arduino `Serial` object (writes to stdout).
+class HostSerial
+{
+	public:
+		void begin(unsigned long) {}
+
+		size_t write(uint8_t byte);
+		size_t write(const uint8_t *buffer, size_t size);
+
+		size_t print(const char *str);
+		size_t print(const String &str) { return print(str.c_str()); }
+		size_t print(char c) { return write((uint8_t)c); }
+		size_t print(unsigned long long value, int base = DEC);
+		size_t print(long long value, int base = DEC);
+		size_t print(unsigned long value, int base = DEC) { return print((unsigned long long)value, base); }
+		size_t print(long value, int base = DEC) { return print((long long)value, base); }
+		size_t print(unsigned int value, int base = DEC) { return print((unsigned long long)value, base); }
+		size_t print(int value, int base = DEC) { return print((long long)value, base); }
+		size_t print(unsigned char value, int base = DEC) { return print((unsigned long long)value, base); }
+		size_t print(double value, int digits = 2);
+
+		size_t println() { return write('\n'); }
+		template <typename T> size_t println(T value) { return print(value) + println(); }
+		template <typename T> size_t println(T value, int format) { return print(value, format) + println(); }
+};
+
+extern HostSerial Serial;
+
+unsigned long millis();
+unsigned long micros();
+
+void setup();
+void loop();
+
+#endif
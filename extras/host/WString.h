@@ -0,0 +1,39 @@
+#ifndef INCLUDED_WSTRING_H
+#define INCLUDED_WSTRING_H
+
+#include <stddef.h>
+#include <string>
+
+//! Minimal host replacement for the Arduino `String` class.
+/*!
+ * Only implements what YACL, its examples and its tests use.
+ */
+class String
+{
+	protected:
+		std::string str;
+
+	public:
+		String() {}
+		String(const char *c_str) : str(c_str) {}
+		String(char c) : str(1, c) {}
+
+		bool reserve(size_t size) { str.reserve(size); return true; }
+		size_t length() const { return str.size(); }
+		const char* c_str() const { return str.c_str(); }
+
+		char operator[](size_t idx) const { return str[idx]; }
+		char& operator[](size_t idx) { return str[idx]; }
+
+		String& operator=(const char *c_str) { str = c_str; return *this; }
+		String& operator+=(char c) { str += c; return *this; }
+		String& operator+=(const char *c_str) { str += c_str; return *this; }
+		String& operator+=(const String &other) { str += other.str; return *this; }
+
+		bool operator==(const String &other) const { return str == other.str; }
+		bool operator==(const char *c_str) const { return str == c_str; }
+		bool operator!=(const String &other) const { return str != other.str; }
+		bool operator!=(const char *c_str) const { return str != c_str; }
+};
+
+#endif
@@ -0,0 +1,10 @@
+#include "Arduino.h"
+
+//Run a sketch once: setup(), then one iteration of loop()
+int main()
+{
+	setup();
+	loop();
+
+	return 0;
+}
@@ -1,8 +1,32 @@
 #include "CBOR.h"
 
+#if defined(__AVR__)
+#include <avr/pgmspace.h>
+//Constant tables are kept in flash
+#define CBOR_PROGMEM PROGMEM
+#define CBOR_READ_PROGMEM(value) pgm_read_byte(&(value))
+#else
+#define CBOR_PROGMEM
+#define CBOR_READ_PROGMEM(value) (value)
+#endif
+
+//Vector extensions used to skip runs of one-byte items
+#if !defined(CBOR_NO_SIMD) && defined(__SSE2__)
+#include <immintrin.h>
+#define CBOR_SIMD_SSE2
+#if defined(__AVX2__)
+#define CBOR_SIMD_AVX2
+#endif
+#elif !defined(CBOR_NO_SIMD) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+#include <arm_neon.h>
+#define CBOR_SIMD_NEON
+#endif
+
 bool CBOR::init_buffer()
 {
-	buffer_begin = (uint8_t*)malloc(sizeof(uint8_t)*max_buf_len);
+	YACL_STAT(allocations, 1);
+	YACL_STAT(bytes_allocated, max_buf_len);
+	buffer_begin = (uint8_t*)allocator->allocate(sizeof(uint8_t)*max_buf_len);
 	if (buffer_begin == NULL) {
 		return false;
 	}
@@ -29,34 +53,157 @@ CBOR::CBOR(uint8_t* buffer, size_t buffer_len, bool has_data)
 }
 
 CBOR::CBOR(const uint8_t* buffer, size_t buffer_len)
+	: CBOR(buffer, buffer_len, *CBORAllocator::get_default())
+{
+}
+
+CBOR::CBOR(const uint8_t* buffer, size_t buffer_len, CBORAllocator &_allocator)
+	: allocator(&_allocator)
 {
 	if (buffer_len > STATIC_ALLOC_SIZE) {
 		max_buf_len = buffer_len;
-		init_buffer();
+		if (!init_buffer()) {
+			max_buf_len = STATIC_ALLOC_SIZE;
+			w_ptr = static_buffer_begin;
+			return;
+		}
 	}
 
-	memcpy(w_ptr, buffer, max_buf_len*sizeof(uint8_t));
+	memcpy(w_ptr, buffer, buffer_len*sizeof(uint8_t));
+	YACL_STAT(bytes_copied, buffer_len);
 	w_ptr += element_size(w_ptr);
 }
 
-CBOR::CBOR(const CBOR &obj) {
-	const uint8_t* obj_buffer = obj.to_CBOR();
+CBOR::CBOR(const CBOR &obj) : allocator(obj.allocator)
+{
+	copy_buffer(obj);
+}
+
+CBOR::CBOR(CBOR &&obj)
+{
+	if (!obj.has_movable_buffer()) {
+		//The header of a composed object is stored inside its buffer: copy it
+		allocator = obj.allocator;
+		copy_buffer(obj);
+		return;
+	}
+
+	move_buffer(obj);
+	obj.add();
+}
+
+CBOR& CBOR::operator=(const CBOR &obj)
+{
+	if (this != &obj) {
+		//obj may be a view on the buffer of this object: copy it before
+		//releasing the buffer
+		CBOR copy;
+		copy.allocator = allocator;
+		copy.release_buffer();
+		copy.copy_buffer(obj);
+
+		release_buffer();
+		move_buffer(copy);
+	}
+
+	return *this;
+}
 
-	if (obj.length() > STATIC_ALLOC_SIZE) {
-		max_buf_len = obj.length();
-		init_buffer();
+CBOR& CBOR::operator=(CBOR &&obj)
+{
+	if (owns_data(obj.to_CBOR()) || !obj.has_movable_buffer()) {
+		//obj is a view on the buffer of this object (e.g. cbor = cbor[0]),
+		//or a composed object, whose buffer cannot be taken over
+		return operator=((const CBOR&)obj);
 	}
 
-	memcpy(w_ptr, obj_buffer, max_buf_len*sizeof(uint8_t));
-	w_ptr += obj.length();
+	if (this != &obj) {
+		release_buffer();
+		move_buffer(obj);
+		obj.add();
+	}
 
+	return *this;
 }
 
 CBOR::~CBOR()
+{
+	release_buffer();
+}
+
+void CBOR::release_buffer()
 {
 	if((buffer_type == BUFFER_DYNAMIC_INTERNAL) && (buffer_begin != NULL)) {
-		free(buffer_begin);
+		YACL_STAT(deallocations, 1);
+		allocator->deallocate(buffer_begin, max_buf_len);
+	}
+
+	drop_index();
+	drop_key_index();
+	free_indexes();
+
+	buffer_type = BUFFER_STATIC_INTERNAL;
+	max_buf_len = STATIC_ALLOC_SIZE;
+	w_ptr = static_buffer_begin;
+}
+
+void CBOR::copy_buffer(const CBOR &obj)
+{
+	size_t len = obj.length();
+
+	if (len > STATIC_ALLOC_SIZE) {
+		max_buf_len = len;
+		if (!CBOR::init_buffer()) {
+			max_buf_len = STATIC_ALLOC_SIZE;
+			w_ptr = static_buffer_begin;
+			return;
+		}
 	}
+
+	memcpy(w_ptr, obj.to_CBOR(), len*sizeof(uint8_t));
+	YACL_STAT(bytes_copied, len);
+	w_ptr += len;
+}
+
+void CBOR::move_buffer(CBOR &obj)
+{
+	allocator = obj.allocator;
+	buffer_type = obj.buffer_type;
+	max_buf_len = obj.max_buf_len;
+
+	if (buffer_type == BUFFER_STATIC_INTERNAL) {
+		memcpy(static_buffer_begin, obj.static_buffer_begin, STATIC_ALLOC_SIZE);
+		w_ptr = static_buffer_begin + obj.length();
+	}
+	else {
+		buffer_begin = obj.buffer_begin;
+		w_ptr = obj.w_ptr;
+	}
+
+	//Indexes are relative to the data section, so they stay valid
+	indexes = obj.indexes;
+
+	//obj does not own anything anymore
+	obj.indexes = NULL;
+
+	obj.buffer_type = BUFFER_STATIC_INTERNAL;
+	obj.max_buf_len = STATIC_ALLOC_SIZE;
+	obj.w_ptr = obj.static_buffer_begin;
+}
+
+size_t CBOR::grow_len(size_t current_len, size_t requested_len)
+{
+	size_t step = current_len*(BUFFER_GROWTH_NUM - BUFFER_GROWTH_DEN)/BUFFER_GROWTH_DEN;
+
+	if ((BUFFER_GROWTH_MAX_STEP != 0) && (step > BUFFER_GROWTH_MAX_STEP)) {
+		step = BUFFER_GROWTH_MAX_STEP;
+	}
+
+	if (current_len + step < requested_len) {
+		return requested_len;
+	}
+
+	return current_len + step;
 }
 
 bool CBOR::reserve(size_t len)
@@ -73,7 +220,7 @@ bool CBOR::reserve(size_t len)
 		memcpy(buffer_saved, static_buffer_begin, STATIC_ALLOC_SIZE*sizeof(uint8_t));
 
 		//Initialize dynamic buffer
-		max_buf_len = len;
+		max_buf_len = grow_len(max_buf_len, len);
 		if (init_buffer()) {
 			//Copy saved data in newly allocated buffer
 			memcpy(buffer_begin, buffer_saved, STATIC_ALLOC_SIZE*sizeof(uint8_t));
@@ -84,26 +231,72 @@ bool CBOR::reserve(size_t len)
 			return true;
 		}
 
+		//Allocation failed: restore static buffer
+		memcpy(static_buffer_begin, buffer_saved, STATIC_ALLOC_SIZE*sizeof(uint8_t));
+		max_buf_len = STATIC_ALLOC_SIZE;
+		w_ptr = static_buffer_begin + length_saved;
+
 		return false;
 	}
 
 	if (buffer_type == BUFFER_DYNAMIC_INTERNAL) {
 		size_t length_saved = length();
-
-		buffer_begin = (uint8_t*)realloc(buffer_begin, sizeof(uint8_t)*len);
-		if (buffer_begin == NULL) {
+		size_t new_len = grow_len(max_buf_len, len);
+
+		YACL_STAT(reallocations, 1);
+		uint8_t *new_buffer = (uint8_t*)allocator->reallocate(buffer_begin,
+				max_buf_len, sizeof(uint8_t)*new_len);
+		if ((new_buffer == NULL) && (new_len > len)) {
+			//Not enough memory to grow: try the exact requested length
+			new_len = len;
+			YACL_STAT(reallocations, 1);
+			new_buffer = (uint8_t*)allocator->reallocate(buffer_begin,
+					max_buf_len, sizeof(uint8_t)*new_len);
+		}
+		if (new_buffer == NULL) {
 			return false;
 		}
+		YACL_STAT(bytes_allocated, new_len - max_buf_len);
 
 		//Update max buffer length and write pointer
-		max_buf_len = len;
+		buffer_begin = new_buffer;
+		max_buf_len = new_len;
 		w_ptr = buffer_begin + length_saved;
+
+		return true;
 	}
 
 	//BUFFER_EXTERNAL
 	return false;
 }
 
+bool CBOR::shrink_to_fit()
+{
+	if (buffer_type != BUFFER_DYNAMIC_INTERNAL) {
+		return true;
+	}
+
+	size_t length_saved = length();
+	size_t new_len = (length_saved > 0)?length_saved:1;
+
+	if (new_len == max_buf_len) {
+		return true;
+	}
+
+	YACL_STAT(reallocations, 1);
+	uint8_t *new_buffer = (uint8_t*)allocator->reallocate(buffer_begin,
+			max_buf_len, sizeof(uint8_t)*new_len);
+	if (new_buffer == NULL) {
+		return false;
+	}
+
+	buffer_begin = new_buffer;
+	max_buf_len = new_len;
+	w_ptr = buffer_begin + length_saved;
+
+	return true;
+}
+
 bool CBOR::encode_type_num(uint8_t cbor_type, uint8_t val)
 {
 	if (val <= 23) {
@@ -128,7 +321,7 @@ bool CBOR::encode_type_num(uint8_t cbor_type, uint8_t val)
 bool CBOR::encode_type_num(uint8_t cbor_type, uint16_t val)
 {
 	if (val <= 0xFF) { //If val fits in an uint8_t
-		encode_type_num(cbor_type, (uint8_t)val);
+		return encode_type_num(cbor_type, (uint8_t)val);
 	}
 	else {
 		if (!reserve(length() + 3)) {
@@ -288,195 +481,370 @@ uint8_t CBOR::compute_type_num_len(size_t num_ele) {
 }
 
 
-size_t CBOR::element_size(uint8_t *ptr)
+size_t CBOR::validate(const uint8_t *buffer, size_t buffer_len)
 {
-	uint8_t *type = ptr;
-
-	//Integer
-	if ((*type <= 23) \
-			|| (*type >= 0x20 && *type <= 0x37)) {
-		++ptr;
-	}
-	else if (*type == CBOR_UINT8_FOLLOWS \
-			|| (*type == (CBOR_NEGINT|CBOR_UINT8_FOLLOWS))) {
-		ptr += 2;
-	}
-	else if (*type == CBOR_UINT16_FOLLOWS \
-			|| (*type == (CBOR_NEGINT|CBOR_UINT16_FOLLOWS))) {
-		ptr += 3;
-	}
-	else if (*type == CBOR_UINT32_FOLLOWS \
-			|| (*type == (CBOR_NEGINT|CBOR_UINT32_FOLLOWS))) {
-		ptr += 5;
-	}
-	else if (*type == CBOR_UINT64_FOLLOWS \
-			|| (*type == (CBOR_NEGINT|CBOR_UINT64_FOLLOWS))) {
-		ptr += 9;
-	}
+	const uint8_t *ptr = buffer;
+	const uint8_t *end = buffer + buffer_len;
+
+	//Open items: items left in definite-length arrays and maps, items read
+	//in indefinite-length ones, and first byte of indefinite-length items
+	//(0 if definite-length)
+	size_t remaining[CBOR_VALIDATE_MAX_DEPTH];
+	uint8_t indefinite[CBOR_VALIDATE_MAX_DEPTH];
+	size_t depth = 0;
+	//True after a tag, until its item starts
+	bool tag_pending = false;
+
+	while (ptr < end) {
+		uint8_t type = *ptr & CBOR_TYPE_MASK;
+		uint8_t info = *ptr & CBOR_INFO_BITS;
+		size_t avail = (size_t)(end - ptr);
+
+		if (*ptr == CBOR_BREAK) {
+			if ((depth == 0) || (indefinite[depth-1] == 0) || tag_pending) {
+				return 0;
+			}
+			//A key without a value
+			if ((indefinite[depth-1] == (CBOR_MAP | CBOR_VAR_FOLLOWS)) && (remaining[depth-1] & 1)) {
+				return 0;
+			}
 
-	//Byte / UTF-8 Strings
-	else if ((*type >= 0x40 && *type <= 0x57) \
-			|| (*type >= 0x60 && *type <= 0x77) ) {
-		ptr += decode_abs_num8(ptr) + 1;
-	}
-	else if (*type == 0x58 || *type == 0x78) {
-		ptr += decode_abs_num8(ptr) + 2;
-	}
-	else if (*type == 0x59 || *type == 0x79) {
-		ptr += decode_abs_num16(ptr) + 3;
-	}
-	else if (*type == 0x5A || *type == 0x7A) {
-		ptr += decode_abs_num32(ptr) + 5;
-	}
-	else if (*type == 0x5B || *type == 0x7B) {
-		ptr += decode_abs_num64(ptr) + 9;
-	}
-	else if (*type == 0x5F || *type == 0x7F) {
-		//Look for break character
-		while (*(++ptr) != CBOR_BREAK) ;
-	}
+			++ptr;
+			--depth;
+		}
+		else {
+			//Indefinite-length strings only contain definite-length strings
+			//of the same type
+			if ((depth > 0) && (indefinite[depth-1] != 0)
+					&& ((indefinite[depth-1] & CBOR_TYPE_MASK) != CBOR_ARRAY)
+					&& ((indefinite[depth-1] & CBOR_TYPE_MASK) != CBOR_MAP)
+					&& ((type != (indefinite[depth-1] & CBOR_TYPE_MASK)) || (info == CBOR_VAR_FOLLOWS))) {
+				return 0;
+			}
 
-	//Array
-	else if (*type >= 0x80 && *type <= 0x97) {
-		uint8_t num_ele = decode_abs_num8(ptr);
-		++ptr;
+			//Decode header
+			uint64_t arg;
+			const uint8_t *next = decode_header(ptr, end, arg);
+			if (next == NULL) {
+				return 0;
+			}
+			avail -= (size_t)(next - ptr);
+			ptr = next;
+			tag_pending = (type == CBOR_TAG);
+
+			if (info == CBOR_VAR_FOLLOWS) {
+				//Indefinite-length string, array or map
+				if (depth == CBOR_VALIDATE_MAX_DEPTH) {
+					return 0;
+				}
+
+				indefinite[depth] = type | CBOR_VAR_FOLLOWS;
+				remaining[depth] = 0;
+				++depth;
+				continue;
+			}
 
-		//Jump every element of the table
-		for (uint8_t i=0 ; i < num_ele ; ++i) {
-			ptr += element_size(ptr);
+			switch (type) {
+				case CBOR_BYTES:
+				case CBOR_TEXT:
+					if (arg > avail) {
+						return 0;
+					}
+					ptr += (size_t)arg;
+					break;
+
+				case CBOR_ARRAY:
+				case CBOR_MAP:
+					//Every element takes at least one byte
+					if ((arg > avail) || ((type == CBOR_MAP) && (arg > avail/2))) {
+						return 0;
+					}
+					if (arg == 0) {
+						break;
+					}
+
+					if (depth == CBOR_VALIDATE_MAX_DEPTH) {
+						return 0;
+					}
+
+					indefinite[depth] = 0;
+					remaining[depth] = (type == CBOR_MAP)?(size_t)(2*arg):(size_t)arg;
+					++depth;
+					continue;
+
+				case CBOR_TAG:
+					//The tagged item follows
+					continue;
+
+				case CBOR_7:
+					//Simple values 0..31 must be encoded in the initial byte
+					if ((info == CBOR_UINT8_FOLLOWS) && (arg < 32)) {
+						return 0;
+					}
+					break;
+
+				default: //CBOR_UINT, CBOR_NEGINT
+					break;
+			}
 		}
-	}
-	else if (*type == 0x98) {
-		uint8_t num_ele = decode_abs_num8(ptr);
-		ptr += 2;
 
-		//Jump every element of the table
-		for (uint8_t i=0 ; i < num_ele ; ++i) {
-			ptr += element_size(ptr);
+		//An item is complete: close the definite-length items it completes
+		while ((depth > 0) && (indefinite[depth-1] == 0)) {
+			if (--remaining[depth-1] > 0) {
+				break;
+			}
+			--depth;
+		}
+		if ((depth > 0) && (indefinite[depth-1] != 0)) {
+			++remaining[depth-1];
 		}
-	}
-	else if (*type == 0x99) {
-		uint16_t num_ele = decode_abs_num16(ptr);
-		ptr += 3;
 
-		//Jump every element of the table
-		for (uint16_t i=0 ; i < num_ele ; ++i) {
-			ptr += element_size(ptr);
+		if (depth == 0) {
+			return (size_t)(ptr - buffer);
 		}
 	}
-	else if (*type == 0x9A) {
-		uint32_t num_ele = decode_abs_num32(ptr);
-		ptr += 5;
 
-		//Jump every element of the table
-		for (uint32_t i=0 ; i < num_ele ; ++i) {
-			ptr += element_size(ptr);
-		}
+	//Truncated
+	return 0;
+}
+
+//Classes of initial bytes (high nibble of cbor_head_class), the low nibble
+//being the length of the header
+#define CBOR_HEAD_SCALAR 0x00
+#define CBOR_HEAD_STRING 0x10
+#define CBOR_HEAD_ARRAY 0x20
+#define CBOR_HEAD_MAP 0x30
+#define CBOR_HEAD_TAG 0x40
+#define CBOR_HEAD_INDEFINITE 0x50
+#define CBOR_HEAD_BREAK 0x60
+#define CBOR_HEAD_INVALID 0x70
+
+//32 initial bytes of a major type: arguments 0..23 in the initial byte,
+//then 1, 2, 4 or 8 bytes, reserved values, and 31 (`last`)
+#define CBOR_HEAD_MAJOR(cls, last) \
+	cls|1, cls|1, cls|1, cls|1, cls|1, cls|1, cls|1, cls|1, \
+	cls|1, cls|1, cls|1, cls|1, cls|1, cls|1, cls|1, cls|1, \
+	cls|1, cls|1, cls|1, cls|1, cls|1, cls|1, cls|1, cls|1, \
+	cls|2, cls|3, cls|5, cls|9, CBOR_HEAD_INVALID, CBOR_HEAD_INVALID, CBOR_HEAD_INVALID, last
+
+//Class and header length of every initial byte
+static const uint8_t cbor_head_class[256] CBOR_PROGMEM = {
+	CBOR_HEAD_MAJOR(CBOR_HEAD_SCALAR, CBOR_HEAD_INVALID),         //Unsigned integers
+	CBOR_HEAD_MAJOR(CBOR_HEAD_SCALAR, CBOR_HEAD_INVALID),         //Negative integers
+	CBOR_HEAD_MAJOR(CBOR_HEAD_STRING, CBOR_HEAD_INDEFINITE|1),    //Byte strings
+	CBOR_HEAD_MAJOR(CBOR_HEAD_STRING, CBOR_HEAD_INDEFINITE|1),    //Text strings
+	CBOR_HEAD_MAJOR(CBOR_HEAD_ARRAY, CBOR_HEAD_INDEFINITE|1),     //Arrays
+	CBOR_HEAD_MAJOR(CBOR_HEAD_MAP, CBOR_HEAD_INDEFINITE|1),       //Maps
+	CBOR_HEAD_MAJOR(CBOR_HEAD_TAG, CBOR_HEAD_INVALID),            //Tags
+	CBOR_HEAD_MAJOR(CBOR_HEAD_SCALAR, CBOR_HEAD_BREAK|1)          //Simple values and floats
+};
+
+//True for the initial byte of an item that takes a single byte (integers
+//from -24 to 23, and simple values from 0 to 23)
+#define CBOR_IS_ONE_BYTE_ITEM(byte) (CBOR_READ_PROGMEM(cbor_head_class[(byte)]) == (CBOR_HEAD_SCALAR|1))
+
+uint8_t CBOR::header_length(uint8_t first_byte)
+{
+	return CBOR_READ_PROGMEM(cbor_head_class[first_byte]) & 0x0F;
+}
+
+const uint8_t* CBOR::decode_header(const uint8_t *ptr, const uint8_t *end, uint64_t &arg)
+{
+	uint8_t info = *ptr & CBOR_INFO_BITS;
+	size_t len = header_length(*ptr);
+
+	if ((len == 0) || (len > (size_t)(end - ptr))) {
+		return NULL;
 	}
-	else if (*type == 0x9B) {
-		uint64_t num_ele = decode_abs_num64(ptr);
-		ptr += 9;
 
-		//Jump every element of the table
-		for (uint64_t i=0 ; i < num_ele ; ++i) {
-			ptr += element_size(ptr);
-		}
+	if (info < CBOR_UINT8_FOLLOWS) {
+		arg = info;
+		return ptr + 1;
 	}
-	else if (*type == 0x9F) {
-		//Jump every element of the table
-		while (*ptr != CBOR_BREAK) {
-			ptr += element_size(ptr);
-		}
+
+	arg = 0;
+	for (size_t i=1 ; i < len ; ++i) {
+		arg = (arg<<8) | ptr[i];
 	}
 
-	//Map
-	else if (*type >= 0xA0 && *type <= 0xB7) {
-		uint8_t num_ele = decode_abs_num8(ptr);
-		++ptr;
+	return ptr + len;
+}
 
-		//Jump every element of the map
-		for (uint8_t i=0 ; i < num_ele ; ++i) {
-			ptr += element_size(ptr);
-			ptr += element_size(ptr);
+size_t CBOR::element_size(uint8_t *ptr)
+{
+	YACL_STAT(element_size_calls, 1);
+	uint8_t *begin = ptr;
+	//Items left in each enclosing array or map, or 0 if indefinite-length
+	size_t remaining[CBOR_SKIP_MAX_DEPTH];
+	uint8_t depth = 0;
+	//Items left in the innermost open item (the top level holds one item)
+	size_t left = 1;
+
+	for (;;) {
+		uint8_t head_class = CBOR_READ_PROGMEM(cbor_head_class[*ptr]);
+		uint8_t head_len = head_class & 0x0F;
+
+		//Runs of scalars (the common case) do not go through the class
+		//switch. Their size is branched on rather than added from the
+		//table: the predicted branch lets the next header be read before
+		//this one is classified.
+		if (head_class < CBOR_HEAD_STRING) {
+			switch (head_len) {
+				case 1:
+					//Skip the following one-byte items at once
+					if ((left > 2) && CBOR_IS_ONE_BYTE_ITEM(ptr[1])) {
+						size_t run = small_run_length(ptr + 1, left - 1);
+						ptr += run;
+						left -= run;
+					}
+					ptr += 1;
+					break;
+				case 2:
+					ptr += 2;
+					break;
+				case 3:
+					ptr += 3;
+					break;
+				case 5:
+					ptr += 5;
+					break;
+				default:
+					ptr += 9;
+					break;
+			}
+			if (left > 1) {
+				--left;
+				continue;
+			}
 		}
-	}
-	else if (*type == 0xB8) {
-		uint8_t num_ele = decode_abs_num8(ptr);
-		ptr += 2;
+		else switch (head_class & 0xF0) {
+			case CBOR_HEAD_STRING:
+				ptr += head_len + ((head_len == 1)?(*ptr & 0x1F):decode_abs_num(ptr));
+				break;
+
+			case CBOR_HEAD_ARRAY:
+			case CBOR_HEAD_MAP: {
+				size_t num_ele = (head_len == 1)?(*ptr & 0x1F):decode_abs_num(ptr);
+				ptr += head_len;
+				if (num_ele == 0) {
+					break;
+				}
+				if (depth == CBOR_SKIP_MAX_DEPTH) {
+					return 0;
+				}
+				remaining[depth++] = left;
+				left = ((head_class & 0xF0) == CBOR_HEAD_MAP)?2*num_ele:num_ele;
+				continue;
+			}
 
-		//Jump every element of the map
-		for (uint8_t i=0 ; i < num_ele ; ++i) {
-			ptr += element_size(ptr);
-			ptr += element_size(ptr);
+			case CBOR_HEAD_TAG:
+				//The tagged item follows
+				ptr += head_len;
+				continue;
+
+			case CBOR_HEAD_INDEFINITE:
+				if (depth == CBOR_SKIP_MAX_DEPTH) {
+					return 0;
+				}
+				++ptr;
+				remaining[depth++] = left;
+				left = 0;
+				continue;
+
+			case CBOR_HEAD_BREAK:
+				//Only closes an indefinite-length item (never the top level)
+				if (left != 0) {
+					return 0;
+				}
+				++ptr;
+				left = remaining[--depth];
+				break;
+
+			default:
+				return 0;
 		}
-	}
-	else if (*type == 0xB9) {
-		uint16_t num_ele = decode_abs_num16(ptr);
-		ptr += 3;
 
-		//Jump every element of the map
-		for (uint16_t i=0 ; i < num_ele ; ++i) {
-			ptr += element_size(ptr);
-			ptr += element_size(ptr);
+		//An item is complete: close the arrays and maps it completes
+		while ((left != 0) && (--left == 0)) {
+			if (depth == 0) {
+				return (size_t)(ptr - begin);
+			}
+			left = remaining[--depth];
 		}
 	}
-	else if (*type == 0xBA) {
-		uint32_t num_ele = decode_abs_num32(ptr);
-		ptr += 5;
+}
 
-		//Jump every element of the map
-		for (uint32_t i=0 ; i < num_ele ; ++i) {
-			ptr += element_size(ptr);
-			ptr += element_size(ptr);
+size_t CBOR::small_run_length(const uint8_t *ptr, size_t max_items)
+{
+	size_t len = 0;
+
+	//A byte is a one-byte item if its argument is below 24 and its major
+	//type is 0, 1 (top bits 00) or 7 (top bits 111). As every item takes
+	//at least one byte, no more than `max_items` bytes are read.
+#if defined(CBOR_SIMD_AVX2)
+	const __m256i arg_mask32 = _mm256_set1_epi8(0x1F);
+	const __m256i arg_limit32 = _mm256_set1_epi8(24);
+	const __m256i int_mask32 = _mm256_set1_epi8((char)0xC0);
+	const __m256i simple_mask32 = _mm256_set1_epi8((char)0xE0);
+
+	while (max_items - len >= 32) {
+		__m256i bytes = _mm256_loadu_si256((const __m256i*)(ptr + len));
+		__m256i small_arg = _mm256_cmpgt_epi8(arg_limit32, _mm256_and_si256(bytes, arg_mask32));
+		__m256i int_type = _mm256_cmpeq_epi8(_mm256_and_si256(bytes, int_mask32), _mm256_setzero_si256());
+		__m256i simple_type = _mm256_cmpeq_epi8(_mm256_and_si256(bytes, simple_mask32), simple_mask32);
+		uint32_t one_byte = (uint32_t)_mm256_movemask_epi8(
+				_mm256_and_si256(small_arg, _mm256_or_si256(int_type, simple_type)));
+		if (one_byte != 0xFFFFFFFF) {
+			return len + __builtin_ctz(~one_byte);
 		}
-	}
-	else if (*type == 0xBB) {
-		uint64_t num_ele = decode_abs_num64(ptr);
-		ptr += 9;
-
-		//Jump every element of the map
-		for (uint64_t i=0 ; i < num_ele ; ++i) {
-			ptr += element_size(ptr);
-			ptr += element_size(ptr);
+		len += 32;
+	}
+#endif
+
+#if defined(CBOR_SIMD_SSE2)
+	const __m128i arg_mask = _mm_set1_epi8(0x1F);
+	const __m128i arg_limit = _mm_set1_epi8(24);
+	const __m128i int_mask = _mm_set1_epi8((char)0xC0);
+	const __m128i simple_mask = _mm_set1_epi8((char)0xE0);
+
+	while (max_items - len >= 16) {
+		__m128i bytes = _mm_loadu_si128((const __m128i*)(ptr + len));
+		__m128i small_arg = _mm_cmplt_epi8(_mm_and_si128(bytes, arg_mask), arg_limit);
+		__m128i int_type = _mm_cmpeq_epi8(_mm_and_si128(bytes, int_mask), _mm_setzero_si128());
+		__m128i simple_type = _mm_cmpeq_epi8(_mm_and_si128(bytes, simple_mask), simple_mask);
+		uint32_t one_byte = (uint32_t)_mm_movemask_epi8(
+				_mm_and_si128(small_arg, _mm_or_si128(int_type, simple_type)));
+		if (one_byte != 0xFFFF) {
+			return len + __builtin_ctz(~one_byte);
 		}
-	}
-	else if (*type == 0xBF) {
-		//Jump every element of the map
-		while (*ptr != CBOR_BREAK) {
-			ptr += element_size(ptr);
-			ptr += element_size(ptr);
+		len += 16;
+	}
+#elif defined(CBOR_SIMD_NEON)
+	const uint8x16_t arg_mask = vdupq_n_u8(0x1F);
+	const uint8x16_t arg_limit = vdupq_n_u8(24);
+	const uint8x16_t int_limit = vdupq_n_u8(0x40);
+	const uint8x16_t simple_min = vdupq_n_u8(0xE0);
+
+	while (max_items - len >= 16) {
+		uint8x16_t bytes = vld1q_u8(ptr + len);
+		uint8x16_t small_arg = vcltq_u8(vandq_u8(bytes, arg_mask), arg_limit);
+		uint8x16_t one_byte = vandq_u8(small_arg,
+				vorrq_u8(vcltq_u8(bytes, int_limit), vcgeq_u8(bytes, simple_min)));
+		//One nibble per byte (no movemask on NEON)
+		uint64_t nibbles = vget_lane_u64(vreinterpret_u64_u8(
+				vshrn_n_u16(vreinterpretq_u16_u8(one_byte), 4)), 0);
+		if (nibbles != (uint64_t)-1) {
+			return len + (__builtin_ctzll(~nibbles) >> 2);
 		}
+		len += 16;
 	}
+#endif
 
-	//Tags
-	else if(*type >= 0xC0 && *type <= 0xDB) {
-		//Size of tag value
-		ptr += compute_type_num_len(decode_abs_num(ptr));
-		//Size of tag item
-		ptr += element_size(ptr);
-	}
-
-	//Simple value && false / true / null / undefined / floats
-	else if (*type >= 0xE0 && *type <= 0xF7) {
-		++ptr;
-	}
-	else if (*type == 0xF8) {
-		ptr += 2;
-	}
-	else if (*type == CBOR_FLOAT16) {
-		ptr += 3;
-	}
-	else if (*type == CBOR_FLOAT32) {
-		ptr += 5;
-	}
-	else if (*type == CBOR_FLOAT64) {
-		ptr += 9;
-	}
-	else {
-		return 0;
+	while ((len < max_items) && CBOR_IS_ONE_BYTE_ITEM(ptr[len])) {
+		++len;
 	}
 
-	return (ptr - type);
+	return len;
 }
 
 bool CBOR::buffer_equals(const uint8_t* buf1, size_t len_buf1,
@@ -501,6 +869,8 @@ bool CBOR::buffer_equals(const uint8_t* buf1, size_t len_buf1,
 
 bool CBOR::add()
 {
+	YACL_PROFILE_SCOPE(CBOR_PROFILE_ADD);
+
 	if (!reserve(length() + 1)) {
 		return false;
 	}
@@ -512,6 +882,8 @@ bool CBOR::add()
 
 bool CBOR::add(bool value)
 {
+	YACL_PROFILE_SCOPE(CBOR_PROFILE_ADD);
+
 	if (!reserve(length() + 1)) {
 		return false;
 	}
@@ -523,6 +895,8 @@ bool CBOR::add(bool value)
 
 bool CBOR::add(char value)
 {
+	YACL_PROFILE_SCOPE(CBOR_PROFILE_ADD);
+
 	if (value < 0) {
 		return encode_type_num(CBOR_NEGINT, (unsigned char)(-1-value));
 	}
@@ -533,6 +907,8 @@ bool CBOR::add(char value)
 
 bool CBOR::add(signed char value)
 {
+	YACL_PROFILE_SCOPE(CBOR_PROFILE_ADD);
+
 	if (value < 0) {
 		return encode_type_num(CBOR_NEGINT, (unsigned char)(-1-value));
 	}
@@ -543,6 +919,8 @@ bool CBOR::add(signed char value)
 
 bool CBOR::add(short value)
 {
+	YACL_PROFILE_SCOPE(CBOR_PROFILE_ADD);
+
 	if (value < 0) {
 		return encode_type_num(CBOR_NEGINT, (unsigned short)(-1-value));
 	}
@@ -553,6 +931,8 @@ bool CBOR::add(short value)
 
 bool CBOR::add(int value)
 {
+	YACL_PROFILE_SCOPE(CBOR_PROFILE_ADD);
+
 	if (value < 0) {
 		return encode_type_num(CBOR_NEGINT, (unsigned int)(-1-value));
 	}
@@ -563,6 +943,8 @@ bool CBOR::add(int value)
 
 bool CBOR::add(long value)
 {
+	YACL_PROFILE_SCOPE(CBOR_PROFILE_ADD);
+
 	if (value < 0) {
 		return encode_type_num(CBOR_NEGINT, (unsigned long)(-1-value));
 	}
@@ -573,6 +955,8 @@ bool CBOR::add(long value)
 
 bool CBOR::add(long long value)
 {
+	YACL_PROFILE_SCOPE(CBOR_PROFILE_ADD);
+
 	if (value < 0) {
 		return encode_type_num(CBOR_NEGINT, (unsigned long long)(-1-value));
 	}
@@ -581,10 +965,186 @@ bool CBOR::add(long long value)
 	}
 }
 
+bool CBOR::shortest_float = CBOR_SHORTEST_FLOAT;
+
+bool CBOR::float_to_half(float value, uint16_t &half)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+
+	uint16_t sign = (uint16_t)((bits>>16) & 0x8000);
+	int16_t exp = (int16_t)((bits>>23) & 0xFF);
+	uint32_t mant = bits & 0x7FFFFF;
+
+	//Infinity / NaN (payload must fit in 10 bits)
+	if (exp == 0xFF) {
+		if (mant & 0x1FFF) {
+			return false;
+		}
+		half = sign | 0x7C00 | (uint16_t)(mant>>13);
+		return true;
+	}
+
+	//Zero (float subnormals are too small for half precision)
+	if (exp == 0) {
+		if (mant != 0) {
+			return false;
+		}
+		half = sign;
+		return true;
+	}
+
+	exp -= 127;
+	if ((exp > 15) || (exp < -24)) {
+		return false;
+	}
+
+	//Normal
+	if (exp >= -14) {
+		if (mant & 0x1FFF) {
+			return false;
+		}
+		half = sign | (uint16_t)((exp + 15)<<10) | (uint16_t)(mant>>13);
+		return true;
+	}
+
+	//Subnormal: value is (1.mant)*2^exp = half*2^-24
+	uint32_t full = mant | 0x800000;
+	uint8_t shift = (uint8_t)(-1 - exp);
+	if (full & (((uint32_t)1<<shift) - 1)) {
+		return false;
+	}
+	half = sign | (uint16_t)(full>>shift);
+
+	return true;
+}
+
+float CBOR::half_to_float(uint16_t half)
+{
+	uint32_t bits = (uint32_t)(half & 0x8000)<<16;
+	int16_t exp = (half>>10) & 0x1F;
+	uint32_t mant = half & 0x3FF;
+
+	//Infinity / NaN
+	if (exp == 0x1F) {
+		bits |= 0x7F800000 | (mant<<13);
+	}
+	//Subnormal: normalize
+	else if (exp == 0) {
+		if (mant != 0) {
+			exp = 1;
+			while (!(mant & 0x400)) {
+				mant <<= 1;
+				--exp;
+			}
+			bits |= ((uint32_t)(exp - 15 + 127)<<23) | ((mant & 0x3FF)<<13);
+		}
+	}
+	else {
+		bits |= ((uint32_t)(exp - 15 + 127)<<23) | (mant<<13);
+	}
+
+	float ret_val;
+	memcpy(&ret_val, &bits, sizeof(ret_val));
+
+	return ret_val;
+}
+
+double CBOR::double_from_bits(uint64_t bits)
+{
+	double ret_val = 0.0;
+
+	//On AVR arduino, double is the same as float...
+	//In this case, we convert from 64-bit float to 32-bit float
+	if (sizeof(double) == 4) {
+		int32_t exp = (int32_t)((bits>>52) & 0x7FF);
+		uint32_t mant = (uint32_t)((bits>>29) & 0x7FFFFF);
+		//Subnormals
+		if (exp == 0) {
+			ret_val = ldexp(mant, -149);
+		}
+		//Infinity / NaN
+		else if (exp == 0x7FF) {
+			ret_val = (mant == 0) ? INFINITY : NAN;
+		}
+		//Too big
+		else if ((exp-1023) > 127) {
+			ret_val = INFINITY;
+		}
+		//Too little
+		else if ((exp-1023) < -126) {
+			ret_val = 0.0;
+		}
+		else {
+			ret_val = ldexp((float)mant + 8388608.0, (exp-1023) - 23);
+		}
+
+		return (bits>>63) ? -ret_val : ret_val;
+	}
+
+	memcpy(&ret_val, &bits, sizeof(ret_val));
+
+	return ret_val;
+}
+
+bool CBOR::double_to_float(double value, float &single)
+{
+	single = (float)value;
+
+	//Not NaN
+	if (value == value) {
+		return ((double)single == value);
+	}
+
+	//NaN: payload must fit in 23 bits
+	uint64_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	if (bits & 0x1FFFFFFF) {
+		return false;
+	}
+	uint32_t single_bits = (uint32_t)((bits>>32) & 0x80000000) | 0x7F800000
+		| (uint32_t)((bits>>29) & 0x7FFFFF);
+	memcpy(&single, &single_bits, sizeof(single));
+
+	return true;
+}
+
+size_t CBOR::encoded_len(float value)
+{
+	uint16_t half;
+
+	return (shortest_float && float_to_half(value, half))?3:5;
+}
+
+size_t CBOR::encoded_len(double value)
+{
+	float single;
+
+	if ((sizeof(double) == 4) || (shortest_float && double_to_float(value, single))) {
+		return encoded_len((float)value);
+	}
+
+	return 9;
+}
+
 //Caution! This considers a 32bit float and IEEE 754 representation in memory
 bool CBOR::add(float value)
 {
+	YACL_PROFILE_SCOPE(CBOR_PROFILE_ADD);
+
 	uint8_t *val_bytes = NULL;
+	uint16_t half;
+
+	if (shortest_float && float_to_half(value, half)) {
+		if (!reserve(length() + 3)) {
+			return false;
+		}
+
+		*(w_ptr++) = CBOR_FLOAT16;
+		*(w_ptr++) = (uint8_t)(half>>8);
+		*(w_ptr++) = (uint8_t)half;
+		return true;
+	}
 
 	if (!reserve(length() + 5)) {
 		return false;
@@ -603,11 +1163,18 @@ bool CBOR::add(float value)
 //Caution! This considers a 64bit float and IEEE 754 representation in memory
 bool CBOR::add(double value)
 {
+	YACL_PROFILE_SCOPE(CBOR_PROFILE_ADD);
+
 	//On AVR arduino, double is the same as float...
 	if (sizeof(double) == 4) {
 		return add((float)value);
 	}
 
+	float single;
+	if (shortest_float && double_to_float(value, single)) {
+		return add(single);
+	}
+
 	uint8_t *val_bytes = NULL;
 	if (!reserve(length() + 9)) {
 		return false;
@@ -630,6 +1197,8 @@ bool CBOR::add(double value)
 
 bool CBOR::add(const char* value)
 {
+	YACL_PROFILE_SCOPE(CBOR_PROFILE_ADD);
+
 	size_t len_string = strlen(value);
 
 	//Check buffer size
@@ -652,6 +1221,8 @@ bool CBOR::add(const char* value)
 
 bool CBOR::add(const uint8_t* value, size_t len)
 {
+	YACL_PROFILE_SCOPE(CBOR_PROFILE_ADD);
+
 	//Check buffer size
 	if (!reserve(length() + len + compute_type_num_len(len))) {
 		return false;
@@ -672,12 +1243,15 @@ bool CBOR::add(const uint8_t* value, size_t len)
 
 bool CBOR::add(const CBOR &value)
 {
+	YACL_PROFILE_SCOPE(CBOR_PROFILE_ADD);
+
 	size_t len_cbor = value.length();
 	if (!reserve(length() + len_cbor)) {
 		return false;
 	}
 
 	memcpy(w_ptr, value.to_CBOR(), len_cbor*sizeof(uint8_t));
+	YACL_STAT(bytes_copied, len_cbor);
 
 	w_ptr += len_cbor;
 
@@ -853,33 +1427,21 @@ bool CBOR::is_tag(const uint8_t* buffer)
 
 CBOR::operator bool() const
 {
+	YACL_PROFILE_SCOPE(CBOR_PROFILE_CAST);
 	return (get_const_buffer_begin()[0] == CBOR_TRUE)?true:false;
 }
 
 CBOR::operator float() const
 {
+	YACL_PROFILE_SCOPE(CBOR_PROFILE_CAST);
+
 	float ret_val = 0.0;
 	uint8_t *ret_val_bytes = (uint8_t*)&ret_val;
 	const uint8_t *buf = NULL;
 
 	if (is_float16()) {
 		buf = get_const_buffer_begin();
-		uint8_t exp = (buf[1]>>2)&0x1f;
-		uint16_t mant = (buf[1]&0x03)<<8 | buf[2];
-
-		//Subnormals
-		if (exp == 0) {
-			ret_val = ldexp(mant, -24);
-		}
-		//NaN / Infinity
-		else if (exp == 31) {
-			ret_val = (mant == 0) ? INFINITY : NAN;
-		}
-		else {
-			ret_val = ldexp(mant + 1024, exp - 25);
-		}
-
-		return (buf[1]&0x80) ? -ret_val : ret_val;
+		return half_to_float((uint16_t)(buf[1]<<8 | buf[2]));
 	}
 
 	if (is_float32()) {
@@ -898,84 +1460,75 @@ CBOR::operator float() const
 
 CBOR::operator double() const
 {
+	YACL_PROFILE_SCOPE(CBOR_PROFILE_CAST);
+
 	if (is_float16() || is_float32()) {
 		return (double)((float)(*this));
 	}
 
-	double ret_val = 0.0;
-	uint8_t *ret_val_bytes = (uint8_t*)&ret_val;
-	const uint8_t *buf = NULL;
-
 	if (is_float64()) {
-		//On AVR arduino, double is the same as float...
-		//In this case, we convert from 64-bit float to 32-bit float
-		if(sizeof(double) == 4) {
-			buf = get_const_buffer_begin();
-			int32_t exp = ((buf[1]&0x7F)<<4)|((buf[2]&0xF0)>>4);
-			uint32_t mant = ((uint32_t)(buf[2]&0x0F)<<19) \
-							| ((uint32_t)(buf[3])<<11) \
-							| ((uint32_t)(buf[4])<<3) \
-							| ((uint32_t)((buf[5])&0xE0)>>5);
-			//Subnormals
-			if (exp == 0) {
-				ret_val = ldexp(mant, -149);
-			}
-			//Infinity / NaN
-			else if (exp == 0x7FF) {
-				ret_val = (mant == 0) ? INFINITY : NAN;
-			}
-			//Too big
-			else if ((exp-1023) > 127) {
-				ret_val = INFINITY;
-			}
-			//Too little
-			else if ((exp-1023) < -126) {
-				ret_val = 0.0;
-			}
-			else {
-				ret_val = ldexp((float)mant + 8388608.0, (exp-1023) - 23);
-			}
+		return double_from_bits(read_be64(get_const_buffer_begin() + 1));
+	}
+
+	return 0.0;
+}
 
-			return (buf[1]&0x80) ? -ret_val : ret_val;
+size_t CBOR::copy_string(const uint8_t *ptr, uint8_t *dest)
+{
+	if ((ptr[0] & CBOR_INFO_BITS) != CBOR_VAR_FOLLOWS) {
+		size_t len = decode_abs_num(ptr);
+		if (dest != NULL) {
+			memcpy(dest, ptr + compute_type_num_len(len), len*sizeof(uint8_t));
 		}
 
-		buf = get_const_buffer_begin() + 8;
+		return len;
+	}
 
-		*(ret_val_bytes++) = *(buf--);
-		*(ret_val_bytes++) = *(buf--);
-		*(ret_val_bytes++) = *(buf--);
-		*(ret_val_bytes++) = *(buf--);
-		*(ret_val_bytes++) = *(buf--);
-		*(ret_val_bytes++) = *(buf--);
-		*(ret_val_bytes++) = *(buf--);
-		*ret_val_bytes = *buf;
+	//Indefinite-length: concatenate definite-length chunks up to the break
+	size_t len = 0;
+	++ptr;
+	while (*ptr != CBOR_BREAK) {
+		size_t chunk_len = decode_abs_num(ptr);
+		const uint8_t *chunk = ptr + element_size((uint8_t*)ptr) - chunk_len;
+		if (dest != NULL) {
+			memcpy(dest + len, chunk, chunk_len*sizeof(uint8_t));
+		}
 
-		return ret_val;
+		len += chunk_len;
+		ptr = chunk + chunk_len;
 	}
 
-	return 0.0;
+	return len;
 }
 
 void CBOR::get_string(char* str) const
 {
-	size_t len_str = get_string_len();
-
-	memcpy(str, get_const_buffer_begin() + compute_type_num_len(len_str),
-			len_str*sizeof(uint8_t));
-	str[len_str] = '\0';
+	str[copy_string(get_const_buffer_begin(), (uint8_t*)str)] = '\0';
 }
 
 void CBOR::get_string(String& str) const
 {
-	size_t len_str = get_string_len();
+	const uint8_t *chunk = get_const_buffer_begin();
+	bool chunked = ((chunk[0] & CBOR_INFO_BITS) == CBOR_VAR_FOLLOWS);
 
-	str.reserve(length() + len_str);
+	str.reserve(get_string_len());
 
 	str = "";
-	for (const uint8_t* i=get_const_buffer_begin() + compute_type_num_len(len_str)
-		   	; i < (get_const_buffer_begin() + compute_type_num_len(len_str) + len_str)
-			; ++i) {
-		str += (char)(*i);
+	if (chunked) {
+		++chunk;
+	}
+	while (!chunked || (*chunk != CBOR_BREAK)) {
+		size_t chunk_len = decode_abs_num(chunk);
+		const uint8_t *data = chunk + element_size((uint8_t*)chunk) - chunk_len;
+
+		for (const uint8_t* i=data ; i < (data + chunk_len) ; ++i) {
+			str += (char)(*i);
+		}
+
+		if (!chunked) {
+			break;
+		}
+		chunk = data + chunk_len;
 	}
 }
 
@@ -990,10 +1543,7 @@ String CBOR::to_string() const
 
 void CBOR::get_bytestring(uint8_t* bytestr) const
 {
-	size_t len_bytestr = get_bytestring_len();
-
-	memcpy(bytestr, get_const_buffer_begin() + compute_type_num_len(len_bytestr),
-			len_bytestr*sizeof(uint8_t));
+	copy_string(get_const_buffer_begin(), bytestr);
 }
 
 
@@ -1012,12 +1562,1546 @@ CBOR CBOR::get_tag_item()
 	return CBOR(ele_begin, element_size(ele_begin), true);
 }
 
+void CBOR::copy_typed_array(uint8_t *dst, const uint8_t *src, size_t num_ele,
+		uint8_t elem_size, bool swap)
+{
+	if (!swap) {
+		memcpy(dst, src, num_ele*elem_size);
+		return;
+	}
+
+	for (size_t i=0 ; i < num_ele ; ++i) {
+		for (uint8_t j=0 ; j < elem_size ; ++j) {
+			dst[j] = src[elem_size-1-j];
+		}
+		dst += elem_size;
+		src += elem_size;
+	}
+}
+
+uint8_t CBOR::typed_array_elem_size(uint8_t tag)
+{
+	uint8_t ll = tag & 0x03;
+
+	if (tag & CBOR_TYPED_ARRAY_FLOAT) {
+		//float16, float32, float64, float128
+		return 2 << ll;
+	}
+
+	return 1 << ll;
+}
+
+const uint8_t* CBOR::typed_array_data(const uint8_t *ptr, uint8_t &tag, size_t &len)
+{
+	if ((ptr[0] != (CBOR_TAG | CBOR_UINT8_FOLLOWS)) || (ptr[1] < CBOR_TYPED_ARRAY_FIRST)
+			|| (ptr[1] > CBOR_TYPED_ARRAY_LAST)) {
+		return NULL;
+	}
+	tag = ptr[1];
+
+	//sint8 "clamped" is reserved
+	if (tag == (CBOR_TYPED_ARRAY_FIRST | CBOR_TYPED_ARRAY_SIGNED | CBOR_TYPED_ARRAY_LE)) {
+		return NULL;
+	}
+
+	const uint8_t *content = ptr + 2;
+	if (!is_bytestring(content) || ((content[0] & CBOR_INFO_BITS) == CBOR_VAR_FOLLOWS)) {
+		return NULL;
+	}
+
+	len = decode_abs_num(content);
+	if ((len % typed_array_elem_size(tag)) != 0) {
+		return NULL;
+	}
+
+	return content + compute_type_num_len(len);
+}
+
+bool CBOR::add_typed_array(const uint8_t *values, size_t num_ele, uint8_t elem_size,
+		uint8_t tag, bool swap)
+{
+	size_t len = num_ele*elem_size;
+
+	//Check buffer size
+	if (!reserve(length() + 2 + compute_type_num_len(len) + len)) {
+		return false;
+	}
+
+	encode_type_num(CBOR_TAG, tag);
+	encode_type_num(CBOR_BYTES, len);
+	copy_typed_array(w_ptr, values, num_ele, elem_size, swap);
+	w_ptr += len;
+
+	return true;
+}
+
+//Argument of the CBOR encoding of an integer: `value`, or `-1-value`
+//(computed as `~value`, which cannot overflow) for negative values. U is
+//the unsigned type of the same size as S.
+template <typename S, typename U> static inline U int_argument(S value, uint8_t &major)
+{
+	U mask = (value < 0)?(U)(-1):(U)0;
+	major = (uint8_t)(mask & CBOR_NEGINT);
+
+	return (U)((U)value ^ mask);
+}
+
+//Encoded size of integers, from their argument, one at a time
+template <typename S, typename U> static size_t int_array_size(const S *values, size_t num_ele)
+{
+	size_t size = 0;
+
+	for (size_t i=0 ; i < num_ele ; ++i) {
+		uint8_t major;
+		uint64_t arg = int_argument<S, U>(values[i], major);
+		size += 1 + (arg > 23) + (arg > 0xFF) + 2*(arg > 0xFFFF) + 4*(arg > 0xFFFFFFFF);
+	}
+
+	return size;
+}
+
+#if defined(CBOR_SIMD_SSE2)
+//Encoded size of 8, 16 and 32-bit integers, 16, 8 and 4 at a time: the
+//arguments are compared to the size limits in each lane, and the lanes
+//over each limit are counted from the comparison masks.
+template <bool is_signed> static size_t int8_array_size(const uint8_t *values, size_t num_ele)
+{
+	const __m128i limit = _mm_set1_epi8(23);
+	size_t size = 0;
+	size_t i = 0;
+
+	for ( ; i + 16 <= num_ele ; i += 16) {
+		__m128i arg = _mm_loadu_si128((const __m128i*)(values + i));
+		if (is_signed) {
+			arg = _mm_xor_si128(arg, _mm_cmpgt_epi8(_mm_setzero_si128(), arg));
+		}
+		//Lanes with a one-byte encoding (argument <= 23)
+		uint32_t small = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_subs_epu8(arg, limit), _mm_setzero_si128()));
+		size += 32 - __builtin_popcount(small);
+	}
+
+	if (is_signed) {
+		return size + int_array_size<int8_t, uint8_t>((const int8_t*)values + i, num_ele - i);
+	}
+	return size + int_array_size<uint8_t, uint8_t>(values + i, num_ele - i);
+}
+
+template <bool is_signed> static size_t int16_array_size(const uint16_t *values, size_t num_ele)
+{
+	const __m128i limit = _mm_set1_epi16(23);
+	size_t size = 0;
+	size_t i = 0;
+
+	for ( ; i + 8 <= num_ele ; i += 8) {
+		__m128i arg = _mm_loadu_si128((const __m128i*)(values + i));
+		if (is_signed) {
+			arg = _mm_xor_si128(arg, _mm_srai_epi16(arg, 15));
+		}
+		//Two mask bits per lane: lanes with a one-byte encoding (argument
+		//<= 23), and lanes without a 16-bit payload (argument <= 0xFF)
+		uint32_t small = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_subs_epu16(arg, limit), _mm_setzero_si128()));
+		uint32_t byte = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_srli_epi16(arg, 8), _mm_setzero_si128()));
+		size += 24 - (__builtin_popcount(small) + __builtin_popcount(byte))/2;
+	}
+
+	if (is_signed) {
+		return size + int_array_size<int16_t, uint16_t>((const int16_t*)values + i, num_ele - i);
+	}
+	return size + int_array_size<uint16_t, uint16_t>(values + i, num_ele - i);
+}
+
+template <bool is_signed> static size_t int32_array_size(const uint32_t *values, size_t num_ele)
+{
+	//SSE2 only compares signed lanes: arguments and limits are biased
+	const __m128i bias = _mm_set1_epi32((int)0x80000000);
+	const __m128i limit8 = _mm_set1_epi32((int)(23 ^ 0x80000000));
+	const __m128i limit16 = _mm_set1_epi32((int)(0xFF ^ 0x80000000));
+	const __m128i limit32 = _mm_set1_epi32((int)(0xFFFF ^ 0x80000000));
+	size_t size = 0;
+	size_t i = 0;
+
+	for ( ; i + 4 <= num_ele ; i += 4) {
+		__m128i arg = _mm_loadu_si128((const __m128i*)(values + i));
+		if (is_signed) {
+			arg = _mm_xor_si128(arg, _mm_srai_epi32(arg, 31));
+		}
+		arg = _mm_xor_si128(arg, bias);
+		//One mask bit per lane: arguments over 23, 0xFF and 0xFFFF
+		uint32_t over8 = (uint32_t)_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(arg, limit8)));
+		uint32_t over16 = (uint32_t)_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(arg, limit16)));
+		uint32_t over32 = (uint32_t)_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(arg, limit32)));
+		size += 4 + __builtin_popcount(over8) + __builtin_popcount(over16) + 2*__builtin_popcount(over32);
+	}
+
+	if (is_signed) {
+		return size + int_array_size<int32_t, uint32_t>((const int32_t*)values + i, num_ele - i);
+	}
+	return size + int_array_size<uint32_t, uint32_t>(values + i, num_ele - i);
+}
+#endif
+
+//Write the shortest encoding of integers
+template <typename S, typename U> static uint8_t* write_int_array(uint8_t *out, const S *values, size_t num_ele)
+{
+	for (size_t i=0 ; i < num_ele ; ++i) {
+		uint8_t major;
+		U arg = int_argument<S, U>(values[i], major);
+
+		//Payloads are written with shifts, merged by compilers into a
+		//single (byte-swapped) store
+		if (arg <= 23) {
+			*(out++) = major | (uint8_t)arg;
+		}
+		else if (arg <= 0xFF) {
+			out[0] = major | CBOR_UINT8_FOLLOWS;
+			out[1] = (uint8_t)arg;
+			out += 2;
+		}
+		else if ((uint64_t)arg <= 0xFFFF) {
+			out[0] = major | CBOR_UINT16_FOLLOWS;
+			out[1] = (uint8_t)((uint64_t)arg >> 8);
+			out[2] = (uint8_t)arg;
+			out += 3;
+		}
+		else if ((uint64_t)arg <= 0xFFFFFFFF) {
+			out[0] = major | CBOR_UINT32_FOLLOWS;
+			out[1] = (uint8_t)((uint64_t)arg >> 24);
+			out[2] = (uint8_t)((uint64_t)arg >> 16);
+			out[3] = (uint8_t)((uint64_t)arg >> 8);
+			out[4] = (uint8_t)arg;
+			out += 5;
+		}
+		else {
+			out[0] = major | CBOR_UINT64_FOLLOWS;
+			for (uint8_t b=0 ; b < 8 ; ++b) {
+				out[1 + b] = (uint8_t)((uint64_t)arg >> (56 - 8*b));
+			}
+			out += 9;
+		}
+	}
+
+	return out;
+}
+
+bool CBOR::add_int_array(const uint8_t *values, size_t num_ele, uint8_t elem_size, bool is_signed)
+{
+	size_t size;
+
+	switch (elem_size | (is_signed?0x10:0)) {
+#if defined(CBOR_SIMD_SSE2)
+		case 1:
+			size = int8_array_size<false>(values, num_ele);
+			break;
+		case 0x11:
+			size = int8_array_size<true>(values, num_ele);
+			break;
+		case 2:
+			size = int16_array_size<false>((const uint16_t*)values, num_ele);
+			break;
+		case 0x12:
+			size = int16_array_size<true>((const uint16_t*)values, num_ele);
+			break;
+		case 4:
+			size = int32_array_size<false>((const uint32_t*)values, num_ele);
+			break;
+		case 0x14:
+			size = int32_array_size<true>((const uint32_t*)values, num_ele);
+			break;
+#else
+		case 1:
+			size = int_array_size<uint8_t, uint8_t>(values, num_ele);
+			break;
+		case 0x11:
+			size = int_array_size<int8_t, uint8_t>((const int8_t*)values, num_ele);
+			break;
+		case 2:
+			size = int_array_size<uint16_t, uint16_t>((const uint16_t*)values, num_ele);
+			break;
+		case 0x12:
+			size = int_array_size<int16_t, uint16_t>((const int16_t*)values, num_ele);
+			break;
+		case 4:
+			size = int_array_size<uint32_t, uint32_t>((const uint32_t*)values, num_ele);
+			break;
+		case 0x14:
+			size = int_array_size<int32_t, uint32_t>((const int32_t*)values, num_ele);
+			break;
+#endif
+		case 8:
+			size = int_array_size<uint64_t, uint64_t>((const uint64_t*)values, num_ele);
+			break;
+		case 0x18:
+			size = int_array_size<int64_t, uint64_t>((const int64_t*)values, num_ele);
+			break;
+		default:
+			return false;
+	}
+
+	if (!reserve(length() + size)) {
+		return false;
+	}
+
+	switch (elem_size | (is_signed?0x10:0)) {
+		case 1:
+			w_ptr = write_int_array<uint8_t, uint8_t>(w_ptr, values, num_ele);
+			break;
+		case 0x11:
+			w_ptr = write_int_array<int8_t, uint8_t>(w_ptr, (const int8_t*)values, num_ele);
+			break;
+		case 2:
+			w_ptr = write_int_array<uint16_t, uint16_t>(w_ptr, (const uint16_t*)values, num_ele);
+			break;
+		case 0x12:
+			w_ptr = write_int_array<int16_t, uint16_t>(w_ptr, (const int16_t*)values, num_ele);
+			break;
+		case 4:
+			w_ptr = write_int_array<uint32_t, uint32_t>(w_ptr, (const uint32_t*)values, num_ele);
+			break;
+		case 0x14:
+			w_ptr = write_int_array<int32_t, uint32_t>(w_ptr, (const int32_t*)values, num_ele);
+			break;
+		case 8:
+			w_ptr = write_int_array<uint64_t, uint64_t>(w_ptr, (const uint64_t*)values, num_ele);
+			break;
+		case 0x18:
+			w_ptr = write_int_array<int64_t, uint64_t>(w_ptr, (const int64_t*)values, num_ele);
+			break;
+	}
+
+	return true;
+}
+
+size_t CBOR::get_typed_array_len() const
+{
+	uint8_t tag;
+	size_t len;
+
+	if (typed_array_data(get_const_buffer_begin(), tag, len) == NULL) {
+		return 0;
+	}
+
+	return len/typed_array_elem_size(tag);
+}
+
 size_t CBOR::n_elements() const
 {
-	if (is_array() || is_pair()) {
-		return decode_abs_num(get_const_buffer_begin());
+	if (!is_array() && !is_pair()) {
+		return 0;
+	}
+
+	const uint8_t *begin = get_const_buffer_begin();
+	if ((begin[0] & CBOR_INFO_BITS) != CBOR_VAR_FOLLOWS) {
+		return decode_abs_num(begin);
+	}
+
+	//Indefinite-length: count elements up to the break (or the end of the
+	//data, if it was not appended yet)
+	bool pair = is_pair();
+	const uint8_t *end = begin + length();
+	uint8_t *ptr = (uint8_t*)begin + 1;
+	size_t num_ele = 0;
+
+	while ((ptr < end) && (*ptr != CBOR_BREAK)) {
+		size_t ele_size = element_size(ptr);
+		if (pair && (ele_size > 0)) {
+			ele_size += element_size(ptr + ele_size);
+		}
+		if (ele_size == 0) {
+			break;
+		}
+
+		ptr += ele_size;
+		++num_ele;
+	}
+
+	return num_ele;
+}
+
+
+uint8_t* CBOR::element_ptr(size_t idx)
+{
+	size_t first = 0;
+	uint8_t *ele_begin = data_begin();
+
+	if (indexes != NULL) {
+		if (indexes->auto_index && (idx >= indexes->ele_index_len)) {
+			build_index();
+		}
+
+		if (indexes->ele_index_len > 0) {
+			if (idx < indexes->ele_index_len) {
+				return ele_begin + indexes->ele_index[idx];
+			}
+
+			//Start from the last indexed element
+			first = indexes->ele_index_len - 1;
+			ele_begin += indexes->ele_index[first];
+		}
+	}
+
+	//Jump to the reffered element, skipping runs of one-byte items at once
+	if (is_pair()) {
+		for (size_t i=first ; i < idx ; ++i) {
+			if (CBOR_IS_ONE_BYTE_ITEM(*ele_begin) && (idx - i > 1)) {
+				size_t run = small_run_length(ele_begin, 2*(idx - i))/2;
+				if (run > 0) {
+					ele_begin += 2*run;
+					i += run - 1;
+					continue;
+				}
+			}
+			ele_begin += element_size(ele_begin);
+			ele_begin += element_size(ele_begin);
+		}
+	}
+	else { //is_array()
+		for (size_t i=first ; i < idx ; ++i) {
+			if (CBOR_IS_ONE_BYTE_ITEM(*ele_begin) && (idx - i > 1)) {
+				size_t run = small_run_length(ele_begin, idx - i);
+				ele_begin += run;
+				i += run - 1;
+				continue;
+			}
+			ele_begin += element_size(ele_begin);
+		}
+	}
+
+	return ele_begin;
+}
+
+bool CBOR::build_index()
+{
+	if (!is_pair() && !is_array()) {
+		return false;
+	}
+
+	size_t num_ele = n_elements();
+	size_t first = 0;
+	bool pair = is_pair();
+	CBORIndexes *idx = get_indexes();
+
+	if (idx == NULL) {
+		return false;
+	}
+	if (num_ele <= idx->ele_index_len) {
+		return true;
+	}
+
+	YACL_STAT(reallocations, 1);
+	size_t *new_index = (size_t*)allocator->reallocate(idx->ele_index,
+			sizeof(size_t)*idx->ele_index_len, sizeof(size_t)*num_ele);
+	if (new_index == NULL) {
+		return false;
+	}
+	YACL_STAT(bytes_allocated, sizeof(size_t)*(num_ele - idx->ele_index_len));
+	idx->ele_index = new_index;
+
+	//Elements are only appended: resume from the last indexed element
+	if (idx->ele_index_len > 0) {
+		first = idx->ele_index_len - 1;
 	}
 	else {
-		return 0;
+		new_index[0] = 0;
+	}
+
+	uint8_t *begin = data_begin();
+	uint8_t *ele_begin = begin + new_index[first];
+	for (size_t i=first+1 ; i < num_ele ; ++i) {
+		ele_begin += element_size(ele_begin);
+		if (pair) {
+			ele_begin += element_size(ele_begin);
+		}
+
+		new_index[i] = ele_begin - begin;
+	}
+	idx->ele_index_len = num_ele;
+
+	return true;
+}
+
+void CBOR::use_index(bool enable)
+{
+	if (enable) {
+		CBORIndexes *idx = get_indexes();
+		if (idx != NULL) {
+			idx->auto_index = true;
+		}
+	}
+	else if (indexes != NULL) {
+		indexes->auto_index = false;
+		drop_index();
+	}
+}
+
+void CBOR::drop_index()
+{
+	if (indexes == NULL) {
+		return;
+	}
+
+	if (indexes->ele_index != NULL) {
+		YACL_STAT(deallocations, 1);
+		allocator->deallocate(indexes->ele_index, sizeof(size_t)*indexes->ele_index_len);
+		indexes->ele_index = NULL;
+	}
+	indexes->ele_index_len = 0;
+}
+
+CBORIndexes* CBOR::get_indexes()
+{
+	if (indexes == NULL) {
+		YACL_STAT(allocations, 1);
+		YACL_STAT(bytes_allocated, sizeof(CBORIndexes));
+		indexes = (CBORIndexes*)allocator->allocate(sizeof(CBORIndexes));
+		if (indexes != NULL) {
+			*indexes = CBORIndexes();
+		}
+	}
+
+	return indexes;
+}
+
+void CBOR::free_indexes()
+{
+	if (indexes != NULL) {
+		YACL_STAT(deallocations, 1);
+		allocator->deallocate(indexes, sizeof(CBORIndexes));
+		indexes = NULL;
+	}
+}
+
+uint32_t CBOR::hash_key(const uint8_t *head, size_t head_len,
+		const uint8_t *tail, size_t tail_len)
+{
+	uint32_t hash = 2166136261UL;
+
+	for (size_t i=0 ; i < head_len ; ++i) {
+		hash = (hash ^ head[i]) * 16777619UL;
+	}
+	for (size_t i=0 ; i < tail_len ; ++i) {
+		hash = (hash ^ tail[i]) * 16777619UL;
+	}
+
+	return hash;
+}
+
+bool CBOR::key_equals(const uint8_t *key, size_t key_len,
+		const uint8_t *head, size_t head_len, const uint8_t *tail, size_t tail_len)
+{
+	if (key_len != head_len + tail_len) {
+		return false;
+	}
+
+	if (memcmp(key, head, head_len) != 0) {
+		return false;
+	}
+
+	return (tail_len == 0) || (memcmp(key + head_len, tail, tail_len) == 0);
+}
+
+int CBOR::key_compare(const uint8_t *key, size_t key_len,
+		const uint8_t *head, size_t head_len, const uint8_t *tail, size_t tail_len)
+{
+	size_t len = (key_len < head_len)?key_len:head_len;
+	int ret_val = memcmp(key, head, len);
+
+	if ((ret_val != 0) || (key_len <= head_len)) {
+		if (ret_val != 0) {
+			return ret_val;
+		}
+		return (key_len < head_len + tail_len)?-1:0;
+	}
+
+	key += head_len;
+	key_len -= head_len;
+	len = (key_len < tail_len)?key_len:tail_len;
+	ret_val = (len > 0)?memcmp(key, tail, len):0;
+
+	if (ret_val != 0) {
+		return ret_val;
+	}
+
+	return (key_len < tail_len)?-1:((key_len > tail_len)?1:0);
+}
+
+uint8_t* CBOR::find_encoded_value(const uint8_t *head, size_t head_len,
+		const uint8_t *tail, size_t tail_len)
+{
+	if (!is_pair()) {
+		return NULL;
+	}
+
+	size_t n_elements = this->n_elements();
+	uint8_t *begin = data_begin();
+	uint8_t *ele_begin = begin;
+	size_t key_size;
+
+	//Hashed lookup
+	if ((indexes != NULL) && (indexes->key_index != NULL) && (indexes->key_index_count == n_elements)) {
+		const size_t *key_index = indexes->key_index;
+		size_t mask = indexes->key_index_slots - 1;
+		size_t slot = hash_key(head, head_len, tail, tail_len) & mask;
+
+		while (key_index[slot] != 0) {
+			ele_begin = begin + key_index[slot] - 1;
+			key_size = element_size(ele_begin);
+
+			if (key_equals(ele_begin, key_size, head, head_len, tail, tail_len)) {
+				ele_begin += key_size;
+
+				return ele_begin;
+			}
+
+			slot = (slot + 1) & mask;
+		}
+
+		//Not found
+		return NULL;
+	}
+
+	//Binary search over the element index of a sorted Pair
+	if ((n_elements > 0) && (indexes != NULL) && (indexes->sorted_count == n_elements) && build_index()) {
+		size_t low = 0;
+		size_t high = n_elements;
+
+		while (low < high) {
+			size_t mid = low + (high - low)/2;
+			ele_begin = begin + indexes->ele_index[mid];
+			key_size = element_size(ele_begin);
+
+			int cmp = key_compare(ele_begin, key_size, head, head_len, tail, tail_len);
+			if (cmp == 0) {
+				ele_begin += key_size;
+
+				return ele_begin;
+			}
+
+			if (cmp < 0) {
+				low = mid + 1;
+			}
+			else {
+				high = mid;
+			}
+		}
+
+		//Not found
+		return NULL;
 	}
+
+	//Search key until the end of the Pair (map) is found
+	for (size_t i=0 ; i < n_elements ; ++i) {
+		key_size = element_size(ele_begin);
+
+		//If key match
+		if (key_equals(ele_begin, key_size, head, head_len, tail, tail_len)) {
+			ele_begin += key_size;
+
+			return ele_begin;
+		}
+
+		//Key don't match, jump to next key
+		ele_begin += key_size;
+		ele_begin += element_size(ele_begin);
+	}
+
+	//Not found
+	return NULL;
+}
+
+CBOR CBOR::find_by_encoded_key(const uint8_t *head, size_t head_len,
+		const uint8_t *tail, size_t tail_len)
+{
+	uint8_t *value = find_encoded_value(head, head_len, tail, tail_len);
+
+	if (value == NULL) {
+		return CBOR();
+	}
+
+	return CBOR(value, element_size(value), true);
+}
+
+CBOR CBOR::find_by_key(const char* key)
+{
+	YACL_PROFILE_SCOPE(CBOR_PROFILE_FIND_BY_KEY);
+
+	if (!is_pair()) {
+		return CBOR();
+	}
+
+	size_t len_string = strlen(key);
+
+	//Encode the string header only
+	uint8_t header_buf[STATIC_ALLOC_SIZE];
+	CBOR header = CBOR(header_buf, STATIC_ALLOC_SIZE, false);
+	header.encode_type_num(CBOR_TEXT, len_string);
+
+	return find_by_encoded_key(header_buf, header.length(),
+			(const uint8_t*)key, len_string);
+}
+
+void CBOR::set_view(uint8_t *buffer, size_t buffer_len)
+{
+	release_buffer();
+
+	max_buf_len = buffer_len;
+	buffer_begin = buffer;
+	w_ptr = buffer + buffer_len;
+	buffer_type = BUFFER_EXTERNAL;
+}
+
+size_t CBOR::find_by_keys(const CBOR *keys, size_t n_keys, CBOR *values)
+{
+	size_t n_found = 0;
+
+	if (n_keys > 32) {
+		//One scan per batch of 32 keys
+		for (size_t j=0 ; j < n_keys ; j += 32) {
+			n_found += find_by_keys(keys + j, ((n_keys - j) < 32)?(n_keys - j):32, values + j);
+		}
+
+		return n_found;
+	}
+
+	uint32_t pending = (uint32_t)(((uint64_t)1 << n_keys) - 1);
+	size_t num_ele = n_elements();
+
+	if (!is_pair()) {
+		num_ele = 0;
+	}
+	//Constant time or logarithmic lookups
+	else if (((indexes != NULL) && (indexes->key_index != NULL) && (indexes->key_index_count == num_ele))
+			|| ((num_ele > 0) && (indexes != NULL) && (indexes->sorted_count == num_ele))) {
+		for (size_t j=0 ; j < n_keys ; ++j) {
+			uint8_t *value = find_encoded_value(keys[j].to_CBOR(), keys[j].length(), NULL, 0);
+
+			if (value != NULL) {
+				values[j].set_view(value, element_size(value));
+				++n_found;
+			}
+			else {
+				values[j].release_buffer();
+				values[j].add();
+			}
+		}
+
+		return n_found;
+	}
+
+	//Single scan, until every key is found. Keys are first compared on
+	//their length and last byte.
+	uint16_t signatures[32];
+	for (size_t j=0 ; j < n_keys ; ++j) {
+		signatures[j] = (uint16_t)((keys[j].length() << 8) | keys[j].to_CBOR()[keys[j].length()-1]);
+	}
+
+	uint8_t *ele_begin = data_begin();
+	for (size_t i=0 ; (i < num_ele) && (pending != 0) ; ++i) {
+		size_t key_size = element_size(ele_begin);
+		uint8_t *value = ele_begin + key_size;
+		size_t value_size = element_size(value);
+		uint16_t signature = (uint16_t)((key_size << 8) | value[-1]);
+
+		for (size_t j=0 ; j < n_keys ; ++j) {
+			if ((signatures[j] == signature) && (pending & ((uint32_t)1 << j))
+					&& (keys[j].length() == key_size)
+					&& (memcmp(keys[j].to_CBOR(), ele_begin, key_size) == 0)) {
+				values[j].set_view(value, value_size);
+				pending &= ~((uint32_t)1 << j);
+				++n_found;
+			}
+		}
+
+		ele_begin = value + value_size;
+	}
+
+	//Keys not found
+	for (size_t j=0 ; (j < n_keys) && (pending != 0) ; ++j) {
+		if (pending & ((uint32_t)1 << j)) {
+			values[j].release_buffer();
+			values[j].add();
+		}
+	}
+
+	return n_found;
+}
+
+uint16_t CBOR::field_hash(const char *name, size_t len)
+{
+	uint16_t hash = (uint16_t)len;
+
+	for (size_t i=0 ; i < len ; ++i) {
+		hash = (uint16_t)(hash*31 + (uint8_t)name[i]);
+	}
+
+	return hash;
+}
+
+void CBOR::hash_fields(const char* const *field_names, size_t num_fields, uint16_t *hashes)
+{
+	for (size_t i=0 ; i < num_fields ; ++i) {
+		hashes[i] = field_hash(field_names[i], strlen(field_names[i]));
+	}
+}
+
+size_t CBOR::find_field(const uint8_t *key, const char* const *field_names,
+		const uint16_t *hashes, size_t num_fields, size_t hint)
+{
+	if (!is_string(key) || ((key[0] & CBOR_INFO_BITS) == CBOR_VAR_FOLLOWS)) {
+		return num_fields;
+	}
+
+	size_t len_string = decode_abs_num(key);
+	const char *str = (const char*)key + compute_type_num_len(len_string);
+	uint16_t hash = field_hash(str, len_string);
+	size_t idx = (hint < num_fields)?hint:0;
+
+	for (size_t n=0 ; n < num_fields ; ++n) {
+		if (hashes[idx] == hash) {
+			const char *name = field_names[idx];
+			size_t i = 0;
+
+			while ((i < len_string) && (name[i] != '\0') && (name[i] == str[i])) {
+				++i;
+			}
+			if ((i == len_string) && (name[i] == '\0')) {
+				return idx;
+			}
+		}
+
+		if (++idx == num_fields) {
+			idx = 0;
+		}
+	}
+
+	return num_fields;
+}
+
+size_t CBOR::key_index_len(size_t num_keys)
+{
+	size_t slots = 2;
+
+	//Keep load factor under 1/2
+	while (slots < 2*num_keys) {
+		slots <<= 1;
+	}
+
+	return slots;
+}
+
+bool CBOR::build_key_index(size_t *table, size_t table_len)
+{
+	if (!is_pair()) {
+		return false;
+	}
+
+	size_t num_ele = n_elements();
+	size_t slots = key_index_len(num_ele);
+	bool owned = (table == NULL);
+
+	if (!owned) {
+		//Use the largest power of two that fits in the caller-supplied table
+		for (slots = 1 ; (slots << 1) <= table_len ; slots <<= 1) ;
+
+		if (slots <= num_ele) {
+			return false;
+		}
+	}
+
+	CBORIndexes *idx = get_indexes();
+	if (idx == NULL) {
+		return false;
+	}
+	size_t sorted_saved = idx->sorted_count;
+	drop_key_index();
+	idx->sorted_count = sorted_saved;
+
+	if (owned) {
+		YACL_STAT(allocations, 1);
+		YACL_STAT(bytes_allocated, sizeof(size_t)*slots);
+		table = (size_t*)allocator->allocate(sizeof(size_t)*slots);
+		if (table == NULL) {
+			return false;
+		}
+	}
+	memset(table, 0, sizeof(size_t)*slots);
+
+	size_t mask = slots - 1;
+	uint8_t *begin = data_begin();
+	uint8_t *ele_begin = begin;
+
+	for (size_t i=0 ; i < num_ele ; ++i) {
+		size_t key_size = element_size(ele_begin);
+		size_t slot = hash_key(ele_begin, key_size, NULL, 0) & mask;
+
+		while (table[slot] != 0) {
+			const uint8_t *other = begin + table[slot] - 1;
+
+			//Duplicate key: find_by_key() returns the first one
+			if (buffer_equals(other, element_size((uint8_t*)other), ele_begin, key_size)) {
+				break;
+			}
+
+			slot = (slot + 1) & mask;
+		}
+
+		if (table[slot] == 0) {
+			table[slot] = (ele_begin - begin) + 1;
+		}
+
+		ele_begin += key_size;
+		ele_begin += element_size(ele_begin);
+	}
+
+	idx->key_index = table;
+	idx->key_index_slots = slots;
+	idx->key_index_count = num_ele;
+	idx->key_index_owned = owned;
+
+	return true;
+}
+
+void CBOR::drop_key_index()
+{
+	if (indexes == NULL) {
+		return;
+	}
+
+	if (indexes->key_index_owned && (indexes->key_index != NULL)) {
+		YACL_STAT(deallocations, 1);
+		allocator->deallocate(indexes->key_index, sizeof(size_t)*indexes->key_index_slots);
+	}
+
+	indexes->key_index = NULL;
+	indexes->key_index_slots = 0;
+	indexes->key_index_count = 0;
+	indexes->key_index_owned = false;
+	indexes->sorted_count = 0;
+}
+
+//! A pair of a CBOR PAIR being sorted.
+struct cbor_sorted_pair
+{
+	uint8_t *key;
+	size_t key_len;
+	size_t pair_len;
+};
+
+static int compare_pairs(const void *a, const void *b)
+{
+	const cbor_sorted_pair *pair_a = (const cbor_sorted_pair*)a;
+	const cbor_sorted_pair *pair_b = (const cbor_sorted_pair*)b;
+	size_t len = (pair_a->key_len < pair_b->key_len)?pair_a->key_len:pair_b->key_len;
+	int ret_val = memcmp(pair_a->key, pair_b->key, len);
+
+	if (ret_val != 0) {
+		return ret_val;
+	}
+
+	return (pair_a->key_len < pair_b->key_len)?-1:((pair_a->key_len > pair_b->key_len)?1:0);
+}
+
+bool CBOR::is_shortest_head(const uint8_t *ptr)
+{
+	uint8_t type = ptr[0] & CBOR_TYPE_MASK;
+	uint8_t info = ptr[0] & CBOR_INFO_BITS;
+
+	if (type == CBOR_7) {
+		uint16_t half;
+		float single;
+
+		switch (info) {
+			case CBOR_UINT8_FOLLOWS: //Simple values
+				return (ptr[1] >= 32);
+			case CBOR_UINT32_FOLLOWS:
+				return !float_to_half((float)CBOR((uint8_t*)ptr, 5, true), half);
+			case CBOR_UINT64_FOLLOWS:
+				return (sizeof(double) == 4)
+					|| !double_to_float((double)CBOR((uint8_t*)ptr, 9, true), single);
+			default:
+				return true;
+		}
+	}
+
+	switch (info) {
+		case CBOR_UINT8_FOLLOWS:
+			return (ptr[1] >= 24);
+		case CBOR_UINT16_FOLLOWS:
+			return (decode_abs_num16(ptr) > 0xFF);
+		case CBOR_UINT32_FOLLOWS:
+			return (decode_abs_num32(ptr) > 0xFFFF);
+		case CBOR_UINT64_FOLLOWS:
+			return (decode_abs_num64(ptr) > 0xFFFFFFFF);
+		default:
+			return true;
+	}
+}
+
+bool CBOR::canonicalize_item(uint8_t *ptr, CBORAllocator *_allocator, uint8_t depth)
+{
+	uint8_t type = ptr[0] & CBOR_TYPE_MASK;
+
+	if ((depth > CBOR_VALIDATE_MAX_DEPTH) || !is_shortest_head(ptr)) {
+		return false;
+	}
+
+	//Indefinite-length items
+	if (((ptr[0] & CBOR_INFO_BITS) == CBOR_VAR_FOLLOWS) && (type != CBOR_7)) {
+		return false;
+	}
+
+	if (type == CBOR_TAG) {
+		return canonicalize_item(ptr + compute_type_num_len(decode_abs_num(ptr)), _allocator, depth+1);
+	}
+
+	if ((type != CBOR_ARRAY) && (type != CBOR_MAP)) {
+		return true;
+	}
+
+	size_t num_ele = decode_abs_num(ptr);
+	uint8_t *begin = ptr + compute_type_num_len(num_ele);
+	uint8_t *ele_begin = begin;
+
+	if (type == CBOR_ARRAY) {
+		for (size_t i=0 ; i < num_ele ; ++i) {
+			if (!canonicalize_item(ele_begin, _allocator, depth+1)) {
+				return false;
+			}
+			ele_begin += element_size(ele_begin);
+		}
+
+		return true;
+	}
+
+	//Sort children first: their encoding is part of the keys
+	bool sorted = true;
+	uint8_t *prev_key = NULL;
+	size_t prev_key_len = 0;
+
+	for (size_t i=0 ; i < num_ele ; ++i) {
+		if (!canonicalize_item(ele_begin, _allocator, depth+1)) {
+			return false;
+		}
+		size_t key_len = element_size(ele_begin);
+
+		if (prev_key != NULL) {
+			int cmp = key_compare(prev_key, prev_key_len, ele_begin, key_len, NULL, 0);
+			if (cmp == 0) {
+				return false;
+			}
+			sorted &= (cmp < 0);
+		}
+		prev_key = ele_begin;
+		prev_key_len = key_len;
+
+		ele_begin += key_len;
+		if (!canonicalize_item(ele_begin, _allocator, depth+1)) {
+			return false;
+		}
+		ele_begin += element_size(ele_begin);
+	}
+
+	if (sorted) {
+		return true;
+	}
+
+	size_t data_len = ele_begin - begin;
+	YACL_STAT(allocations, 2);
+	YACL_STAT(bytes_allocated, sizeof(cbor_sorted_pair)*num_ele + data_len);
+	cbor_sorted_pair *pairs = (cbor_sorted_pair*)_allocator->allocate(sizeof(cbor_sorted_pair)*num_ele);
+	uint8_t *sorted_data = (uint8_t*)_allocator->allocate(data_len);
+	bool ret_val = (pairs != NULL) && (sorted_data != NULL);
+
+	if (ret_val) {
+		ele_begin = begin;
+		for (size_t i=0 ; i < num_ele ; ++i) {
+			pairs[i].key = ele_begin;
+			pairs[i].key_len = element_size(ele_begin);
+			ele_begin += pairs[i].key_len;
+			ele_begin += element_size(ele_begin);
+			pairs[i].pair_len = ele_begin - pairs[i].key;
+		}
+
+		qsort(pairs, num_ele, sizeof(cbor_sorted_pair), compare_pairs);
+
+		uint8_t *out = sorted_data;
+		for (size_t i=0 ; i < num_ele ; ++i) {
+			//Duplicate keys
+			if ((i > 0) && (compare_pairs(&pairs[i-1], &pairs[i]) == 0)) {
+				ret_val = false;
+				break;
+			}
+			memcpy(out, pairs[i].key, pairs[i].pair_len);
+			YACL_STAT(bytes_copied, pairs[i].pair_len);
+			out += pairs[i].pair_len;
+		}
+
+		if (ret_val) {
+			memcpy(begin, sorted_data, data_len);
+			YACL_STAT(bytes_copied, data_len);
+		}
+	}
+
+	if (sorted_data != NULL) {
+		YACL_STAT(deallocations, 1);
+		_allocator->deallocate(sorted_data, data_len);
+	}
+	if (pairs != NULL) {
+		YACL_STAT(deallocations, 1);
+		_allocator->deallocate(pairs, sizeof(cbor_sorted_pair)*num_ele);
+	}
+
+	return ret_val;
+}
+
+bool CBOR::canonicalize()
+{
+	if ((length() == 0) || !canonicalize_item(get_buffer_begin(), allocator, 0)) {
+		return false;
+	}
+
+	//Offsets of pairs changed
+	drop_index();
+	drop_key_index();
+	if (is_pair() && (get_indexes() != NULL)) {
+		//Only a hint for lookups: not an error if it cannot be allocated
+		indexes->sorted_count = n_elements();
+	}
+
+	return true;
+}
+
+//Powers of ten exactly representable as a double
+static const double json_pow10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+	1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+static const char* json_skip_ws(const char *ptr, const char *end)
+{
+	while ((ptr < end) && ((*ptr == ' ') || (*ptr == '\n') || (*ptr == '\r') || (*ptr == '\t'))) {
+		++ptr;
+	}
+
+	return ptr;
+}
+
+//Decode the 4 hexadecimal digits of a \u escape sequence, or return -1
+static long json_hex4(const char *ptr)
+{
+	long value = 0;
+
+	for (uint8_t i=0 ; i < 4 ; ++i) {
+		char c = ptr[i];
+		char lower = c | 0x20;
+
+		value <<= 4;
+		if ((c >= '0') && (c <= '9')) {
+			value |= c - '0';
+		}
+		else if ((lower >= 'a') && (lower <= 'f')) {
+			value |= lower - 'a' + 10;
+		}
+		else {
+			return -1;
+		}
+	}
+
+	return value;
+}
+
+const char* CBOR::add_json_string(const char *ptr, const char *end)
+{
+	const char *str_end = ptr;
+
+	//Fast path: no escape sequence, the string is copied as is
+	while ((str_end < end) && (*str_end != '"') && (*str_end != '\\') && ((uint8_t)*str_end >= 0x20)) {
+		++str_end;
+	}
+	if (str_end == end) {
+		return NULL;
+	}
+	if (*str_end == '"') {
+		size_t len = (size_t)(str_end - ptr);
+
+		if (!encode_type_num(CBOR_TEXT, len) || !reserve(length() + len)) {
+			return NULL;
+		}
+		memcpy(w_ptr, ptr, len);
+		w_ptr += len;
+
+		return str_end + 1;
+	}
+
+	//Find the closing quote. The decoded string is not longer than the
+	//escaped one: decode it after the longest possible header, then move it
+	//if its header is shorter.
+	while ((str_end < end) && (*str_end != '"')) {
+		if (*str_end == '\\') {
+			++str_end;
+		}
+		++str_end;
+	}
+	if (str_end >= end) {
+		return NULL;
+	}
+
+	size_t max_len = (size_t)(str_end - ptr);
+	uint8_t max_head_len = compute_type_num_len(max_len);
+	if (!reserve(length() + max_head_len + max_len)) {
+		return NULL;
+	}
+
+	uint8_t *dest = w_ptr + max_head_len;
+	uint8_t *out = dest;
+	while (ptr < str_end) {
+		uint8_t c = (uint8_t)*(ptr++);
+
+		if (c < 0x20) {
+			return NULL;
+		}
+		if (c != '\\') {
+			*(out++) = c;
+			continue;
+		}
+
+		//A backslash is never the last character before the closing quote
+		c = (uint8_t)*(ptr++);
+		switch (c) {
+			case '"':
+			case '\\':
+			case '/':
+				*(out++) = c;
+				break;
+			case 'b':
+				*(out++) = '\b';
+				break;
+			case 'f':
+				*(out++) = '\f';
+				break;
+			case 'n':
+				*(out++) = '\n';
+				break;
+			case 'r':
+				*(out++) = '\r';
+				break;
+			case 't':
+				*(out++) = '\t';
+				break;
+			case 'u': {
+				long code = (str_end - ptr >= 4)?json_hex4(ptr):-1;
+				if (code < 0) {
+					return NULL;
+				}
+				ptr += 4;
+
+				if ((code >= 0xD800) && (code <= 0xDBFF)) {
+					//High surrogate: must be followed by a low surrogate
+					long low = ((str_end - ptr >= 6) && (ptr[0] == '\\') && (ptr[1] == 'u'))?json_hex4(ptr + 2):-1;
+					if ((low < 0xDC00) || (low > 0xDFFF)) {
+						return NULL;
+					}
+					ptr += 6;
+					code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+				}
+				else if ((code >= 0xDC00) && (code <= 0xDFFF)) {
+					return NULL;
+				}
+
+				//UTF-8 encoding
+				if (code < 0x80) {
+					*(out++) = (uint8_t)code;
+				}
+				else if (code < 0x800) {
+					*(out++) = 0xC0 | (uint8_t)(code >> 6);
+					*(out++) = 0x80 | (uint8_t)(code & 0x3F);
+				}
+				else if (code < 0x10000) {
+					*(out++) = 0xE0 | (uint8_t)(code >> 12);
+					*(out++) = 0x80 | (uint8_t)((code >> 6) & 0x3F);
+					*(out++) = 0x80 | (uint8_t)(code & 0x3F);
+				}
+				else {
+					*(out++) = 0xF0 | (uint8_t)(code >> 18);
+					*(out++) = 0x80 | (uint8_t)((code >> 12) & 0x3F);
+					*(out++) = 0x80 | (uint8_t)((code >> 6) & 0x3F);
+					*(out++) = 0x80 | (uint8_t)(code & 0x3F);
+				}
+				break;
+			}
+			default:
+				return NULL;
+		}
+	}
+
+	size_t len = (size_t)(out - dest);
+	encode_type_num(CBOR_TEXT, len);
+	if (w_ptr != dest) {
+		memmove(w_ptr, dest, len);
+	}
+	w_ptr += len;
+
+	return str_end + 1;
+}
+
+const char* CBOR::add_json_number(const char *ptr, const char *end)
+{
+	const char *begin = ptr;
+	bool negative = false;
+	bool is_int = true;
+	//Set if some digits did not fit in mant
+	bool truncated = false;
+	uint64_t mant = 0;
+	long exp10 = 0;
+
+	if ((ptr < end) && (*ptr == '-')) {
+		negative = true;
+		++ptr;
+	}
+	if ((ptr == end) || (*ptr < '0') || (*ptr > '9')) {
+		return NULL;
+	}
+
+	//Integer part (no leading zero)
+	if (*ptr == '0') {
+		++ptr;
+	}
+	else {
+		while ((ptr < end) && (*ptr >= '0') && (*ptr <= '9')) {
+			uint8_t digit = *(ptr++) - '0';
+			if (mant <= ((uint64_t)-1 - digit)/10) {
+				mant = mant*10 + digit;
+			}
+			else {
+				++exp10;
+				truncated = true;
+			}
+		}
+	}
+
+	//Fraction
+	if ((ptr < end) && (*ptr == '.')) {
+		is_int = false;
+		++ptr;
+		if ((ptr == end) || (*ptr < '0') || (*ptr > '9')) {
+			return NULL;
+		}
+		while ((ptr < end) && (*ptr >= '0') && (*ptr <= '9')) {
+			uint8_t digit = *(ptr++) - '0';
+			if (mant <= ((uint64_t)-1 - digit)/10) {
+				mant = mant*10 + digit;
+				--exp10;
+			}
+			else {
+				truncated = true;
+			}
+		}
+	}
+
+	//Exponent
+	if ((ptr < end) && ((*ptr == 'e') || (*ptr == 'E'))) {
+		bool exp_negative = false;
+		long exp = 0;
+
+		is_int = false;
+		++ptr;
+		if ((ptr < end) && ((*ptr == '+') || (*ptr == '-'))) {
+			exp_negative = (*ptr == '-');
+			++ptr;
+		}
+		if ((ptr == end) || (*ptr < '0') || (*ptr > '9')) {
+			return NULL;
+		}
+		while ((ptr < end) && (*ptr >= '0') && (*ptr <= '9')) {
+			//Saturate: any larger exponent overflows anyway
+			if (exp < 100000) {
+				exp = exp*10 + (*ptr - '0');
+			}
+			++ptr;
+		}
+		exp10 += exp_negative?-exp:exp;
+	}
+
+	if (is_int && (ptr - begin == 21) && (memcmp(begin, "-18446744073709551616", 21) == 0)) {
+		//-2^64 does not fit in mant, but is the smallest CBOR NEGINT
+		return encode_type_num(CBOR_NEGINT, (uint64_t)-1)?ptr:NULL;
+	}
+	if (is_int && !truncated) {
+		bool ret_val;
+		if (negative && (mant > 0)) {
+			ret_val = encode_type_num(CBOR_NEGINT, mant - 1);
+		}
+		else {
+			ret_val = encode_type_num(CBOR_UINT, mant);
+		}
+		return ret_val?ptr:NULL;
+	}
+
+	double value;
+	const uint64_t exact_mant = (sizeof(double) == 8)?(1ULL << 53):(1UL << 24);
+	const long exact_pow = (sizeof(double) == 8)?22:10;
+	if (!truncated && (mant <= exact_mant) && (exp10 >= -exact_pow) && (exp10 <= exact_pow)) {
+		//Both the mantissa and the power of ten are exact: a single
+		//rounding, as strtod() would do
+		value = (exp10 < 0)?((double)mant/json_pow10[-exp10]):((double)mant*json_pow10[exp10]);
+		if (negative) {
+			value = -value;
+		}
+	}
+	else {
+		//The JSON text may not be null-terminated
+		char number[64];
+		size_t len = (size_t)(ptr - begin);
+		if (len >= sizeof(number)) {
+			return NULL;
+		}
+		memcpy(number, begin, len);
+		number[len] = '\0';
+		value = strtod(number, NULL);
+	}
+
+	return add(value)?ptr:NULL;
+}
+
+bool CBOR::end_json_container(size_t head, size_t num_ele)
+{
+	uint8_t head_len = compute_type_num_len(num_ele);
+
+	if ((head_len > 1) && !reserve(length() + head_len - 1)) {
+		return false;
+	}
+
+	uint8_t *begin = get_buffer_begin() + head;
+	uint8_t *end = w_ptr + head_len - 1;
+	uint8_t cbor_type = *begin & CBOR_7;
+
+	if (head_len > 1) {
+		memmove(begin + head_len, begin + 1, (size_t)(w_ptr - begin - 1));
+		YACL_STAT(bytes_copied, (size_t)(w_ptr - begin - 1));
+	}
+
+	//Patch the header
+	w_ptr = begin;
+	encode_type_num(cbor_type, num_ele);
+	w_ptr = end;
+
+	return true;
+}
+
+bool CBOR::encode_json(const char *json, size_t json_len)
+{
+	const char *ptr = json;
+	const char *end = json + json_len;
+	//Offset of the header, and number of elements, of each open array or map
+	size_t head[CBOR_JSON_MAX_DEPTH];
+	size_t num_ele[CBOR_JSON_MAX_DEPTH];
+	uint8_t depth = 0;
+	bool key_expected = false;
+	bool ret_val = false;
+
+	drop_index();
+	drop_key_index();
+	w_ptr = get_buffer_begin();
+
+	//The CBOR encoding is usually shorter than the JSON text: allocate once.
+	//EXTERNAL buffers may be smaller, which is checked on every write.
+	reserve(json_len);
+
+	while (ptr != NULL) {
+		ptr = json_skip_ws(ptr, end);
+		if (ptr == end) {
+			break;
+		}
+
+		if (key_expected) {
+			if (*ptr != '"') {
+				break;
+			}
+			ptr = add_json_string(ptr + 1, end);
+			if (ptr == NULL) {
+				break;
+			}
+			ptr = json_skip_ws(ptr, end);
+			if ((ptr == end) || (*ptr != ':')) {
+				break;
+			}
+			++ptr;
+			key_expected = false;
+			continue;
+		}
+
+		char c = *ptr;
+		if ((c == '[') || (c == '{')) {
+			if ((depth == CBOR_JSON_MAX_DEPTH) || !reserve(length() + 1)) {
+				break;
+			}
+
+			//1-byte header, patched by end_json_container()
+			head[depth] = length();
+			num_ele[depth] = 0;
+			++depth;
+			*(w_ptr++) = (c == '[')?CBOR_ARRAY:CBOR_MAP;
+
+			ptr = json_skip_ws(ptr + 1, end);
+			if ((ptr < end) && (*ptr == c + 2)) {
+				//Empty: the header is already right
+				++ptr;
+				--depth;
+			}
+			else {
+				key_expected = (c == '{');
+				continue;
+			}
+		}
+		else if (c == '"') {
+			ptr = add_json_string(ptr + 1, end);
+		}
+		else if ((end - ptr >= 4) && (memcmp(ptr, "true", 4) == 0)) {
+			ptr = add(true)?(ptr + 4):NULL;
+		}
+		else if ((end - ptr >= 5) && (memcmp(ptr, "false", 5) == 0)) {
+			ptr = add(false)?(ptr + 5):NULL;
+		}
+		else if ((end - ptr >= 4) && (memcmp(ptr, "null", 4) == 0)) {
+			ptr = add()?(ptr + 4):NULL;
+		}
+		else {
+			ptr = add_json_number(ptr, end);
+		}
+
+		//A value was added: close the arrays and maps it ends
+		while ((ptr != NULL) && (depth > 0)) {
+			bool is_map = ((get_buffer_begin()[head[depth - 1]] & CBOR_7) == CBOR_MAP);
+
+			++num_ele[depth - 1];
+			ptr = json_skip_ws(ptr, end);
+			if (ptr == end) {
+				ptr = NULL;
+			}
+			else if (*ptr == ',') {
+				++ptr;
+				key_expected = is_map;
+				break;
+			}
+			else if (*ptr == (is_map?'}':']')) {
+				++ptr;
+				--depth;
+				if (!end_json_container(head[depth], num_ele[depth])) {
+					ptr = NULL;
+				}
+			}
+			else {
+				ptr = NULL;
+			}
+		}
+
+		if ((ptr != NULL) && (depth == 0)) {
+			ret_val = (json_skip_ws(ptr, end) == end);
+			break;
+		}
+	}
+
+	if (!ret_val) {
+		w_ptr = get_buffer_begin();
+		add();
+	}
+
+	return ret_val;
 }
@@ -1,11 +1,15 @@
 #ifndef INCLUDED_CBOR_H
 #define INCLUDED_CBOR_H
+#include <float.h>
 #include <math.h>
 #include <stdint.h>
 #include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 #include <WString.h>
+#include "CBORAllocator.h"
+#include "CBORStats.h"
+#include "CBORProfile.h"
 
 #define CBOR_TYPE_MASK 0xE0
 #define CBOR_INFO_BITS 0x1F
@@ -43,6 +47,112 @@
 #define BUFFER_DYNAMIC_INTERNAL 1
 #define BUFFER_EXTERNAL 2
 
+//! Maximum nesting depth of arrays, maps and indefinite-length strings accepted by `CBOR::validate()`.
+#ifndef CBOR_VALIDATE_MAX_DEPTH
+#define CBOR_VALIDATE_MAX_DEPTH 16
+#endif
+
+//! Maximum nesting depth of arrays, maps and indefinite-length strings skipped by `element_size()`.
+/*!
+ * Items nested deeper are reported as malformed (size 0).
+ */
+#ifndef CBOR_SKIP_MAX_DEPTH
+#define CBOR_SKIP_MAX_DEPTH 32
+#endif
+
+//! Define to skip runs of one-byte items without vector instructions (SSE2, AVX2, NEON), even if the target has them.
+//#define CBOR_NO_SIMD
+
+//! Maximum nesting depth of arrays and maps converted by `CBOR::encode_json()` and CBORJSONWriter.
+#ifndef CBOR_JSON_MAX_DEPTH
+#define CBOR_JSON_MAX_DEPTH 16
+#endif
+
+//! Growth factor of dynamically allocated buffers (`BUFFER_GROWTH_NUM / BUFFER_GROWTH_DEN`).
+/*!
+ * When a DYNAMIC_INTERNAL buffer is full, its length is multiplied by this
+ * factor (or set to the requested length, if larger), so that appending
+ * n elements only costs O(log(n)) reallocations.
+ */
+#ifndef BUFFER_GROWTH_NUM
+#define BUFFER_GROWTH_NUM 3
+#endif
+#ifndef BUFFER_GROWTH_DEN
+#define BUFFER_GROWTH_DEN 2
+#endif
+
+//! Maximum number of bytes added to a buffer by a single growth step (0 means no limit).
+#ifndef BUFFER_GROWTH_MAX_STEP
+#if defined(__AVR__)
+#define BUFFER_GROWTH_MAX_STEP 64
+#else
+#define BUFFER_GROWTH_MAX_STEP 0
+#endif
+#endif
+
+//! Default float encoding mode (see `CBOR::set_shortest_float()`).
+#ifndef CBOR_SHORTEST_FLOAT
+#define CBOR_SHORTEST_FLOAT false
+#endif
+
+//! True on big-endian targets (typed arrays are encoded in native byte order by default).
+#ifndef CBOR_BIG_ENDIAN
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+#define CBOR_BIG_ENDIAN true
+#else
+#define CBOR_BIG_ENDIAN false
+#endif
+#endif
+
+//! Range of RFC 8746 typed array tags.
+#define CBOR_TYPED_ARRAY_FIRST 64
+#define CBOR_TYPED_ARRAY_LAST  87
+//! Typed array tag bits: float, signed, little-endian.
+#define CBOR_TYPED_ARRAY_FLOAT  0x10
+#define CBOR_TYPED_ARRAY_SIGNED 0x08
+#define CBOR_TYPED_ARRAY_LE     0x04
+
+//Field table of a struct (see CBORFields.h).
+template <typename S> struct CBORFields;
+
+//! Optional indexes of a CBOR object.
+/*!
+ * Allocated with the allocator of the object on first use, so that objects
+ * that are never indexed (such as the views returned by `at()` and
+ * `operator[]`) only pay for a NULL pointer.
+ */
+struct CBORIndexes
+{
+	//! Element offset index (see `CBOR::build_index()`).
+	/*!
+	 * Offset of each element (CBOR ARRAY) or of each key (CBOR PAIR),
+	 * relative to the begining of the data section (i.e. right after the
+	 * number of elements).
+	 */
+	size_t *ele_index;
+	//! Number of entries in `ele_index`.
+	size_t ele_index_len;
+	//! True if `ele_index` must be built on first indexed access.
+	bool auto_index;
+
+	//! Hashed key index (see `CBOR::build_key_index()`).
+	/*!
+	 * Open addressing hash table of the keys of a CBOR PAIR. Each slot
+	 * stores the offset of a key relative to the begining of the data
+	 * section plus one, or 0 if the slot is empty.
+	 */
+	size_t *key_index;
+	//! Number of slots in `key_index` (a power of two).
+	size_t key_index_slots;
+	//! Number of keys of the CBOR PAIR when `key_index` was built.
+	size_t key_index_count;
+	//! True if `key_index` was allocated by the CBOR object.
+	bool key_index_owned;
+
+	//! Number of keys of the CBOR PAIR when it was sorted (see `CBOR::canonicalize()`).
+	size_t sorted_count;
+};
+
 //! A class to handle CBOR Objects.
 /*!
  * This class handles encoding and decoding of basic CBOR data (int, float, strings).
@@ -51,6 +161,9 @@
  */
 class CBOR
 {
+	friend class CBORParser;
+	friend class CBORJSONWriter;
+
 	protected:
 		//! Pointer on the begining of the buffer storing CBOR data.
 		union {
@@ -71,6 +184,11 @@ class CBOR
 		 * - `BUFFER_EXTERNAL` if using an external buffer.
 		 */
 		uint8_t buffer_type = BUFFER_STATIC_INTERNAL;
+		//! Allocator of the DYNAMIC_INTERNAL buffer and of the indexes.
+		CBORAllocator *allocator = CBORAllocator::get_default();
+
+		//! Element and key indexes, allocated on first use (NULL if none).
+		CBORIndexes *indexes = NULL;
 
 		//! Returns pointer on the begining of the buffer.
 		/*!
@@ -95,6 +213,76 @@ class CBOR
 		 */
 		virtual bool init_buffer();
 
+		//! Free the DYNAMIC_INTERNAL buffer and the indexes.
+		/*!
+		 * This CBOR object is left with an empty STATIC_INTERNAL buffer.
+		 */
+		void release_buffer();
+
+		//! Check if some data is stored in the internal buffer of this object.
+		/*!
+		 * \param ptr Pointer to the data.
+		 * \return True if `ptr` points inside the CBOR data of this object,
+		 * and this object is not using an EXTERNAL buffer.
+		 */
+		bool owns_data(const uint8_t *ptr) const
+		{
+			return (buffer_type != BUFFER_EXTERNAL) &&
+				(ptr >= get_const_buffer_begin()) && (ptr < w_ptr);
+		}
+
+		//! Make this CBOR object a view on an element of another buffer.
+		/*!
+		 * The current buffer is released.
+		 *
+		 * \param buffer Pointer to the begining of the element.
+		 * \param buffer_len Size (in bytes) of the element.
+		 */
+		void set_view(uint8_t *buffer, size_t buffer_len);
+
+		//! Copy the CBOR data of another CBOR object.
+		/*!
+		 * The current buffer must have been released first.
+		 *
+		 * \param obj The CBOR object to copy.
+		 */
+		void copy_buffer(const CBOR &obj);
+
+		//! Take over the buffer and the indexes of another CBOR object.
+		/*!
+		 * The current buffer must have been released first. `obj` is left
+		 * with an empty STATIC_INTERNAL buffer.
+		 *
+		 * \param obj The CBOR object to take the buffer from.
+		 */
+		void move_buffer(CBOR &obj);
+
+		//! Get the indexes of this object, allocating them on first use.
+		/*!
+		 * \return The indexes, or NULL if allocation failed.
+		 */
+		CBORIndexes* get_indexes();
+
+		//! Free the indexes structure (the indexes it points to must have been freed first).
+		void free_indexes();
+
+		//! Check if the buffer of this object can be taken over by `move_buffer()`.
+		/*!
+		 * \return False if `buffer_begin` may not be the beginning of the
+		 * allocated buffer (composed objects), true otherwise.
+		 */
+		virtual bool has_movable_buffer() const { return true; }
+
+		//! Compute the new length of a full dynamic buffer.
+		/*!
+		 * \param current_len Current length of the buffer.
+		 * \param requested_len Requested length of the buffer.
+		 * \return The largest of `requested_len` and `current_len` grown by
+		 * `BUFFER_GROWTH_NUM / BUFFER_GROWTH_DEN` (limited to
+		 * `BUFFER_GROWTH_MAX_STEP` bytes).
+		 */
+		static size_t grow_len(size_t current_len, size_t requested_len);
+
 		//! Encode a numerical value associated with a CBOR type, and append it to the beginning of the buffer.
 		/*!
 		 * \param cbor_type CBOR type to associate with the numerical value.
@@ -113,10 +301,10 @@ class CBOR
 			else if (sizeof(T) == 2) {
 				return encode_type_num(cbor_type, (uint16_t)value);
 			}
-			else if (sizeof(T) == 3) {
+			else if (sizeof(T) == 4) {
 				return encode_type_num(cbor_type, (uint32_t)value);
 			}
-			else if (sizeof(T) == 4) {
+			else if (sizeof(T) == 8) {
 				return encode_type_num(cbor_type, (uint64_t)value);
 			}
 
@@ -169,11 +357,95 @@ class CBOR
 
 		//! Returns the size of the CBOR element pointed by ptr.
 		/*!
+		 * Initial bytes are classified with a 256-entry table, and nested
+		 * items are skipped iteratively, with a stack of at most
+		 * `CBOR_SKIP_MAX_DEPTH` open arrays, maps and indefinite-length
+		 * strings. No bounds are checked (see `validate()`).
+		 *
 		 * \param ptr Pointer to the begining of the element in buffer.
-		 * \return the size of the CBOR element pointed by ptr.
+		 * \return the size of the CBOR element pointed by ptr, or 0 if it is
+		 * malformed or nested too deeply.
 		 */
 		static size_t element_size(uint8_t *ptr);
 
+		//! Returns the length of an item header from its initial byte.
+		/*!
+		 * \param first_byte Initial byte of the item.
+		 * \return Length (in bytes) of the header, or 0 if it uses a reserved
+		 * additional information, or if it is an indefinite-length integer
+		 * or tag.
+		 */
+		static uint8_t header_length(uint8_t first_byte);
+
+		//! Decode an item header.
+		/*!
+		 * Used by `validate()`, `CBORParser` and `CBORJSONWriter`.
+		 *
+		 * \param ptr Pointer to the header.
+		 * \param end Pointer to the end of the input.
+		 * \param arg Set to the argument of the header (value, length, count,
+		 * tag, simple value or float bits), or to 0 for an indefinite-length
+		 * item or a break.
+		 * \return Pointer to the first byte after the header, or NULL if the
+		 * header is truncated or invalid (see `header_length()`).
+		 */
+		static const uint8_t* decode_header(const uint8_t *ptr, const uint8_t *end, uint64_t &arg);
+
+		//! Returns the number of one-byte items at the beginning of a buffer.
+		/*!
+		 * One-byte items are integers from -24 to 23 and simple values from
+		 * 0 to 23 (including `false`, `true` and `null`). Bytes are
+		 * classified 16 or 32 at a time with SSE2, AVX2 or NEON when the
+		 * target has them (unless `CBOR_NO_SIMD` is defined), one at a time
+		 * otherwise.
+		 *
+		 * \param ptr Pointer to the first item.
+		 * \param max_items Maximum number of items to count. At least
+		 * `max_items` items must follow `ptr`: no more than `max_items`
+		 * bytes are read.
+		 * \return The number of consecutive one-byte items starting at
+		 * `ptr`, at most `max_items`.
+		 */
+		static size_t small_run_length(const uint8_t *ptr, size_t max_items);
+
+		//! Copy the content of a CBOR TEXT or BYTES, concatenating the chunks of an indefinite-length one.
+		/*!
+		 * \param ptr Pointer to the begining of the string in buffer.
+		 * \param dest Buffer into which the content is copied, or NULL to
+		 * only compute its length.
+		 * \return The length (in bytes) of the content of the string.
+		 */
+		static size_t copy_string(const uint8_t *ptr, uint8_t *dest);
+
+		//! Add a JSON string as a CBOR TEXT, decoding its escape sequences.
+		/*!
+		 * \param ptr Pointer to the first character after the opening quote.
+		 * \param end Pointer to the end of the JSON text.
+		 * \return Pointer to the first character after the closing quote, or
+		 * NULL if the string is malformed or the buffer is too small.
+		 */
+		const char* add_json_string(const char *ptr, const char *end);
+
+		//! Add a JSON number as a CBOR UINT, NEGINT or float.
+		/*!
+		 * \param ptr Pointer to the first character of the number.
+		 * \param end Pointer to the end of the JSON text.
+		 * \return Pointer to the first character after the number, or NULL
+		 * if the number is malformed or the buffer is too small.
+		 */
+		const char* add_json_number(const char *ptr, const char *end);
+
+		//! Write the header of an array or a map converted from JSON.
+		/*!
+		 * A 1-byte header was written when the container was opened; the
+		 * elements are moved if the actual header is longer.
+		 *
+		 * \param head Offset of the header in the buffer.
+		 * \param num_ele Number of elements (CBOR ARRAY) or of pairs (CBOR PAIR).
+		 * \return False if the buffer is too small, true otherwise.
+		 */
+		bool end_json_container(size_t head, size_t num_ele);
+
 		//! Check if two buffers store the same information.
 		/*!
 		 * Check that the two buffers have same length, and that they store
@@ -187,6 +459,101 @@ class CBOR
 		static bool buffer_equals(const uint8_t* buf1, size_t len_buf1,
 				const uint8_t* buf2, size_t len_buf2);
 
+		//! Returns a pointer on the begining of the data section of a composed CBOR object.
+		/*!
+		 * \return Pointer on the first element (CBOR ARRAY) or on the first
+		 * key (CBOR PAIR) of this composed CBOR object.
+		 */
+		uint8_t* data_begin()
+		{
+			return get_buffer_begin()
+				+ compute_type_num_len(decode_abs_num(get_const_buffer_begin()));
+		}
+
+		//! Returns a pointer on an element of a composed CBOR object.
+		/*!
+		 * Uses the element index if available (see `build_index()`),
+		 * otherwise walks the buffer from the closest known element.
+		 * No range check is performed.
+		 *
+		 * \param idx Index of the element.
+		 * \return Pointer on the `idx`-th element (CBOR ARRAY) or on the
+		 * `idx`-th key (CBOR PAIR).
+		 */
+		uint8_t* element_ptr(size_t idx);
+
+		//! Hash an encoded CBOR key.
+		/*!
+		 * The key is given in two parts (typically its header and its
+		 * payload), that are hashed as if they were contiguous.
+		 *
+		 * \param head First part of the encoded key.
+		 * \param head_len Length (in bytes) of `head`.
+		 * \param tail Second part of the encoded key (can be NULL if `tail_len` is 0).
+		 * \param tail_len Length (in bytes) of `tail`.
+		 * \return The 32-bit FNV-1a hash of the encoded key.
+		 */
+		static uint32_t hash_key(const uint8_t *head, size_t head_len,
+				const uint8_t *tail, size_t tail_len);
+
+		//! Check if an encoded key, given in two parts (see `hash_key()`), equals a buffer.
+		/*!
+		 * \param key Buffer holding an encoded CBOR key.
+		 * \param key_len Length (in bytes) of `key`.
+		 * \return True if `key` is the concatenation of `head` and `tail`.
+		 */
+		static bool key_equals(const uint8_t *key, size_t key_len,
+				const uint8_t *head, size_t head_len,
+				const uint8_t *tail, size_t tail_len);
+
+		//! Compare an encoded key to another one, given in two parts (see `hash_key()`).
+		/*!
+		 * Keys are compared in bytewise lexicographic order (RFC 8949 §4.2.1).
+		 *
+		 * \param key Buffer holding an encoded CBOR key.
+		 * \param key_len Length (in bytes) of `key`.
+		 * \return A negative number if `key` sorts before the concatenation
+		 * of `head` and `tail`, 0 if they are equal, a positive number
+		 * otherwise.
+		 */
+		static int key_compare(const uint8_t *key, size_t key_len,
+				const uint8_t *head, size_t head_len,
+				const uint8_t *tail, size_t tail_len);
+
+		//! Check that the header of an item uses the shortest encoding of its argument.
+		static bool is_shortest_head(const uint8_t *ptr);
+
+		//! Sort the maps of an item and of its children in place (see `canonicalize()`).
+		/*!
+		 * \param ptr Pointer to the item.
+		 * \param _allocator Allocator of the temporary buffers.
+		 * \param depth Nesting depth of the item.
+		 * \return False if the item cannot be made deterministic.
+		 */
+		static bool canonicalize_item(uint8_t *ptr, CBORAllocator *_allocator, uint8_t depth);
+
+		//! Returns a pointer to the value located at an encoded key. Use for CBOR PAIR.
+		/*!
+		 * The key is given in two parts (see `hash_key()`). Uses the hashed
+		 * key index or the element index of a sorted Pair if available and up
+		 * to date, otherwise performs a linear search.
+		 *
+		 * \return A pointer to the value, or NULL if the key cannot be found
+		 * or if this object does not actually stores a CBOR PAIR.
+		 */
+		uint8_t* find_encoded_value(const uint8_t *head, size_t head_len,
+				const uint8_t *tail, size_t tail_len);
+
+		//! Returns the CBOR value located at an encoded key. Use for CBOR PAIR.
+		/*!
+		 * See `find_encoded_value()`.
+		 *
+		 * \return The retrieved CBOR value, or a CBOR NULL if the key cannot
+		 * be found or if this object does not actually stores a CBOR PAIR.
+		 */
+		CBOR find_by_encoded_key(const uint8_t *head, size_t head_len,
+				const uint8_t *tail, size_t tail_len);
+
 		//! Add a CBOR NULL at the end of the buffer.
 		bool add();
 		//! Add a CBOR BOOL at the end of the buffer.
@@ -204,11 +571,31 @@ class CBOR
 		 * \param value The positive integer to encode.
 		 * \return False if anything goes wrong. True otherwise.
 		 */
-		bool add(unsigned char value) { return encode_type_num(CBOR_UINT, value); }
-		bool add(unsigned short value) { return encode_type_num(CBOR_UINT, value); }
-		bool add(unsigned int value) { return encode_type_num(CBOR_UINT, value); }
-		bool add(unsigned long value) { return encode_type_num(CBOR_UINT, value); }
-		bool add(unsigned long long value) { return encode_type_num(CBOR_UINT, value); }
+		bool add(unsigned char value)
+		{
+			YACL_PROFILE_SCOPE(CBOR_PROFILE_ADD);
+			return encode_type_num(CBOR_UINT, value);
+		}
+		bool add(unsigned short value)
+		{
+			YACL_PROFILE_SCOPE(CBOR_PROFILE_ADD);
+			return encode_type_num(CBOR_UINT, value);
+		}
+		bool add(unsigned int value)
+		{
+			YACL_PROFILE_SCOPE(CBOR_PROFILE_ADD);
+			return encode_type_num(CBOR_UINT, value);
+		}
+		bool add(unsigned long value)
+		{
+			YACL_PROFILE_SCOPE(CBOR_PROFILE_ADD);
+			return encode_type_num(CBOR_UINT, value);
+		}
+		bool add(unsigned long long value)
+		{
+			YACL_PROFILE_SCOPE(CBOR_PROFILE_ADD);
+			return encode_type_num(CBOR_UINT, value);
+		}
 
 		//! Add a CBOR INT at the end of the buffer.
 		/*!
@@ -266,10 +653,12 @@ class CBOR
 		 */
 		template <typename T> bool add(T tag_value, const CBOR& tag_item)
 		{
-			bool status = false;
+			YACL_PROFILE_SCOPE(CBOR_PROFILE_ADD);
+
+			bool status = true;
 
-			status |= encode_type_num(CBOR_TAG, tag_value);
-			status |= add(tag_item);
+			status &= encode_type_num(CBOR_TAG, tag_value);
+			status &= add(tag_item);
 
 			return status;
 		}
@@ -281,6 +670,8 @@ class CBOR
 		 */
 		template <typename T> T as_num() const
 		{
+			YACL_PROFILE_SCOPE(CBOR_PROFILE_CAST);
+
 			if (is_uint8()) {
 				return (T)decode_abs_num8(get_const_buffer_begin());
 			}
@@ -311,7 +702,8 @@ class CBOR
 			}
 			if (is_int32()) {
 				if (is_neg_num()) {
-					return (T)(-1-decode_abs_num32(get_const_buffer_begin()));
+					//Computed on 64 bits: -1-x would wrap around as a uint32_t
+					return (T)(-1-(int64_t)decode_abs_num32(get_const_buffer_begin()));
 				}
 				else {
 					return (T)decode_abs_num32(get_const_buffer_begin());
@@ -384,6 +776,8 @@ class CBOR
 		 */
 		template <typename T> CBOR access_op_numeric(T idx)
 		{
+			YACL_PROFILE_SCOPE(CBOR_PROFILE_INDEX);
+
 			if (is_array()) {
 				return at(idx);
 			}
@@ -396,6 +790,473 @@ class CBOR
 			return CBOR();
 		}
 
+		//! True if floats are encoded with the shortest lossless precision.
+		static bool shortest_float;
+
+		//! Convert a float to half precision, if it can be done without loss.
+		/*!
+		 * Bit-level conversion, handling subnormals, infinities and NaN
+		 * payloads.
+		 *
+		 * \param value The float to convert.
+		 * \param half Set to the IEEE 754 binary16 representation of `value`.
+		 * \return True if `value` is exactly representable in half precision.
+		 */
+		static bool float_to_half(float value, uint16_t &half);
+
+		//! Convert a half precision float (IEEE 754 binary16) to a float.
+		static float half_to_float(uint16_t half);
+
+		//! Convert a double precision float (IEEE 754 binary64) to a double.
+		/*!
+		 * Where `double` is the same as `float` (AVR), the value is rounded
+		 * to a float.
+		 */
+		static double double_from_bits(uint64_t bits);
+
+		//! Convert a double to a float, if it can be done without loss.
+		/*!
+		 * \param value The double to convert.
+		 * \param single Set to `value` as a float.
+		 * \return True if `value` is exactly representable as a float.
+		 */
+		static bool double_to_float(double value, float &single);
+
+		//! Returns the RFC 8746 typed array tag of elements of type T.
+		/*!
+		 * \param big_endian True for big-endian elements, false for little-endian.
+		 */
+		template <typename T> static uint8_t typed_array_tag(bool big_endian)
+		{
+			uint8_t tag = CBOR_TYPED_ARRAY_FIRST;
+
+			if ((T)0.5 != (T)0) {
+				//float16, float32, float64
+				tag |= CBOR_TYPED_ARRAY_FLOAT | ((sizeof(T) == 8)?2:((sizeof(T) == 4)?1:0));
+			}
+			else {
+				if ((T)(-1) < (T)0) {
+					tag |= CBOR_TYPED_ARRAY_SIGNED;
+				}
+				tag |= (sizeof(T) == 8)?3:((sizeof(T) == 4)?2:((sizeof(T) == 2)?1:0));
+			}
+
+			//Single bytes have no byte order
+			if (!big_endian && (sizeof(T) > 1)) {
+				tag |= CBOR_TYPED_ARRAY_LE;
+			}
+
+			return tag;
+		}
+
+		//! Copy typed array elements, swapping their bytes if requested.
+		/*!
+		 * \param dst Destination buffer (`num_ele*elem_size` bytes).
+		 * \param src Source buffer (`num_ele*elem_size` bytes).
+		 * \param num_ele Number of elements.
+		 * \param elem_size Size (in bytes) of an element.
+		 * \param swap True to reverse the bytes of each element.
+		 */
+		static void copy_typed_array(uint8_t *dst, const uint8_t *src, size_t num_ele,
+				uint8_t elem_size, bool swap);
+
+		//! Get the content of an RFC 8746 typed array.
+		/*!
+		 * \param ptr Pointer to the typed array (its tag).
+		 * \param tag Set to the typed array tag.
+		 * \param len Set to the length (in bytes) of the content.
+		 * \return Pointer to the content, or NULL if `ptr` is not a
+		 * supported typed array (or its length is not a multiple of the
+		 * element size).
+		 */
+		static const uint8_t* typed_array_data(const uint8_t *ptr, uint8_t &tag, size_t &len);
+
+		//! Returns the size (in bytes) of the elements of a typed array, from its tag.
+		static uint8_t typed_array_elem_size(uint8_t tag);
+
+		//! Add an RFC 8746 typed array.
+		/*!
+		 * \param values Pointer to the elements, in native byte order.
+		 * \param num_ele Number of elements.
+		 * \param elem_size Size (in bytes) of an element.
+		 * \param tag Typed array tag.
+		 * \param swap True to reverse the bytes of each element.
+		 * \return False if anything goes wrong. True otherwise.
+		 */
+		bool add_typed_array(const uint8_t *values, size_t num_ele, uint8_t elem_size,
+				uint8_t tag, bool swap);
+
+		//! Add integers, each one as the shortest CBOR (U)INT.
+		/*!
+		 * The total size is computed first (several integers at a time
+		 * with SSE2), so that the buffer is reserved once, then the
+		 * integers are written in a single loop.
+		 *
+		 * \param values Pointer to the integers.
+		 * \param num_ele Number of integers.
+		 * \param elem_size Size (in bytes) of an integer: 1, 2, 4 or 8.
+		 * \param is_signed True if the integers are signed.
+		 * \return False if anything goes wrong. True otherwise.
+		 */
+		bool add_int_array(const uint8_t *values, size_t num_ele, uint8_t elem_size, bool is_signed);
+
+		//! Read a big-endian 16-bit unsigned integer.
+		/*!
+		 * Written with shifts, so that it does not depend on the byte order
+		 * of the target: compilers turn it into a single load (and a byte
+		 * swap on little-endian targets).
+		 */
+		static uint16_t read_be16(const uint8_t *ptr)
+		{
+			return (uint16_t)(((uint16_t)ptr[0] << 8) | ptr[1]);
+		}
+
+		//! Read a big-endian 32-bit unsigned integer (see `read_be16()`).
+		static uint32_t read_be32(const uint8_t *ptr)
+		{
+			return ((uint32_t)ptr[0] << 24) | ((uint32_t)ptr[1] << 16) | ((uint32_t)ptr[2] << 8) | ptr[3];
+		}
+
+		//! Read a big-endian 64-bit unsigned integer (see `read_be16()`).
+		static uint64_t read_be64(const uint8_t *ptr)
+		{
+			return ((uint64_t)read_be32(ptr) << 32) | read_be32(ptr + 4);
+		}
+
+		//! Convert an integer to T, if it is in the range of T.
+		/*!
+		 * Integers are rounded to the nearest when T is `float` or `double`.
+		 *
+		 * \param negative True for a negative integer (`-1-abs_val`).
+		 * \param abs_val Argument of the encoded integer.
+		 * \param value Set to the integer, converted to T.
+		 * \return False if the integer is out of the range of T.
+		 */
+		template <typename T> static bool int_to_num(bool negative, uint64_t abs_val, T &value)
+		{
+			if ((T)0.5 != (T)0) {
+				value = negative?(T)(-1 - (T)abs_val):(T)abs_val;
+				return true;
+			}
+
+			bool is_signed = ((T)(-1) < (T)0);
+			uint64_t max_abs = is_signed?(((uint64_t)1 << (8*sizeof(T) - 1)) - 1):(uint64_t)(T)(-1);
+			if ((abs_val > max_abs) || (negative && !is_signed)) {
+				return false;
+			}
+			//Computed on 64 bits: -1-x would wrap around if x is unsigned
+			value = negative?(T)(-1 - (int64_t)abs_val):(T)abs_val;
+			return true;
+		}
+
+		//! Convert a float to T, if T is `float` or `double` and can hold it.
+		/*!
+		 * \param decoded The decoded float (`float` or `double`).
+		 * \param value Set to `decoded`, converted to T.
+		 * \return False if T is an integer type, or if `decoded` is finite
+		 * but out of the range of T.
+		 */
+		template <typename T, typename F> static bool float_to_num(F decoded, T &value)
+		{
+			if ((T)0.5 == (T)0) {
+				return false;
+			}
+			//Only narrowing conversions (double to float) can overflow, and
+			//converting a value out of range is undefined: check it first
+			if ((sizeof(T) < sizeof(F)) && (fabs(decoded) > FLT_MAX) && !isinf(decoded)) {
+				return false;
+			}
+			value = (T)decoded;
+			return true;
+		}
+
+		//! Convert consecutive numbers of an array to T.
+		/*!
+		 * One-byte integers (-24 to 23) are converted as a run. Other
+		 * elements are converted as a run of elements with the same initial
+		 * byte: they all have the same size, so they are read with a fixed
+		 * stride and a single big-endian load each, without decoding their
+		 * header again.
+		 *
+		 * \param ptr Pointer to the first element, moved past the converted
+		 * elements.
+		 * \param values Buffer receiving the elements.
+		 * \param max_ele Maximum number of elements to convert (at least
+		 * `max_ele` elements, or a break, must follow `ptr`).
+		 * \return The number of elements converted, 0 if the first one is
+		 * not a number that can be converted to T.
+		 */
+		template <typename T> static size_t decode_number_run(const uint8_t *&ptr, T *values, size_t max_ele)
+		{
+			const uint8_t head = ptr[0];
+			const uint8_t *p = ptr;
+			size_t n = 0;
+
+			if ((head < CBOR_BYTES) && ((head & CBOR_INFO_BITS) < CBOR_UINT8_FOLLOWS)) {
+				while ((n < max_ele) && (p[0] < CBOR_BYTES) && ((p[0] & CBOR_INFO_BITS) < CBOR_UINT8_FOLLOWS)
+						&& int_to_num(p[0] >= CBOR_NEGINT, p[0] & CBOR_INFO_BITS, values[n])) {
+					++p;
+					++n;
+				}
+				ptr = p;
+				return n;
+			}
+
+			bool negative = ((head & CBOR_TYPE_MASK) == CBOR_NEGINT);
+			switch (head) {
+				case CBOR_UINT8_FOLLOWS:
+				case CBOR_NEGINT | CBOR_UINT8_FOLLOWS:
+					while ((n < max_ele) && (p[0] == head) && int_to_num(negative, p[1], values[n])) {
+						p += 2;
+						++n;
+					}
+					break;
+
+				case CBOR_UINT16_FOLLOWS:
+				case CBOR_NEGINT | CBOR_UINT16_FOLLOWS:
+					while ((n < max_ele) && (p[0] == head) && int_to_num(negative, read_be16(p + 1), values[n])) {
+						p += 3;
+						++n;
+					}
+					break;
+
+				case CBOR_UINT32_FOLLOWS:
+				case CBOR_NEGINT | CBOR_UINT32_FOLLOWS:
+					while ((n < max_ele) && (p[0] == head) && int_to_num(negative, read_be32(p + 1), values[n])) {
+						p += 5;
+						++n;
+					}
+					break;
+
+				case CBOR_UINT64_FOLLOWS:
+				case CBOR_NEGINT | CBOR_UINT64_FOLLOWS:
+					while ((n < max_ele) && (p[0] == head) && int_to_num(negative, read_be64(p + 1), values[n])) {
+						p += 9;
+						++n;
+					}
+					break;
+
+				case CBOR_FLOAT16:
+					while ((n < max_ele) && (p[0] == head) && float_to_num(half_to_float(read_be16(p + 1)), values[n])) {
+						p += 3;
+						++n;
+					}
+					break;
+
+				case CBOR_FLOAT32:
+					while (n < max_ele && (p[0] == head)) {
+						uint32_t bits = read_be32(p + 1);
+						float decoded;
+						memcpy(&decoded, &bits, sizeof(decoded));
+						if (!float_to_num(decoded, values[n])) {
+							break;
+						}
+						p += 5;
+						++n;
+					}
+					break;
+
+				case CBOR_FLOAT64:
+					while (n < max_ele && (p[0] == head)) {
+						double decoded;
+						if (sizeof(double) == 8) {
+							uint64_t bits = read_be64(p + 1);
+							memcpy(&decoded, &bits, sizeof(decoded));
+						}
+						else {
+							//On AVR, double is the same as float
+							decoded = (double)CBOR((uint8_t*)p, 9, true);
+						}
+						if (!float_to_num(decoded, values[n])) {
+							break;
+						}
+						p += 9;
+						++n;
+					}
+					break;
+			}
+
+			ptr = p;
+			return n;
+		}
+
+		//! Hash of a field name.
+		static uint16_t field_hash(const char *name, size_t len);
+
+		//! Compute the hashes of the names of the fields of a struct.
+		/*!
+		 * \param field_names Names of the fields.
+		 * \param num_fields Number of fields.
+		 * \param hashes Array of `num_fields` hashes, filled by this function.
+		 */
+		static void hash_fields(const char* const *field_names, size_t num_fields, uint16_t *hashes);
+
+		//! Find the field of a struct matching a key.
+		/*!
+		 * Only the fields whose name has the same hash as the key are
+		 * compared to it, starting from `hint`, so that keys in declaration
+		 * order are matched on the first try.
+		 *
+		 * \param key Pointer to the encoded key.
+		 * \param field_names Names of the fields.
+		 * \param hashes Hashes of the names of the fields (see `hash_fields()`).
+		 * \param num_fields Number of fields.
+		 * \param hint Index of the first field to compare to.
+		 * \return The index of the field, or `num_fields` if none matches.
+		 */
+		static size_t find_field(const uint8_t *key, const char* const *field_names,
+				const uint16_t *hashes, size_t num_fields, size_t hint);
+
+		//! Visitor decoding a value into a field of a struct.
+		class FieldReader
+		{
+			public:
+				//! Pointer to the encoded value.
+				const uint8_t *value;
+				//! Number of unknown keys found so far (in nested structs too).
+				size_t &n_unknown;
+				//! True if the last value was decoded.
+				bool ok = false;
+
+				FieldReader(size_t &_n_unknown) : value(NULL), n_unknown(_n_unknown) {};
+
+				template <typename T> void operator()(size_t, const char*, T &field)
+				{
+					ok = read(field, 0);
+				}
+
+				bool read(bool &field, int)
+				{
+					if (!is_bool(value)) {
+						return false;
+					}
+					field = (value[0] == CBOR_TRUE);
+					return true;
+				}
+
+				bool read(float &field, int)
+				{
+					if (!is_float16(value) && !is_float32(value) && !is_float64(value)) {
+						return false;
+					}
+					//FLOAT64 is only converted by operator double()
+					field = (float)(double)CBOR((uint8_t*)value, element_size((uint8_t*)value), true);
+					return true;
+				}
+
+				bool read(double &field, int)
+				{
+					if (!is_float16(value) && !is_float32(value) && !is_float64(value)) {
+						return false;
+					}
+					field = (double)CBOR((uint8_t*)value, element_size((uint8_t*)value), true);
+					return true;
+				}
+
+				//Integers
+				template <typename T> auto read(T &field, int) -> decltype((T)0 & 0, bool())
+				{
+					bool fits = ((T)(-1) < (T)0)?is_snum<T>(value):is_unum<T>(value);
+					if (!fits) {
+						return false;
+					}
+
+					uint64_t abs_val;
+					switch (value[0] & CBOR_INFO_BITS) {
+						case CBOR_UINT64_FOLLOWS:
+							abs_val = decode_abs_num64(value);
+							break;
+						case CBOR_UINT32_FOLLOWS:
+							abs_val = decode_abs_num32(value);
+							break;
+						case CBOR_UINT16_FOLLOWS:
+							abs_val = decode_abs_num16(value);
+							break;
+						default:
+							abs_val = decode_abs_num8(value);
+							break;
+					}
+					field = ((value[0] & CBOR_7) == CBOR_NEGINT)?(T)(-1-(int64_t)abs_val):(T)abs_val;
+					return true;
+				}
+
+				//Strings, NULL terminated
+				template <size_t N> bool read(char (&field)[N], int)
+				{
+					if (!is_string(value)) {
+						return false;
+					}
+					size_t len = copy_string(value, NULL);
+					if (len >= N) {
+						return false;
+					}
+					copy_string(value, (uint8_t*)field);
+					field[len] = '\0';
+					return true;
+				}
+
+				//Nested structs
+				template <typename T> auto read(T &field, int)
+					-> decltype(CBORFields<T>::num_fields, bool())
+				{
+					uint32_t found = 0;
+					return decode_fields_at(value, field, found, n_unknown);
+				}
+		};
+
+		//! Decode a CBOR PAIR into a struct.
+		/*!
+		 * \param ptr Pointer to the CBOR PAIR.
+		 * \param obj The struct to fill.
+		 * \param found Bit `i` is set when field `i` is decoded.
+		 * \param n_unknown Incremented for each key matching no field.
+		 * \return True if all the fields were decoded, false otherwise.
+		 */
+		template <typename S> static bool decode_fields_at(const uint8_t *ptr, S &obj,
+				uint32_t &found, size_t &n_unknown)
+		{
+			const size_t num_fields = CBORFields<S>::num_fields;
+			const uint32_t all_found = (uint32_t)(((uint64_t)1 << num_fields) - 1);
+
+			if (!is_pair(ptr)) {
+				return false;
+			}
+
+			//Indefinite-length maps are read up to the break
+			bool indefinite = ((ptr[0] & CBOR_INFO_BITS) == CBOR_VAR_FOLLOWS);
+			size_t num_ele = indefinite?(size_t)(-1):decode_abs_num(ptr);
+			const uint8_t *ele = ptr + (indefinite?1:compute_type_num_len(num_ele));
+			size_t hint = 0;
+			uint16_t hashes[num_fields];
+			FieldReader reader(n_unknown);
+
+			hash_fields(CBORFields<S>::field_names(), num_fields, hashes);
+
+			for (size_t i=0 ; i < num_ele ; ++i) {
+				if (indefinite && (*ele == CBOR_BREAK)) {
+					break;
+				}
+				reader.value = ele + element_size((uint8_t*)ele);
+				size_t idx = find_field(ele, CBORFields<S>::field_names(), hashes, num_fields, hint);
+
+				if (idx == num_fields) {
+					++n_unknown;
+				}
+				//Duplicate keys: the first one wins
+				else if (!(found & ((uint32_t)1 << idx))) {
+					CBORFields<S>::visit_field(obj, idx, reader);
+					if (reader.ok) {
+						found |= ((uint32_t)1 << idx);
+					}
+					hint = idx + 1;
+				}
+
+				ele = reader.value + element_size((uint8_t*)reader.value);
+			}
+
+			return (found == all_found);
+		}
+
 	public:
 		//Constructors for primitive types
 		//! Construct a stack-allocated NULL CBOR object.
@@ -407,6 +1268,17 @@ class CBOR
 		 */
 		template <typename T> CBOR(T value) { add(value); }
 
+		//! Construct a CBOR object, using a custom allocator.
+		/*!
+		 * The allocator is used if `value` does not fit in the statically
+		 * allocated internal buffer (e.g. long strings), and for the indexes.
+		 *
+		 * \param value The value to encode.
+		 * \param _allocator The allocator to use.
+		 */
+		template <typename T> CBOR(T value, CBORAllocator &_allocator)
+			: allocator(&_allocator) { add(value); }
+
 		//! Constructor for tagged CBOR objects.
 		/*!
 		 * \param tag_value Tag value to be encoded.
@@ -437,9 +1309,38 @@ class CBOR
 		 */
 		CBOR(const uint8_t* buffer, size_t buffer_len);
 
+		//! Parse and create a CBOR object from a byte array of CBOR data, using a custom allocator.
+		/*!
+		 * \param buffer Pointer to the beginning of the array.
+		 * \param buffer_len Size (in bytes) of the array.
+		 * \param _allocator The allocator to use for the copy.
+		 */
+		CBOR(const uint8_t* buffer, size_t buffer_len, CBORAllocator &_allocator);
+
 		//! Copy constructor.
 		CBOR(const CBOR &obj);
 
+		//! Move constructor.
+		/*!
+		 * Takes over the buffer of `obj` without copying it (only the
+		 * STATIC_INTERNAL buffer of small values is copied). `obj` is left as
+		 * CBOR NULL.
+		 */
+		CBOR(CBOR &&obj);
+
+		//! Copy assignment operator.
+		/*!
+		 * The copy is allocated with the allocator of this object.
+		 */
+		CBOR& operator=(const CBOR &obj);
+
+		//! Move assignment operator.
+		/*!
+		 * Takes over the buffer (and allocator) of `obj` without copying it.
+		 * `obj` is left as CBOR NULL.
+		 */
+		CBOR& operator=(CBOR &&obj);
+
 		//! Destructor.
 		~CBOR();
 
@@ -453,6 +1354,8 @@ class CBOR
 		 */
 		template <typename T> bool encode(T value)
 		{
+			drop_index();
+			drop_key_index();
 			w_ptr = get_buffer_begin();
 			return add(value);
 		}
@@ -480,12 +1383,46 @@ class CBOR
 		bool encode(const uint8_t* value, size_t len)
 		{ w_ptr = get_buffer_begin(); return add(value, len); }
 
+		//! Replace the value encoded in this CBOR object with a JSON document.
+		/*!
+		 * The JSON text is converted in a single pass, directly into the
+		 * buffer of this object: no intermediate CBOR object is built. The
+		 * buffer is reserved once for the length of the JSON text, which is
+		 * enough for most documents (CBOR is more compact than JSON, except
+		 * for some floats).
+		 *
+		 * Values are converted as follows:
+		 * - objects and arrays become definite-length CBOR PAIR and ARRAY
+		 *   (their header is written once the number of elements is known),
+		 * - strings become CBOR TEXT, with escape sequences decoded,
+		 * - numbers without fraction nor exponent become CBOR UINT or
+		 *   NEGINT, in their shortest encoding (or a float if out of range),
+		 * - other numbers become floats, encoded as `add(double)` does (see
+		 *   `set_shortest_float()` to use FLOAT16 and FLOAT32 when lossless),
+		 * - `true`, `false` and `null` become CBOR BOOL and NULL.
+		 *
+		 * Do not use this method with CBORArray and CBORPair.
+		 *
+		 * \param json Pointer to the JSON text (UTF-8, not necessarily
+		 * null-terminated).
+		 * \param json_len Length (in bytes) of the JSON text.
+		 * \return False if the text is not a valid JSON document, is nested
+		 * deeper than `CBOR_JSON_MAX_DEPTH`, has a number longer than 63
+		 * characters, or if the buffer is too small. This object then stores
+		 * a CBOR NULL. True otherwise.
+		 */
+		bool encode_json(const char *json, size_t json_len);
+
+		//! Replace the value encoded in this CBOR object with a null-terminated JSON document.
+		bool encode_json(const char *json) { return encode_json(json, strlen(json)); }
+
 
 		//! Reserve some space in the buffer.
 		/*
 		 * - If buffer is DYNAMIC_INTERNAL, then reserve will do necessary
 		 * reallocation to accomodate for the total length given in parameter
-		 * (if needed).
+		 * (if needed). The buffer grows geometrically (see
+		 * `BUFFER_GROWTH_NUM`), so it may end up larger than requested.
 		 * - If buffer is STATIC_INTERNAL, then reserve will first check if the
 		 * requested length require allocation of a DYNAMIC_INTERNAL buffer. If
 		 * yes, it will do the necessary allocation and copy. Otherwise, it will
@@ -497,6 +1434,22 @@ class CBOR
 		 */
 		virtual bool reserve(size_t length);
 
+		//! Get the capacity of this CBOR object.
+		/*!
+		 * \return The maximum length this CBOR message can reach without
+		 * reallocating its buffer.
+		 */
+		virtual size_t capacity() const { return max_buf_len; }
+
+		//! Release unused memory.
+		/*!
+		 * If buffer is DYNAMIC_INTERNAL, reallocate it to the current length
+		 * of this CBOR message. Otherwise, do nothing.
+		 *
+		 * \return False if reallocation failed, true otherwise.
+		 */
+		virtual bool shrink_to_fit();
+
 		//! Get the length of this CBOR message
 		/*
 		 * \return The length of this CBOR message.
@@ -517,6 +1470,132 @@ class CBOR
 		 */
 		uint8_t* get_buffer() { return get_buffer_begin(); }
 
+		//! Check that a buffer begins with a well-formed CBOR item.
+		/*!
+		 * Checks every header, every declared length and count against the
+		 * end of the buffer, and the nesting depth (at most
+		 * `CBOR_VALIDATE_MAX_DEPTH` arrays, maps and indefinite-length
+		 * strings), in a single pass and without recursion.
+		 *
+		 * Accessors (`at()`, `operator[]`, casts...) do not check bounds: on
+		 * untrusted input, validate the data once, then use a view on the
+		 * validated item:
+		 * ```
+		 * size_t len = CBOR::validate(buffer, buffer_len);
+		 * if (len > 0) {
+		 * 	CBOR msg = CBOR(buffer, len, true);
+		 * 	...
+		 * }
+		 * ```
+		 *
+		 * \param buffer Pointer to the beginning of the buffer.
+		 * \param buffer_len Size (in bytes) of the buffer.
+		 * \return The length of the first CBOR item of the buffer, or 0 if it
+		 * is malformed, truncated or too deeply nested.
+		 */
+		static size_t validate(const uint8_t *buffer, size_t buffer_len);
+
+		//! Check that this CBOR object holds exactly one well-formed CBOR item.
+		/*!
+		 * \return True if `validate()` accepts the whole content of this
+		 * object, false otherwise.
+		 */
+		bool is_valid() const
+		{
+			return (length() > 0) && (validate(to_CBOR(), length()) == length());
+		}
+
+		//! Select how floats are encoded.
+		/*!
+		 * By default, `float` values are encoded as CBOR FLOAT32, and
+		 * `double` values as CBOR FLOAT64. In shortest mode, values are
+		 * encoded with the shortest of FLOAT16, FLOAT32 and FLOAT64 that
+		 * represents them exactly (RFC 8949 preferred serialization): for
+		 * instance 21.5 takes 3 bytes instead of 5 or 9. Decoding is not
+		 * affected.
+		 *
+		 * \param enable True for shortest mode, false for the default mode.
+		 */
+		static void set_shortest_float(bool enable) { shortest_float = enable; }
+
+		//! Check if floats are encoded with the shortest lossless precision (see `set_shortest_float()`).
+		static bool get_shortest_float() { return shortest_float; }
+
+		//! Get the length of the CBOR encoding of a value.
+		/*!
+		 * \param value A value, as given to `encode()` or `append()`.
+		 * \return The number of bytes `value` takes once encoded.
+		 */
+		static size_t encoded_len(bool) { return 1; }
+		static size_t encoded_len(unsigned char value) { return encoded_len((unsigned long long)value); }
+		static size_t encoded_len(unsigned short value) { return encoded_len((unsigned long long)value); }
+		static size_t encoded_len(unsigned int value) { return encoded_len((unsigned long long)value); }
+		static size_t encoded_len(unsigned long value) { return encoded_len((unsigned long long)value); }
+		static size_t encoded_len(unsigned long long value)
+		{
+			if (value < 24) {
+				return 1;
+			}
+			if (value <= 0xFF) {
+				return 2;
+			}
+			if (value <= 0xFFFF) {
+				return 3;
+			}
+			return (value <= 0xFFFFFFFF)?5:9;
+		}
+		static size_t encoded_len(char value) { return encoded_len((long long)value); }
+		static size_t encoded_len(signed char value) { return encoded_len((long long)value); }
+		static size_t encoded_len(short value) { return encoded_len((long long)value); }
+		static size_t encoded_len(int value) { return encoded_len((long long)value); }
+		static size_t encoded_len(long value) { return encoded_len((long long)value); }
+		static size_t encoded_len(long long value)
+		{
+			return encoded_len((unsigned long long)((value < 0)?(-1-value):value));
+		}
+		static size_t encoded_len(float value);
+		static size_t encoded_len(double value);
+		static size_t encoded_len(const char* value)
+		{
+			size_t len_string = strlen(value);
+			return compute_type_num_len(len_string) + len_string;
+		}
+		static size_t encoded_len(const CBOR &value) { return value.length(); }
+
+		//! Decode this CBOR PAIR into a struct, in a single pass.
+		/*!
+		 * The fields of `S` must be declared with `YACL_FIELDS()` (see
+		 * CBORFields.h). Each key is matched against the field names, and its
+		 * value decoded into the field if it has the expected type: a CBOR
+		 * integer that fits for integer fields, a CBOR float for `float` and
+		 * `double` fields, a CBOR boolean for `bool` fields, a CBOR TEXT
+		 * shorter than the array for `char` array fields, and a CBOR PAIR
+		 * for nested structs (which must be decoded completely). Other fields
+		 * are left untouched.
+		 *
+		 * \param obj The struct to fill.
+		 * \param missing If not NULL, set to a bitmask of the fields not
+		 * decoded (bit `i` for the `i`-th field): missing, or of the wrong type.
+		 * \param unknown If not NULL, set to the number of keys matching no
+		 * field (including in nested structs).
+		 * \return True if all the fields were decoded, false otherwise.
+		 */
+		template <typename S> bool decode_fields(S &obj, uint32_t *missing = NULL, size_t *unknown = NULL) const
+		{
+			uint32_t found = 0;
+			size_t n_unknown = 0;
+			bool ret_val = decode_fields_at(get_const_buffer_begin(), obj, found, n_unknown);
+
+			if (missing != NULL) {
+				*missing = (uint32_t)(((uint64_t)1 << CBORFields<S>::num_fields) - 1) & ~found;
+			}
+			if (unknown != NULL) {
+				*unknown = n_unknown;
+			}
+
+			return ret_val;
+		}
+
 		//! Return true if the CBOR object is a CBOR NULL.
 		/*
 		 * \param buffer Pointer to the begining of the buffer containing the CBOR object.
@@ -721,6 +1800,13 @@ class CBOR
 		bool is_pair() const {return is_pair(get_const_buffer_begin()); };
 		//! Return true if the CBOR object is a tagged CBOR object.
 		bool is_tag() const {return is_tag(get_const_buffer_begin()); };
+		//! Return true if this CBOR object is an indefinite-length string, byte string, array or dictionnary.
+		bool is_indefinite() const
+		{
+			const uint8_t *buffer = get_const_buffer_begin();
+			return ((buffer[0] & CBOR_INFO_BITS) == CBOR_VAR_FOLLOWS)
+				&& ((buffer[0] & CBOR_TYPE_MASK) >= CBOR_BYTES) && ((buffer[0] & CBOR_TYPE_MASK) <= CBOR_MAP);
+		}
 
 		//! Convert this CBOR object to a boolean.
 		/*!
@@ -809,12 +1895,13 @@ class CBOR
 		//! When this CBOR object is a CBOR STRING, returns this string length.
 		/*!
 		 * Output of this function when this CBOR object is not a string is undefined.
+		 * The chunks of an indefinite-length string are concatenated.
 		 *
 		 * \return Length of a CBOR string.
 		 */
 		size_t get_string_len() const
 		{
-			return decode_abs_num(get_const_buffer_begin());
+			return copy_string(get_const_buffer_begin(), NULL);
 		}
 
 		//! When this CBOR object is a CBOR STRING, copies it to this one passed as a parameter.
@@ -846,12 +1933,13 @@ class CBOR
 		//! When this CBOR object is a CBOR BYTE STRING, returns this byte string length.
 		/*!
 		 * Output of this function when this CBOR object is not a byte string is undefined.
+		 * The chunks of an indefinite-length string are concatenated.
 		 *
 		 * \return Length of a CBOR byte string.
 		 */
 		size_t get_bytestring_len() const
 		{
-			return decode_abs_num(get_const_buffer_begin());
+			return copy_string(get_const_buffer_begin(), NULL);
 		}
 
 		//! When this CBOR object is a CBOR BYTE STRING, copies it to this one passed as a parameter.
@@ -882,12 +1970,187 @@ class CBOR
 		 */
 		CBOR get_tag_item();
 
+		//! Encode an RFC 8746 typed array (a tag and a byte string).
+		/*!
+		 * In native byte order, the elements are copied with a single
+		 * `memcpy()`. Supported element types are 8 to 64 bits signed and
+		 * unsigned integers, `float` and `double`.
+		 *
+		 * \param values Pointer to the elements.
+		 * \param num_ele Number of elements.
+		 * \param big_endian True to encode big-endian elements, false for
+		 * little-endian (defaults to the native byte order).
+		 * \return False if anything goes wrong. True otherwise.
+		 */
+		template <typename T> bool encode_typed_array(const T *values, size_t num_ele,
+				bool big_endian = CBOR_BIG_ENDIAN)
+		{
+			w_ptr = get_buffer_begin();
+			return add_typed_array((const uint8_t*)values, num_ele, sizeof(T),
+					typed_array_tag<T>(big_endian), (sizeof(T) > 1) && (big_endian != CBOR_BIG_ENDIAN));
+		}
+
+		//! Return true if the CBOR object is an RFC 8746 typed array.
+		bool is_typed_array() const
+		{
+			uint8_t tag;
+			size_t len;
+			return (typed_array_data(get_const_buffer_begin(), tag, len) != NULL);
+		}
+
+		//! When this CBOR object is an RFC 8746 typed array, return its number of elements.
+		/*!
+		 * \return The number of elements, or 0 if this CBOR object is not a
+		 * typed array.
+		 */
+		size_t get_typed_array_len() const;
+
+		//! When this CBOR object is an RFC 8746 typed array of T, copy its elements.
+		/*!
+		 * Elements are converted to the native byte order if needed.
+		 *
+		 * \param values Buffer into which elements are copied.
+		 * \param max_ele Capacity (in elements) of `values`.
+		 * \return The number of elements copied, or 0 if this CBOR object is
+		 * not a typed array of T.
+		 */
+		template <typename T> size_t get_typed_array(T *values, size_t max_ele) const
+		{
+			uint8_t tag;
+			size_t len;
+			const uint8_t *data = typed_array_data(get_const_buffer_begin(), tag, len);
+			uint8_t native_tag = typed_array_tag<T>(CBOR_BIG_ENDIAN);
+
+			if ((data == NULL) || ((tag | CBOR_TYPED_ARRAY_LE) != (native_tag | CBOR_TYPED_ARRAY_LE))) {
+				return 0;
+			}
+
+			size_t num_ele = len/sizeof(T);
+			if (num_ele > max_ele) {
+				num_ele = max_ele;
+			}
+			copy_typed_array((uint8_t*)values, data, num_ele, sizeof(T),
+					(sizeof(T) > 1) && (tag != native_tag));
+
+			return num_ele;
+		}
+
+		//! When this CBOR object is an RFC 8746 typed array of T, get its elements without copy.
+		/*!
+		 * Only possible when the elements are in native byte order, and
+		 * suitably aligned for T in the buffer.
+		 *
+		 * \param values Set to a pointer to the elements, in the buffer of
+		 * this CBOR object.
+		 * \param num_ele Set to the number of elements.
+		 * \return True if the elements can be used in place, false
+		 * otherwise (use `get_typed_array()`).
+		 */
+		template <typename T> bool get_typed_array_view(const T* &values, size_t &num_ele) const
+		{
+			uint8_t tag;
+			size_t len;
+			const uint8_t *data = typed_array_data(get_const_buffer_begin(), tag, len);
+			uint8_t native_tag = typed_array_tag<T>(CBOR_BIG_ENDIAN);
+
+			if ((data == NULL) || (((uintptr_t)data % alignof(T)) != 0)) {
+				return false;
+			}
+			//Ignore the clamped flag of uint8
+			if ((tag != native_tag) && ((sizeof(T) > 1) || ((tag | CBOR_TYPED_ARRAY_LE) != (native_tag | CBOR_TYPED_ARRAY_LE)))) {
+				return false;
+			}
+
+			values = (const T*)data;
+			num_ele = len/sizeof(T);
+
+			return true;
+		}
+
+		//! When this CBOR object is a CBOR ARRAY of numbers, convert its elements to T.
+		/*!
+		 * The array is walked once. Integers of any width, negative or not,
+		 * are converted if they are in the range of T. Floats (half, single
+		 * or double precision) are converted if T is `float` or `double`,
+		 * and if they are in the range of T. Integers are converted to
+		 * `float` and `double` too, rounded to the nearest.
+		 *
+		 * Conversion stops at the first element that cannot be converted:
+		 * when the returned count is less than both `max_ele` and
+		 * `n_elements()`, it is the index of that element.
+		 *
+		 * \param values Buffer receiving the elements.
+		 * \param max_ele Capacity (in elements) of `values`.
+		 * \return The number of elements converted, or 0 if this CBOR object
+		 * is not a CBOR ARRAY.
+		 */
+		template <typename T> size_t decode_into(T *values, size_t max_ele) const
+		{
+			const uint8_t *ptr = get_const_buffer_begin();
+
+			if (!is_array(ptr)) {
+				return 0;
+			}
+
+			//Indefinite-length arrays are read up to the break
+			bool indefinite = ((ptr[0] & CBOR_INFO_BITS) == CBOR_VAR_FOLLOWS);
+			size_t num_ele = indefinite?(size_t)(-1):decode_abs_num(ptr);
+			ptr += indefinite?1:compute_type_num_len(num_ele);
+			if (num_ele > max_ele) {
+				num_ele = max_ele;
+			}
+
+			size_t n = 0;
+			while (n < num_ele) {
+				size_t run = decode_number_run(ptr, values + n, num_ele - n);
+				if (run == 0) {
+					break;
+				}
+				n += run;
+			}
+
+			return n;
+		}
+
 		//! Get the number of elements in this composed CBOR object.
 		/*!
+		 * The elements of an indefinite-length array or dictionnary are
+		 * counted up to the break.
+		 *
 		 * \return The number of elements in this composed CBOR object.
 		 */
 		size_t n_elements() const;
 
+		//! Build an index of the elements of this composed CBOR object.
+		/*!
+		 * Once built, `at()`, `key_at()` and `operator[]` with a numeric
+		 * index run in constant time, instead of walking the buffer from the
+		 * first element on every call. The index costs one `size_t` per
+		 * element (per key/value pair for a CBOR PAIR).
+		 *
+		 * Elements appended after the index was built are still reachable,
+		 * but are found by walking the buffer from the last indexed element.
+		 * Note that the index is never shared: elements retrieved with
+		 * `at()` or `operator[]` are not indexed.
+		 *
+		 * \return True if the index was built, false if this object is not
+		 * a CBOR ARRAY nor a CBOR PAIR, or if allocation failed.
+		 */
+		bool build_index();
+
+		//! Enable or disable the element index.
+		/*!
+		 * When enabled, the index is built on first indexed access (see
+		 * `build_index()`), and rebuilt when accessing an element appended
+		 * since. Disabling it frees the index.
+		 *
+		 * \param enable True to enable the index, false to disable it.
+		 */
+		void use_index(bool enable = true);
+
+		//! Free the element index, if any.
+		void drop_index();
+
 		//! Returns the CBOR value located at an index. Use for CBOR ARRAY and CBOR PAIR.
 		/*!
 		 * This operator does not perform any copy.
@@ -901,25 +2164,17 @@ class CBOR
 		 */
 		template <typename T> CBOR at(T idx)
 		{
-			size_t n_elements = decode_abs_num(get_const_buffer_begin());
-			uint8_t *ele_begin = get_buffer_begin() + compute_type_num_len(n_elements);
+			YACL_PROFILE_SCOPE(CBOR_PROFILE_AT);
 
-			if ((!is_pair() && !is_array()) || (idx > n_elements) || (idx < 0)) {
+			if ((!is_pair() && !is_array()) || (idx < 0) || ((size_t)idx >= n_elements())) {
 				return CBOR();
 			}
 
-			//Jump to the reffered value
+			uint8_t *ele_begin = element_ptr(idx);
+
+			//Jump over the key
 			if (is_pair()) {
 				ele_begin += element_size(ele_begin);
-				for (T i=0 ; i < idx ; ++i) {
-					ele_begin += element_size(ele_begin);
-					ele_begin += element_size(ele_begin);
-				}
-			}
-			else { //is_array()
-				for (T i=0 ; i < idx ; ++i) {
-					ele_begin += element_size(ele_begin);
-				}
 			}
 
 			return CBOR(ele_begin, element_size(ele_begin), true);
@@ -938,18 +2193,11 @@ class CBOR
 		 */
 		template <typename T> CBOR key_at(T idx)
 		{
-			size_t n_elements = decode_abs_num(get_const_buffer_begin());
-			uint8_t *ele_begin = get_buffer_begin() + compute_type_num_len(n_elements);
-
-			if (!is_pair() || (idx > n_elements) || (idx < 0)) {
+			if (!is_pair() || (idx < 0) || ((size_t)idx >= n_elements())) {
 				return CBOR();
 			}
 
-			//Jump to the reffered key
-			for (T i=0 ; i < idx ; ++i) {
-				ele_begin += element_size(ele_begin);
-				ele_begin += element_size(ele_begin);
-			}
+			uint8_t *ele_begin = element_ptr(idx);
 
 			return CBOR(ele_begin, element_size(ele_begin), true);
 		}
@@ -971,37 +2219,101 @@ class CBOR
 		 */
 		template <typename T> CBOR find_by_key(T key)
 		{
+			YACL_PROFILE_SCOPE(CBOR_PROFILE_FIND_BY_KEY);
+
 			if (!is_pair()) {
 				return CBOR();
 			}
 
-			size_t n_elements = decode_abs_num(get_const_buffer_begin());
-			uint8_t *ele_begin = get_buffer_begin() + compute_type_num_len(n_elements);
-
 			CBOR idx_cbor = CBOR(key);
-			const uint8_t *idx_cbor_buffer = idx_cbor.to_CBOR();
-			size_t idx_cbor_size = idx_cbor.length();
 
-			//Search key until the end of the Pair (map) is found
-			for (size_t i=0 ; i < n_elements ; ++i) {
-				//If key match
-				if (buffer_equals(idx_cbor_buffer, idx_cbor_size,
-							ele_begin, element_size(ele_begin))) {
+			return find_by_encoded_key(idx_cbor.to_CBOR(), idx_cbor.length(), NULL, 0);
+		}
 
-					ele_begin += element_size(ele_begin);
+		//! Specialization of find_by_key() for strings, that does not build a temporary CBOR object.
+		CBOR find_by_key(const char* key);
 
-					return CBOR(ele_begin, element_size(ele_begin), true);
-				}
-				else {
-					//Key don't match, jump to next key
-					ele_begin += element_size(ele_begin);
-					ele_begin += element_size(ele_begin);
-				}
-			}
+		//! Find the values of several keys in a single scan of this CBOR PAIR.
+		/*!
+		 * Keys are given as CBOR objects, which can be encoded once and
+		 * reused for every message:
+		 * ```
+		 * static CBOR keys[] = {CBOR("id"), CBOR("temp"), CBOR(3)};
+		 * CBOR values[3];
+		 * msg.find_by_keys(keys, 3, values);
+		 * ```
+		 * The scan stops as soon as all the keys are found. If this CBOR
+		 * PAIR has a valid key index (see `build_key_index()`) or is sorted
+		 * (see `canonicalize()`), keys are looked up one by one instead.
+		 * As with `find_by_key()`, the first of duplicate keys wins, and
+		 * values are views on this object: no copy is performed.
+		 *
+		 * More than 32 keys are looked up in batches of 32, with one scan
+		 * per batch.
+		 *
+		 * \param keys The keys to look up.
+		 * \param n_keys Number of keys.
+		 * \param values Array of `n_keys` CBOR objects, set to the value of
+		 * each key, or to a CBOR NULL if the key cannot be found.
+		 * \return The number of keys found.
+		 */
+		size_t find_by_keys(const CBOR *keys, size_t n_keys, CBOR *values);
 
-			//Not found
-			return CBOR();
-		}
+		//! Build a hash table of the keys of this CBOR PAIR.
+		/*!
+		 * Once built, `find_by_key()` and `operator[]` run in constant expected
+		 * time instead of comparing every key of this CBOR PAIR. On small
+		 * dictionaries, or when looking up only a few keys, a linear search is
+		 * usually faster: the index pays off when most keys of a dictionary of
+		 * more than about 8 entries are looked up.
+		 *
+		 * The table can be supplied by the caller (e.g. a static array, see
+		 * `key_index_len()` for its recommended length), otherwise it is
+		 * allocated. Either way, a few words of bookkeeping are allocated
+		 * with the first index of this object. Keys appended after the table was built make it stale:
+		 * `find_by_key()` then falls back to a linear search until the index
+		 * is built again.
+		 *
+		 * \param table Caller-supplied table, or NULL to allocate one.
+		 * \param table_len Number of `size_t` slots in `table`. It must be
+		 * larger than the number of keys.
+		 * \return True if the index was built, false if this object is not a
+		 * CBOR PAIR, if `table` is too small or if allocation failed.
+		 */
+		bool build_key_index(size_t *table = NULL, size_t table_len = 0);
+
+		//! Free the hashed key index, if any.
+		/*!
+		 * Also forgets that this CBOR PAIR is sorted (see `canonicalize()`).
+		 */
+		void drop_key_index();
+
+		//! Make this CBOR object deterministically encoded (RFC 8949 §4.2).
+		/*!
+		 * The keys of every CBOR PAIR (including nested ones) are sorted in
+		 * bytewise lexicographic order of their encoding. Pairs are moved as
+		 * they are: nothing is re-encoded and the length does not change.
+		 *
+		 * YACL always encodes integers, lengths and tags on the shortest
+		 * form, and floats too in shortest mode (see
+		 * `set_shortest_float()`): this function fails if the data does not,
+		 * if it has indefinite-length items, or duplicate keys.
+		 *
+		 * Once sorted, `find_by_key()` uses a binary search over the element
+		 * index (built on first lookup, see `build_index()`), until elements
+		 * are added.
+		 *
+		 * \return True if this CBOR object is now deterministically encoded,
+		 * false otherwise (it may then be partially sorted).
+		 */
+		bool canonicalize();
+
+		//! Returns the recommended hashed key index length.
+		/*!
+		 * \param num_keys Number of keys in the CBOR PAIR.
+		 * \return The number of `size_t` slots to reserve for `build_key_index()`.
+		 */
+		static size_t key_index_len(size_t num_keys);
 
 		//! Returns the CBOR value associated with a particular key or index.
 		/*!
@@ -1018,6 +2330,8 @@ class CBOR
 		 */
 		template <typename T> CBOR operator[](T key)
 		{
+			YACL_PROFILE_SCOPE(CBOR_PROFILE_INDEX);
+
 			//Defaut implementation for non-numeric types
 			if (is_pair()) {
 				return find_by_key(key);
@@ -1044,5 +2358,154 @@ class CBOR
 #else
 		CBOR operator[](unsigned long key)	{ return access_op_numeric(key); };
 #endif
+
+		//! Forward iterator over the elements of a CBOR ARRAY, or the values of a CBOR PAIR.
+		/*!
+		 * The iterator keeps a cursor into the buffer, so that visiting all
+		 * the elements of a composed CBOR object costs one `element_size()`
+		 * per element. As with `at()`, no copy is performed: dereferencing
+		 * yields a CBOR object pointing into this object's buffer.
+		 */
+		class iterator
+		{
+			friend class CBOR;
+
+			protected:
+				//! Pointer on the current element (or key, for a CBOR PAIR).
+				uint8_t *ptr;
+				//! Number of elements left, including the current one.
+				size_t remaining;
+				//! True if iterating over a CBOR PAIR.
+				bool pair;
+				//! Size of the current key, or 0 if not computed yet.
+				mutable size_t key_size = 0;
+				//! Size of the current element (or value), or 0 if not computed yet.
+				mutable size_t ele_size = 0;
+
+				iterator(uint8_t *_ptr, size_t _remaining, bool _pair)
+					: ptr(_ptr), remaining(_remaining), pair(_pair) {};
+
+				//! Returns a pointer on the current element (or value), computing the key size if needed.
+				uint8_t* value_ptr() const
+				{
+					if (pair && (key_size == 0)) {
+						key_size = element_size(ptr);
+					}
+
+					return ptr + key_size;
+				}
+
+				//! Returns the size of the current element (or value), computing it if needed.
+				size_t value_size() const
+				{
+					if (ele_size == 0) {
+						ele_size = element_size(value_ptr());
+					}
+
+					return ele_size;
+				}
+
+			public:
+				//! Returns the current element (or value, for a CBOR PAIR).
+				CBOR operator*() const { return CBOR(value_ptr(), value_size(), true); }
+
+				//! Returns the current key. Use for CBOR PAIR.
+				CBOR key() const
+				{
+					value_ptr();
+					return CBOR(ptr, key_size, true);
+				}
+
+				//! Returns the current value (same as `operator*`).
+				CBOR value() const { return **this; }
+
+				//! Jump to the next element.
+				iterator& operator++()
+				{
+					ptr = value_ptr() + value_size();
+					key_size = 0;
+					ele_size = 0;
+					--remaining;
+
+					return *this;
+				}
+
+				bool operator==(const iterator &other) const { return remaining == other.remaining; }
+				bool operator!=(const iterator &other) const { return remaining != other.remaining; }
+		};
+
+		//! Iterator over the key/value pairs of a CBOR PAIR.
+		/*!
+		 * Dereferencing yields the iterator itself, so that keys and values
+		 * are accessed with `key()` and `value()`.
+		 */
+		class pair_iterator: public iterator
+		{
+			friend class CBOR;
+
+			protected:
+				pair_iterator(uint8_t *_ptr, size_t _remaining)
+					: iterator(_ptr, _remaining, true) {};
+
+			public:
+				const pair_iterator& operator*() const { return *this; }
+
+				pair_iterator& operator++()
+				{
+					iterator::operator++();
+					return *this;
+				}
+		};
+
+		//! Range of key/value pairs of a CBOR PAIR, see `pairs()`.
+		class pair_range
+		{
+			friend class CBOR;
+
+			protected:
+				pair_iterator first, last;
+
+				pair_range(const pair_iterator &_first, const pair_iterator &_last)
+					: first(_first), last(_last) {};
+
+			public:
+				pair_iterator begin() const { return first; }
+				pair_iterator end() const { return last; }
+		};
+
+		//! Returns an iterator on the first element of a CBOR ARRAY (or value of a CBOR PAIR).
+		/*!
+		 * Allows range-based for loops:
+		 * `for (CBOR ele : cbor_arr) { ... }`
+		 * If this object is neither a CBOR ARRAY nor a CBOR PAIR,
+		 * `begin() == end()`.
+		 */
+		iterator begin()
+		{
+			if (!is_array() && !is_pair()) {
+				return end();
+			}
+
+			return iterator(data_begin(), n_elements(), is_pair());
+		}
+
+		//! Returns the past-the-end iterator.
+		iterator end() { return iterator(NULL, 0, is_pair()); }
+
+		//! Returns the range of key/value pairs of a CBOR PAIR.
+		/*!
+		 * Allows range-based for loops:
+		 * `for (const CBOR::pair_iterator &it : cbor_pair.pairs()) { it.key(); it.value(); }`
+		 * If this object is not a CBOR PAIR, the range is empty.
+		 */
+		pair_range pairs()
+		{
+			if (!is_pair()) {
+				return pair_range(pair_iterator(NULL, 0), pair_iterator(NULL, 0));
+			}
+
+			return pair_range(pair_iterator(data_begin(), n_elements()),
+					pair_iterator(NULL, 0));
+		}
 };
 #endif
@@ -0,0 +1,113 @@
+#include "CBORAllocator.h"
+
+static CBORHeapAllocator heap_allocator;
+static CBORAllocator *default_allocator = &heap_allocator;
+
+//! Round a length up to a multiple of CBOR_ALLOC_ALIGN.
+static size_t align_len(size_t len)
+{
+	return (len + CBOR_ALLOC_ALIGN - 1) & ~(size_t)(CBOR_ALLOC_ALIGN - 1);
+}
+
+CBORAllocator* CBORAllocator::get_default()
+{
+	return default_allocator;
+}
+
+void CBORAllocator::set_default(CBORAllocator *allocator)
+{
+	default_allocator = (allocator != NULL)?allocator:&heap_allocator;
+}
+
+void* CBORArenaAllocator::allocate(size_t len)
+{
+	len = align_len(len);
+	if (len > (size_t)(end - top)) {
+		return NULL;
+	}
+
+	last = top;
+	top += len;
+
+	return last;
+}
+
+void* CBORArenaAllocator::reallocate(void *ptr, size_t old_len, size_t new_len)
+{
+	if (ptr == NULL) {
+		return allocate(new_len);
+	}
+
+	//Last block: grow or shrink in place
+	if (ptr == last) {
+		if (align_len(new_len) > (size_t)(end - last)) {
+			return NULL;
+		}
+
+		top = last + align_len(new_len);
+		return ptr;
+	}
+
+	if (new_len <= old_len) {
+		return ptr;
+	}
+
+	void *new_ptr = allocate(new_len);
+	if (new_ptr != NULL) {
+		memcpy(new_ptr, ptr, old_len);
+	}
+
+	return new_ptr;
+}
+
+void CBORArenaAllocator::deallocate(void *ptr, size_t)
+{
+	//Only the last block can be given back before reset()
+	if ((ptr != NULL) && (ptr == last)) {
+		top = last;
+		last = NULL;
+	}
+}
+
+CBORPoolAllocator::CBORPoolAllocator(uint8_t *buffer, size_t buffer_len, size_t _block_size)
+{
+	block_size = align_len((_block_size < sizeof(uint8_t*))?sizeof(uint8_t*):_block_size);
+
+	//Chain every block into the free list
+	for (size_t i=0 ; (i + 1)*block_size <= buffer_len ; ++i) {
+		deallocate(buffer + i*block_size, block_size);
+	}
+}
+
+void* CBORPoolAllocator::allocate(size_t len)
+{
+	if ((len > block_size) || (free_list == NULL)) {
+		return NULL;
+	}
+
+	uint8_t *block = free_list;
+	memcpy(&free_list, block, sizeof(uint8_t*));
+	--n_free;
+
+	return block;
+}
+
+void* CBORPoolAllocator::reallocate(void *ptr, size_t, size_t new_len)
+{
+	if (ptr == NULL) {
+		return allocate(new_len);
+	}
+
+	return (new_len <= block_size)?ptr:NULL;
+}
+
+void CBORPoolAllocator::deallocate(void *ptr, size_t)
+{
+	if (ptr == NULL) {
+		return;
+	}
+
+	memcpy(ptr, &free_list, sizeof(uint8_t*));
+	free_list = (uint8_t*)ptr;
+	++n_free;
+}
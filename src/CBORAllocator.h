@@ -0,0 +1,143 @@
+#ifndef INCLUDED_CBORALLOCATOR_H
+#define INCLUDED_CBORALLOCATOR_H
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+//! Alignment (in bytes) of the blocks returned by YACL allocators.
+#define CBOR_ALLOC_ALIGN sizeof(size_t)
+
+//! Interface of the memory allocators used by CBOR objects.
+/*!
+ * Every dynamically allocated buffer of a CBOR object (data buffer, element
+ * and key indexes) is obtained from, and given back to, its allocator.
+ * The allocator must outlive all the CBOR objects using it.
+ */
+class CBORAllocator
+{
+	public:
+		//! Destructor (allocators are meant to be subclassed).
+		virtual ~CBORAllocator() {}
+
+		//! Allocate a block of memory.
+		/*!
+		 * \param len Size (in bytes) of the block.
+		 * \return Pointer to the allocated block, or NULL if allocation failed.
+		 */
+		virtual void* allocate(size_t len) = 0;
+
+		//! Resize a block of memory, preserving its content.
+		/*!
+		 * \param ptr Pointer to the block, or NULL to allocate a new one.
+		 * \param old_len Current size (in bytes) of the block.
+		 * \param new_len Requested size (in bytes) of the block.
+		 * \return Pointer to the resized block, or NULL if reallocation
+		 * failed (in this case, the original block is left untouched).
+		 */
+		virtual void* reallocate(void *ptr, size_t old_len, size_t new_len) = 0;
+
+		//! Free a block of memory.
+		/*!
+		 * \param ptr Pointer to the block (NULL is ignored).
+		 * \param len Size (in bytes) of the block.
+		 */
+		virtual void deallocate(void *ptr, size_t len) = 0;
+
+		//! Get the default allocator.
+		/*!
+		 * \return The allocator used by CBOR objects constructed without an
+		 * explicit allocator (a `CBORHeapAllocator`, unless changed with
+		 * `set_default()`).
+		 */
+		static CBORAllocator* get_default();
+
+		//! Change the default allocator.
+		/*!
+		 * Only affects CBOR objects constructed afterwards.
+		 *
+		 * \param allocator The new default allocator, or NULL to restore the
+		 * general heap allocator.
+		 */
+		static void set_default(CBORAllocator *allocator);
+};
+
+//! Allocator using the general heap (malloc/realloc/free).
+class CBORHeapAllocator: public CBORAllocator
+{
+	public:
+		void* allocate(size_t len) { return malloc(len); }
+		void* reallocate(void *ptr, size_t, size_t new_len) { return realloc(ptr, new_len); }
+		void deallocate(void *ptr, size_t) { free(ptr); }
+};
+
+//! Bump-pointer allocator over a caller-supplied buffer.
+/*!
+ * Allocation only moves a pointer forward, and memory is given back all at
+ * once with `reset()`, typically after each message. Only the last allocated
+ * block can be grown in place or freed individually.
+ */
+class CBORArenaAllocator: public CBORAllocator
+{
+	protected:
+		uint8_t *begin, *end, *top;
+		//! Begining of the last allocated block.
+		uint8_t *last = NULL;
+
+	public:
+		//! Construct an arena allocator.
+		/*!
+		 * \param buffer Pointer to the beginning of the arena (should be
+		 * aligned on `CBOR_ALLOC_ALIGN` bytes).
+		 * \param buffer_len Size (in bytes) of the arena.
+		 */
+		CBORArenaAllocator(uint8_t *buffer, size_t buffer_len)
+			: begin(buffer), end(buffer + buffer_len), top(buffer) {};
+
+		void* allocate(size_t len);
+		void* reallocate(void *ptr, size_t old_len, size_t new_len);
+		void deallocate(void *ptr, size_t len);
+
+		//! Free every block allocated so far.
+		void reset() { top = begin; last = NULL; }
+
+		//! Get the number of bytes currently allocated in the arena.
+		size_t used() const { return (size_t)(top - begin); }
+
+		//! Get the number of bytes still available in the arena.
+		size_t available() const { return (size_t)(end - top); }
+};
+
+//! Fixed-size block allocator over a caller-supplied buffer.
+/*!
+ * The buffer is split into blocks of `block_size` bytes. Allocations larger
+ * than a block fail, and growing a block is free as long as it fits.
+ */
+class CBORPoolAllocator: public CBORAllocator
+{
+	protected:
+		size_t block_size;
+		//! First free block (each free block stores a pointer to the next one).
+		uint8_t *free_list = NULL;
+		//! Number of free blocks.
+		size_t n_free = 0;
+
+	public:
+		//! Construct a pool allocator.
+		/*!
+		 * \param buffer Pointer to the beginning of the pool.
+		 * \param buffer_len Size (in bytes) of the pool.
+		 * \param _block_size Size (in bytes) of each block. It is rounded up
+		 * to a multiple of `CBOR_ALLOC_ALIGN`.
+		 */
+		CBORPoolAllocator(uint8_t *buffer, size_t buffer_len, size_t _block_size);
+
+		void* allocate(size_t len);
+		void* reallocate(void *ptr, size_t old_len, size_t new_len);
+		void deallocate(void *ptr, size_t len);
+
+		//! Get the number of free blocks.
+		size_t available() const { return n_free; }
+};
+
+#endif
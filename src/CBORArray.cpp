@@ -1,12 +1,18 @@
 #include "CBORArray.h"
 
 CBORArray::CBORArray(uint8_t* _buffer, size_t buffer_len, bool has_data)
+	: CBORComposed(_buffer, buffer_len)
 {
-	max_buf_len = buffer_len;
-	buffer_type = BUFFER_EXTERNAL;
+	if (has_data && ((_buffer[0] & CBOR_INFO_BITS) == CBOR_VAR_FOLLOWS)) {
+		buffer_begin = _buffer;
+		buffer_data_begin = buffer_begin + 1;
+		indefinite = true;
+		has_break = true;
 
-	if (has_data) {
-		ext_buffer_begin = _buffer;
+		//Jump to the end of the data chunk, after the break
+		w_ptr = buffer_begin + element_size(buffer_begin);
+	}
+	else if (has_data) {
 		buffer_begin = _buffer;
 
 		buffer_data_begin = buffer_begin + compute_type_num_len(n_elements());
@@ -19,7 +25,6 @@ CBORArray::CBORArray(uint8_t* _buffer, size_t buffer_len, bool has_data)
 	}
 	else {
 		//Reserve begining of buffer to store table length
-		ext_buffer_begin = _buffer;
 		buffer_data_begin = _buffer + NUM_ELE_PROVISION;
 		buffer_begin = _buffer + NUM_ELE_PROVISION - 1; //type_num_len is 1 for array size 0
 		w_ptr = buffer_data_begin;
@@ -30,17 +35,31 @@ CBORArray::CBORArray(uint8_t* _buffer, size_t buffer_len, bool has_data)
 }
 
 CBORArray::CBORArray(const uint8_t* _buffer, size_t buf_len)
+	: CBORArray(_buffer, buf_len, *CBORAllocator::get_default())
 {
-	size_t _num_ele = decode_abs_num(_buffer);
+}
+
+CBORArray::CBORArray(const uint8_t* _buffer, size_t buf_len, CBORAllocator &_allocator)
+	: CBORComposed(buf_len, _allocator)
+{
+	if ((_buffer[0] & CBOR_INFO_BITS) == CBOR_VAR_FOLLOWS) {
+		//Keep the indefinite-length header and the break
+		begin_indefinite();
+		has_break = true;
+		memcpy(buffer_begin, _buffer, buf_len);
+		YACL_STAT(bytes_copied, buf_len);
+		w_ptr = buffer_begin + element_size(buffer_begin);
 
-	//Init buffer
-	max_buf_len = buf_len + NUM_ELE_PROVISION;
-	init_buffer();
+		return;
+	}
+
+	size_t _num_ele = decode_abs_num(_buffer);
 
 	//Initialize number of elements, and copy data
 	init_num_ele(_num_ele);
 	memcpy(w_ptr, _buffer + compute_type_num_len(_num_ele),
 			buf_len - compute_type_num_len(_num_ele));
+	YACL_STAT(bytes_copied, buf_len - compute_type_num_len(_num_ele));
 
 	//Jump to the end of the data chunk
 	for (size_t i=0 ;  i < n_elements() ; ++i) {
@@ -50,6 +69,8 @@ CBORArray::CBORArray(const uint8_t* _buffer, size_t buf_len)
 
 bool CBORArray::append()
 {
+	YACL_PROFILE_SCOPE(CBOR_PROFILE_APPEND);
+
 	increment_num_ele();
 	return add();
 }
@@ -9,6 +9,32 @@
  */
 class CBORArray: public CBORComposed<CBOR_ARRAY>
 {
+	protected:
+		//! Add integers (except `bool`), encoded in bulk.
+		template <typename T> auto add_elements(const T *array, size_t size, int)
+			-> decltype((T)0 & 0, bool())
+		{
+			return add_int_array((const uint8_t*)array, size, sizeof(T), (T)(-1) < (T)0);
+		}
+
+		//! Add elements of other types, one at a time.
+		template <typename T> bool add_elements(const T *array, size_t size, long)
+		{
+			bool ret_val = true;
+
+			for (const T *ptr = array ; ptr < (array+size) ; ++ptr) {
+				ret_val &= add(*ptr);
+			}
+
+			return ret_val;
+		}
+
+		//! Add booleans, one at a time (they are not integers in CBOR).
+		bool add_elements(const bool *array, size_t size, int)
+		{
+			return add_elements(array, size, 0L);
+		}
+
 	public:
 		/*!
 		 * Construct a CBOR ARRAY with a DYNAMIC_INTERNAL buffer, big
@@ -24,9 +50,50 @@ class CBORArray: public CBORComposed<CBOR_ARRAY>
 		 */
 		CBORArray(size_t buf_len) : CBORComposed(buf_len) {};
 
+		//! Construct a CBOR ARRAY with a DYNAMIC_INTERNAL buffer, using a custom allocator.
+		/*!
+		 * \param _allocator The allocator of the buffer.
+		 */
+		CBORArray(CBORAllocator &_allocator) : CBORComposed(1, _allocator) {};
+
+		//! Construct a CBOR ARRAY with a custom length DYNAMIC_INTERNAL buffer, using a custom allocator.
+		/*!
+		 * \param buf_len Buffer size, in bytes, of the data section of the buffer.
+		 * \param _allocator The allocator of the buffer.
+		 */
+		CBORArray(size_t buf_len, CBORAllocator &_allocator) : CBORComposed(buf_len, _allocator) {};
+
 		//! Copy constructor.
 		CBORArray(const CBORArray &obj) : CBORComposed(obj) {};
 
+		//! Move constructor.
+		/*!
+		 * Takes over the buffer of `obj` without copying it. `obj` can then
+		 * only be destroyed or assigned to.
+		 */
+		CBORArray(CBORArray &&obj) : CBORComposed(static_cast<CBORComposed&&>(obj)) {};
+
+		//! Copy assignment operator.
+		/*!
+		 * The copy is allocated with the allocator of this object.
+		 */
+		CBORArray& operator=(const CBORArray &obj)
+		{
+			CBORComposed::operator=(obj);
+			return *this;
+		}
+
+		//! Move assignment operator.
+		/*!
+		 * Takes over the buffer (and allocator) of `obj` without copying it.
+		 * `obj` can then only be destroyed or assigned to.
+		 */
+		CBORArray& operator=(CBORArray &&obj)
+		{
+			CBORComposed::operator=(static_cast<CBORComposed&&>(obj));
+			return *this;
+		}
+
 		//! Construct a CBOR array using an external buffer.
 		/*!
 		 * If has_data == true, then new elements can be added.
@@ -47,6 +114,14 @@ class CBORArray: public CBORComposed<CBOR_ARRAY>
 		 */
 		CBORArray(const uint8_t* _buffer, size_t buf_len);
 
+		//! Parse and create a CBOR ARRAY from a byte array of CBOR data, using a custom allocator.
+		/*!
+		 * \param buffer Pointer to the beginning of the array.
+		 * \param buffer_len Size (in bytes) of the array.
+		 * \param _allocator The allocator of the copy.
+		 */
+		CBORArray(const uint8_t* _buffer, size_t buf_len, CBORAllocator &_allocator);
+
 		//! Appends CBOR NULL to the end of this CBOR ARRAY.
 		/*!
 		 * \return True if the operation was successful, false otherwise.
@@ -60,6 +135,8 @@ class CBORArray: public CBORComposed<CBOR_ARRAY>
 		 */
 		template <typename T> bool append(T value)
 		{
+			YACL_PROFILE_SCOPE(CBOR_PROFILE_APPEND);
+
 			increment_num_ele();
 			return add(value);
 		}
@@ -73,14 +150,29 @@ class CBORArray: public CBORComposed<CBOR_ARRAY>
 		 */
 		template <typename T> bool append(const T *array, size_t size)
 		{
-			bool ret_val = true;
+			YACL_PROFILE_SCOPE(CBOR_PROFILE_APPEND);
 
-			init_num_ele(n_elements() + size);
-			for (const T *ptr = array ; ptr < (array+size) ; ++ptr) {
-				ret_val &= add(*ptr);
-			}
+			add_num_ele(size);
+			return add_elements(array, size, 0);
+		}
 
-			return ret_val;
+		//! Appends an RFC 8746 typed array to the end of this CBOR ARRAY.
+		/*!
+		 * The elements are encoded as a single byte string, instead of one
+		 * CBOR element each (see `CBOR::encode_typed_array()`).
+		 *
+		 * \param values Pointer to the elements.
+		 * \param num_ele Number of elements.
+		 * \param big_endian True to encode big-endian elements, false for
+		 * little-endian (defaults to the native byte order).
+		 * \return True if the operation was successful, false otherwise.
+		 */
+		template <typename T> bool append_typed_array(const T *values, size_t num_ele,
+				bool big_endian = CBOR_BIG_ENDIAN)
+		{
+			increment_num_ele();
+			return add_typed_array((const uint8_t*)values, num_ele, sizeof(T),
+					typed_array_tag<T>(big_endian), (sizeof(T) > 1) && (big_endian != CBOR_BIG_ENDIAN));
 		}
 };
 
@@ -34,6 +34,11 @@ template <uint8_t cbor_type> class CBORComposed: public CBOR
 		 */
 		uint8_t *ext_buffer_begin, *buffer_data_begin;
 
+		//! True if the length field is an indefinite-length header.
+		bool indefinite = false;
+		//! True if the break closing an indefinite-length object was appended.
+		bool has_break = false;
+
 		//! Encodes a number of elements.
 		/*!
 		 * Encodes the number of elements, and makes the necessary changes in
@@ -52,6 +57,8 @@ template <uint8_t cbor_type> class CBORComposed: public CBOR
 			w_ptr = buffer_data_begin - compute_type_num_len(num_ele);
 			//Update buffer_begin
 			buffer_begin = w_ptr;
+			//Make sure the length field is readable while encoding it
+			*buffer_begin = cbor_type;
 		
 			//Encode num_ele
 			encode_type_num(cbor_type, num_ele);
@@ -62,8 +69,29 @@ template <uint8_t cbor_type> class CBORComposed: public CBOR
 			return;
 		}
 
+		//! Increase the number of elements.
+		/*!
+		 * An indefinite-length object has no count to update: its break,
+		 * if any, is removed so that the new elements are written before
+		 * the next one.
+		 *
+		 * \param num_ele The number of elements to add.
+		 */
+		void add_num_ele(size_t num_ele)
+		{
+			if (indefinite) {
+				if (has_break) {
+					--w_ptr;
+					has_break = false;
+				}
+				return;
+			}
+
+			init_num_ele(n_elements() + num_ele);
+		}
+
 		//! Increment the number of elements by one.
-		void increment_num_ele() { init_num_ele(n_elements()+1); };
+		void increment_num_ele() { add_num_ele(1); };
 
 		/*!
 		 * Initialize a dynamically allocated internal buffer, with size
@@ -76,7 +104,9 @@ template <uint8_t cbor_type> class CBORComposed: public CBOR
 		bool init_buffer()
 		{
 			//Reserve begining of buffer to store table length
-			ext_buffer_begin = (uint8_t*)malloc(sizeof(uint8_t)*max_buf_len);
+			YACL_STAT(allocations, 1);
+			YACL_STAT(bytes_allocated, max_buf_len);
+			ext_buffer_begin = (uint8_t*)allocator->allocate(sizeof(uint8_t)*max_buf_len);
 			if (ext_buffer_begin == NULL) {
 				buffer_data_begin = NULL;
 				buffer_begin = NULL;
@@ -123,26 +153,187 @@ template <uint8_t cbor_type> class CBORComposed: public CBOR
 			init_num_ele(0);
 		}
 
-		//! Copy constructor.
-		CBORComposed(const CBORComposed &obj) : CBOR()
+		//! Construct a composed CBOR object with a custom allocator.
+		/*!
+		 * The total length of the alocated buffer is `buf_len + NUM_ELE_PROVISION`.
+		 *
+		 * \param buf_len Buffer size, in bytes, of the data section of the buffer.
+		 * \param _allocator The allocator of the buffer.
+		 */
+		CBORComposed(size_t buf_len, CBORAllocator &_allocator)
 		{
-			uint8_t type_num_len = compute_type_num_len(obj.n_elements());
-			//Reserve buf_len plus maximum size of a type_num : 9 bytes to encode a
-			//table length up to (2^64)-1
-			size_t buf_len_needed = obj.length() - type_num_len + NUM_ELE_PROVISION;
+			allocator = &_allocator;
 
 			//Reserve buffer
-			max_buf_len = buf_len_needed;
+			max_buf_len = buf_len + NUM_ELE_PROVISION;
 			init_buffer();
 
 			//Initialize num_ele
-			init_num_ele(obj.n_elements());
+			init_num_ele(0);
+		}
+
+		//! Construct a composed CBOR object on an external buffer.
+		/*!
+		 * Nothing is allocated: the caller is in charge of setting
+		 * `buffer_begin`, `buffer_data_begin` and `w_ptr`.
+		 *
+		 * \param _buffer Pointer to the beginning of the external buffer.
+		 * \param buf_len Size (in bytes) of the external buffer.
+		 */
+		CBORComposed(uint8_t *_buffer, size_t buf_len)
+		{
+			max_buf_len = buf_len;
+			buffer_type = BUFFER_EXTERNAL;
+			ext_buffer_begin = _buffer;
+		}
+
+		//! Copy the CBOR data of another composed CBOR object.
+		/*!
+		 * A new DYNAMIC_INTERNAL buffer is allocated with `allocator`: the
+		 * current buffer must have been released (or saved) first.
+		 *
+		 * \param obj The composed CBOR object to copy.
+		 * \return False if allocation failed: this object is then left
+		 * with an empty EXTERNAL buffer, as after a move.
+		 */
+		bool copy_composed(const CBORComposed &obj)
+		{
+			size_t head_len = obj.buffer_data_begin - obj.buffer_begin;
+			//Reserve buf_len plus maximum size of a type_num : 9 bytes to encode a
+			//table length up to (2^64)-1
+			size_t buf_len_needed = obj.length() - head_len + NUM_ELE_PROVISION;
+
+			//Reserve buffer
+			max_buf_len = buf_len_needed;
+			if (!init_buffer()) {
+				buffer_type = BUFFER_EXTERNAL;
+				max_buf_len = 0;
+				return false;
+			}
 
-			//Copy data
-			memcpy(buffer_data_begin, obj.to_CBOR() + type_num_len, obj.length() - type_num_len);
+			//Copy length field and data
+			buffer_begin = buffer_data_begin - head_len;
+			memcpy(buffer_begin, obj.to_CBOR(), obj.length());
+			YACL_STAT(bytes_copied, obj.length());
+			indefinite = obj.indefinite;
+			has_break = obj.has_break;
 
 			//Jump to the end of the data chunk
 			w_ptr = buffer_begin + obj.length();
+
+			return true;
+		}
+
+		//! Take over the buffer of another composed CBOR object.
+		/*!
+		 * The current buffer must have been released first. `obj` is left
+		 * with an empty EXTERNAL buffer: it can only be destroyed or
+		 * assigned to.
+		 *
+		 * \param obj The composed CBOR object to take the buffer from.
+		 */
+		void move_composed(CBORComposed &obj)
+		{
+			move_buffer(obj);
+			ext_buffer_begin = obj.ext_buffer_begin;
+			buffer_data_begin = obj.buffer_data_begin;
+			indefinite = obj.indefinite;
+			has_break = obj.has_break;
+
+			obj.buffer_type = BUFFER_EXTERNAL;
+			obj.max_buf_len = 0;
+			obj.ext_buffer_begin = NULL;
+			obj.buffer_data_begin = NULL;
+			obj.buffer_begin = NULL;
+			obj.w_ptr = NULL;
+		}
+
+		//! The header is stored after `ext_buffer_begin`: only `move_composed()` can take the buffer over.
+		bool has_movable_buffer() const { return false; }
+
+		//! Copy constructor.
+		/*!
+		 * If the buffer cannot be allocated, this object is left empty, as
+		 * after a move (`length()` is 0): it can only be destroyed or
+		 * assigned to.
+		 */
+		CBORComposed(const CBORComposed &obj) : CBOR()
+		{
+			allocator = obj.allocator;
+			copy_composed(obj);
+		}
+
+		//! Move constructor.
+		CBORComposed(CBORComposed &&obj) : CBOR()
+		{
+			move_composed(obj);
+		}
+
+		//! Copy assignment operator.
+		/*!
+		 * If the buffer cannot be allocated, this object is left unchanged.
+		 */
+		CBORComposed& operator=(const CBORComposed &obj)
+		{
+			if (this != &obj) {
+				//obj may be a view on the buffer of this object: copy it
+				//before freeing the buffer
+				uint8_t *old_buffer = ext_buffer_begin;
+				uint8_t *old_begin = buffer_begin;
+				uint8_t *old_data_begin = buffer_data_begin;
+				uint8_t *old_w_ptr = w_ptr;
+				size_t old_len = max_buf_len;
+				uint8_t old_type = buffer_type;
+				bool old_indefinite = indefinite;
+				bool old_has_break = has_break;
+				bool old_owned = (buffer_type == BUFFER_DYNAMIC_INTERNAL);
+
+				if (!copy_composed(obj)) {
+					//Not enough memory: keep the current content
+					ext_buffer_begin = old_buffer;
+					buffer_begin = old_begin;
+					buffer_data_begin = old_data_begin;
+					w_ptr = old_w_ptr;
+					max_buf_len = old_len;
+					buffer_type = old_type;
+					indefinite = old_indefinite;
+					has_break = old_has_break;
+
+					return *this;
+				}
+				drop_index();
+				drop_key_index();
+
+				if (old_owned) {
+					YACL_STAT(deallocations, 1);
+					allocator->deallocate(old_buffer, old_len);
+				}
+			}
+
+			return *this;
+		}
+
+		//! Move assignment operator.
+		CBORComposed& operator=(CBORComposed &&obj)
+		{
+			if (owns_data(obj.to_CBOR())) {
+				//obj is a view on the buffer of this object
+				return operator=((const CBORComposed&)obj);
+			}
+
+			if (this != &obj) {
+				if (buffer_type == BUFFER_DYNAMIC_INTERNAL) {
+					YACL_STAT(deallocations, 1);
+					allocator->deallocate(ext_buffer_begin, max_buf_len);
+				}
+				drop_index();
+				drop_key_index();
+				free_indexes();
+
+				move_composed(obj);
+			}
+
+			return *this;
 		}
 
 	public:
@@ -150,7 +341,8 @@ template <uint8_t cbor_type> class CBORComposed: public CBOR
 		~CBORComposed()
 		{
 			if(buffer_type == BUFFER_DYNAMIC_INTERNAL) {
-				free(ext_buffer_begin);
+				YACL_STAT(deallocations, 1);
+				allocator->deallocate(ext_buffer_begin, max_buf_len);
 				buffer_begin = NULL;
 			}
 		}
@@ -167,8 +359,10 @@ template <uint8_t cbor_type> class CBORComposed: public CBOR
 		 */
 		bool reserve(size_t len)
 		{
-			size_t num_ele = n_elements();
-			size_t requested_len = len - compute_type_num_len(num_ele) + NUM_ELE_PROVISION;
+			//Measured from the current start of the object: while init_num_ele()
+			//encodes a longer length field, it does not match num_ele yet
+			size_t begin_offset = buffer_begin - ext_buffer_begin;
+			size_t requested_len = begin_offset + len;
 
 			if (requested_len <= max_buf_len) {
 				return true;
@@ -176,17 +370,28 @@ template <uint8_t cbor_type> class CBORComposed: public CBOR
 
 			if (buffer_type == BUFFER_DYNAMIC_INTERNAL) {
 				size_t length_saved = length();
+				size_t new_len = grow_len(max_buf_len, requested_len);
 
-				ext_buffer_begin = (uint8_t*)realloc(ext_buffer_begin,
-						sizeof(uint8_t)*requested_len);
-				if (ext_buffer_begin == NULL) {
+				YACL_STAT(reallocations, 1);
+				uint8_t *new_buffer = (uint8_t*)allocator->reallocate(ext_buffer_begin,
+						max_buf_len, sizeof(uint8_t)*new_len);
+				if ((new_buffer == NULL) && (new_len > requested_len)) {
+					//Not enough memory to grow: try the exact requested length
+					new_len = requested_len;
+					YACL_STAT(reallocations, 1);
+					new_buffer = (uint8_t*)allocator->reallocate(ext_buffer_begin,
+							max_buf_len, sizeof(uint8_t)*new_len);
+				}
+				if (new_buffer == NULL) {
 					return false;
 				}
+				YACL_STAT(bytes_allocated, new_len - max_buf_len);
 
 				//Update max buffer length and write pointer
-				max_buf_len = requested_len;
+				ext_buffer_begin = new_buffer;
+				max_buf_len = new_len;
 				buffer_data_begin = ext_buffer_begin + NUM_ELE_PROVISION;
-				buffer_begin = buffer_data_begin - compute_type_num_len(num_ele);
+				buffer_begin = ext_buffer_begin + begin_offset;
 				w_ptr = buffer_begin + length_saved;
 
 				return true;
@@ -196,6 +401,97 @@ template <uint8_t cbor_type> class CBORComposed: public CBOR
 			return false;
 		}
 
+		//! Get the capacity of this composed CBOR object.
+		/*!
+		 * \return The maximum length this CBOR message can reach without
+		 * reallocating its buffer.
+		 */
+		size_t capacity() const
+		{
+			return max_buf_len - (buffer_begin - ext_buffer_begin);
+		}
+
+		//! Release unused memory.
+		/*!
+		 * If buffer is DYNAMIC_INTERNAL, reallocate it to the current length
+		 * of this CBOR message (plus the provision for the number of
+		 * elements). Otherwise, do nothing.
+		 *
+		 * \return False if reallocation failed, true otherwise.
+		 */
+		bool shrink_to_fit()
+		{
+			if (buffer_type != BUFFER_DYNAMIC_INTERNAL) {
+				return true;
+			}
+
+			size_t head_len = buffer_data_begin - buffer_begin;
+			size_t length_saved = length();
+			size_t new_len = length_saved - head_len + NUM_ELE_PROVISION;
+
+			if (new_len == max_buf_len) {
+				return true;
+			}
+
+			YACL_STAT(reallocations, 1);
+			uint8_t *new_buffer = (uint8_t*)allocator->reallocate(ext_buffer_begin,
+					max_buf_len, sizeof(uint8_t)*new_len);
+			if (new_buffer == NULL) {
+				return false;
+			}
+
+			ext_buffer_begin = new_buffer;
+			max_buf_len = new_len;
+			buffer_data_begin = ext_buffer_begin + NUM_ELE_PROVISION;
+			buffer_begin = buffer_data_begin - head_len;
+			w_ptr = buffer_begin + length_saved;
+
+			return true;
+		}
+
+		//! Switch this composed CBOR object to indefinite-length encoding.
+		/*!
+		 * The length field is replaced by an indefinite-length header, which
+		 * is not updated anymore when elements are appended: call
+		 * `end_indefinite()` once all the elements are appended. Elements
+		 * already appended are kept.
+		 */
+		void begin_indefinite()
+		{
+			if (!indefinite) {
+				buffer_begin = buffer_data_begin - 1;
+				*buffer_begin = cbor_type | CBOR_VAR_FOLLOWS;
+				indefinite = true;
+			}
+		}
+
+		//! Append the break closing an indefinite-length composed CBOR object.
+		/*!
+		 * This object is a valid CBOR object again. Elements appended
+		 * afterwards are written before the break, which must then be
+		 * appended again with `end_indefinite()`.
+		 *
+		 * \return False if this object is not indefinite-length, or if the
+		 * break could not be appended. True otherwise.
+		 */
+		bool end_indefinite()
+		{
+			if (!indefinite) {
+				return false;
+			}
+			if (has_break) {
+				return true;
+			}
+
+			if (!reserve(length() + 1)) {
+				return false;
+			}
+			*(w_ptr++) = CBOR_BREAK;
+			has_break = true;
+
+			return true;
+		}
+
 		//! Get the maximum number of elements that can fit in this composed CBOR object.
 		/*!
 		 * \return The maximum number of elements that can fit in this composed
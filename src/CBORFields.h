@@ -0,0 +1,136 @@
+#ifndef INCLUDED_CBORFIELDS_H
+#define INCLUDED_CBORFIELDS_H
+
+#include "CBOR.h"
+
+//! Field table of a struct, declared with `YACL_FIELDS()`.
+/*!
+ * A specialization provides:
+ * - `num_fields`, the number of fields;
+ * - `visit(obj, visitor)`, which calls `visitor(idx, "field", obj.field)`
+ *   for each field, in declaration order;
+ * - `visit_field(obj, idx, visitor)`, which does the same for the field
+ *   number `idx` only;
+ * - `field_name(idx)`, which returns the name of the field number `idx`;
+ * - `field_names()`, which returns the array of the names of the fields.
+ *
+ * \tparam S The struct type.
+ */
+template <typename S> struct CBORFields;
+
+//! Declare the fields of a struct, to encode it as (and decode it from) a CBOR PAIR.
+/*!
+ * Must be used at global scope, after the definition of the struct. Fields
+ * are encoded with their name as key (up to 32 fields):
+ * ```
+ * struct Reading {
+ * 	int id;
+ * 	float temp;
+ * };
+ * YACL_FIELDS(Reading, id, temp)
+ * ```
+ * Fields can be of any type accepted by `CBOR::encode()`, a `char` array
+ * holding a string, or another struct declared with `YACL_FIELDS()` (which is
+ * encoded as a nested CBOR PAIR).
+ */
+#define YACL_FIELDS(Struct, ...) \
+	template <> struct CBORFields<Struct> \
+	{ \
+		static const size_t num_fields = YACL_NUM_ARGS(__VA_ARGS__); \
+		template <typename S, typename V> static void visit(S &obj, V &visitor) \
+		{ \
+			YACL_FOR_EACH(YACL_VISIT_FIELD, __VA_ARGS__) \
+		} \
+		template <typename S, typename V> static void visit_field(S &obj, size_t idx, V &visitor) \
+		{ \
+			switch (idx) { \
+				YACL_FOR_EACH(YACL_VISIT_FIELD_CASE, __VA_ARGS__) \
+				default: break; \
+			} \
+		} \
+		static const char* const* field_names() \
+		{ \
+			static const char* const names[] = { YACL_FOR_EACH(YACL_FIELD_NAME, __VA_ARGS__) }; \
+			return names; \
+		} \
+		static const char* field_name(size_t idx) \
+		{ \
+			return (idx < num_fields)?field_names()[idx]:NULL; \
+		} \
+	};
+
+#define YACL_VISIT_FIELD(idx, field) visitor((size_t)(idx), #field, obj.field);
+#define YACL_VISIT_FIELD_CASE(idx, field) case (idx): visitor((size_t)(idx), #field, obj.field); break;
+#define YACL_FIELD_NAME(idx, field) #field,
+
+//Preprocessor helpers
+#define YACL_EXPAND(x) x
+
+#define YACL_NTH_ARG(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, _14, _15, _16, _17, _18, _19, _20, _21, _22, _23, _24, _25, _26, _27, _28, _29, _30, _31, _32, N, ...) N
+#define YACL_NUM_ARGS(...) YACL_EXPAND(YACL_NTH_ARG(__VA_ARGS__, 32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17, 16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1))
+
+#define YACL_FE_1(m, i, x) m(i, x)
+#define YACL_FE_2(m, i, x, ...) m(i, x) YACL_EXPAND(YACL_FE_1(m, i+1, __VA_ARGS__))
+#define YACL_FE_3(m, i, x, ...) m(i, x) YACL_EXPAND(YACL_FE_2(m, i+1, __VA_ARGS__))
+#define YACL_FE_4(m, i, x, ...) m(i, x) YACL_EXPAND(YACL_FE_3(m, i+1, __VA_ARGS__))
+#define YACL_FE_5(m, i, x, ...) m(i, x) YACL_EXPAND(YACL_FE_4(m, i+1, __VA_ARGS__))
+#define YACL_FE_6(m, i, x, ...) m(i, x) YACL_EXPAND(YACL_FE_5(m, i+1, __VA_ARGS__))
+#define YACL_FE_7(m, i, x, ...) m(i, x) YACL_EXPAND(YACL_FE_6(m, i+1, __VA_ARGS__))
+#define YACL_FE_8(m, i, x, ...) m(i, x) YACL_EXPAND(YACL_FE_7(m, i+1, __VA_ARGS__))
+#define YACL_FE_9(m, i, x, ...) m(i, x) YACL_EXPAND(YACL_FE_8(m, i+1, __VA_ARGS__))
+#define YACL_FE_10(m, i, x, ...) m(i, x) YACL_EXPAND(YACL_FE_9(m, i+1, __VA_ARGS__))
+#define YACL_FE_11(m, i, x, ...) m(i, x) YACL_EXPAND(YACL_FE_10(m, i+1, __VA_ARGS__))
+#define YACL_FE_12(m, i, x, ...) m(i, x) YACL_EXPAND(YACL_FE_11(m, i+1, __VA_ARGS__))
+#define YACL_FE_13(m, i, x, ...) m(i, x) YACL_EXPAND(YACL_FE_12(m, i+1, __VA_ARGS__))
+#define YACL_FE_14(m, i, x, ...) m(i, x) YACL_EXPAND(YACL_FE_13(m, i+1, __VA_ARGS__))
+#define YACL_FE_15(m, i, x, ...) m(i, x) YACL_EXPAND(YACL_FE_14(m, i+1, __VA_ARGS__))
+#define YACL_FE_16(m, i, x, ...) m(i, x) YACL_EXPAND(YACL_FE_15(m, i+1, __VA_ARGS__))
+#define YACL_FE_17(m, i, x, ...) m(i, x) YACL_EXPAND(YACL_FE_16(m, i+1, __VA_ARGS__))
+#define YACL_FE_18(m, i, x, ...) m(i, x) YACL_EXPAND(YACL_FE_17(m, i+1, __VA_ARGS__))
+#define YACL_FE_19(m, i, x, ...) m(i, x) YACL_EXPAND(YACL_FE_18(m, i+1, __VA_ARGS__))
+#define YACL_FE_20(m, i, x, ...) m(i, x) YACL_EXPAND(YACL_FE_19(m, i+1, __VA_ARGS__))
+#define YACL_FE_21(m, i, x, ...) m(i, x) YACL_EXPAND(YACL_FE_20(m, i+1, __VA_ARGS__))
+#define YACL_FE_22(m, i, x, ...) m(i, x) YACL_EXPAND(YACL_FE_21(m, i+1, __VA_ARGS__))
+#define YACL_FE_23(m, i, x, ...) m(i, x) YACL_EXPAND(YACL_FE_22(m, i+1, __VA_ARGS__))
+#define YACL_FE_24(m, i, x, ...) m(i, x) YACL_EXPAND(YACL_FE_23(m, i+1, __VA_ARGS__))
+#define YACL_FE_25(m, i, x, ...) m(i, x) YACL_EXPAND(YACL_FE_24(m, i+1, __VA_ARGS__))
+#define YACL_FE_26(m, i, x, ...) m(i, x) YACL_EXPAND(YACL_FE_25(m, i+1, __VA_ARGS__))
+#define YACL_FE_27(m, i, x, ...) m(i, x) YACL_EXPAND(YACL_FE_26(m, i+1, __VA_ARGS__))
+#define YACL_FE_28(m, i, x, ...) m(i, x) YACL_EXPAND(YACL_FE_27(m, i+1, __VA_ARGS__))
+#define YACL_FE_29(m, i, x, ...) m(i, x) YACL_EXPAND(YACL_FE_28(m, i+1, __VA_ARGS__))
+#define YACL_FE_30(m, i, x, ...) m(i, x) YACL_EXPAND(YACL_FE_29(m, i+1, __VA_ARGS__))
+#define YACL_FE_31(m, i, x, ...) m(i, x) YACL_EXPAND(YACL_FE_30(m, i+1, __VA_ARGS__))
+#define YACL_FE_32(m, i, x, ...) m(i, x) YACL_EXPAND(YACL_FE_31(m, i+1, __VA_ARGS__))
+#define YACL_FOR_EACH(m, ...) YACL_EXPAND(YACL_NTH_ARG(__VA_ARGS__, YACL_FE_32, YACL_FE_31, YACL_FE_30, YACL_FE_29, YACL_FE_28, YACL_FE_27, YACL_FE_26, YACL_FE_25, YACL_FE_24, YACL_FE_23, YACL_FE_22, YACL_FE_21, YACL_FE_20, YACL_FE_19, YACL_FE_18, YACL_FE_17, YACL_FE_16, YACL_FE_15, YACL_FE_14, YACL_FE_13, YACL_FE_12, YACL_FE_11, YACL_FE_10, YACL_FE_9, YACL_FE_8, YACL_FE_7, YACL_FE_6, YACL_FE_5, YACL_FE_4, YACL_FE_3, YACL_FE_2, YACL_FE_1)(m, 0, __VA_ARGS__))
+
+//! Visitor computing the length of the CBOR encoding of the fields of a struct.
+class CBORFieldsLen
+{
+	public:
+		//! Total length of the keys and values visited so far.
+		size_t len = 0;
+
+		template <typename T> void operator()(size_t, const char *key, const T &value)
+		{
+			len += CBOR::encoded_len(key) + value_len(value, 0);
+		}
+
+		//! Length of a value (the int/long parameter makes nested structs the preferred overload).
+		template <typename T> static auto value_len(const T &value, long)
+			-> decltype(CBOR::encoded_len(value))
+		{
+			return CBOR::encoded_len(value);
+		}
+
+		//! Length of a nested struct.
+		template <typename T> static auto value_len(const T &value, int)
+			-> decltype(CBORFields<T>::num_fields, size_t())
+		{
+			CBORFieldsLen visitor;
+			CBORFields<T>::visit(value, visitor);
+
+			return CBOR::encoded_len((unsigned long long)CBORFields<T>::num_fields) + visitor.len;
+		}
+};
+
+#endif
@@ -0,0 +1,494 @@
+#include "CBORJSONWriter.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+//! Check if `parsed` converts back to `value` in the precision of a float of `size` bytes.
+static bool same_float(double parsed, double value, uint8_t size)
+{
+	if (size == 8) {
+		return (parsed == value);
+	}
+	if (size == 4) {
+		return ((float)parsed == (float)value);
+	}
+
+	//FLOAT16: closer to value than half the spacing of float16 around it
+	int exp = 0;
+	frexp(value, &exp);
+	if ((value == 0) || (exp < -13)) {
+		exp = -13;
+	}
+
+	return (fabs(parsed - value) < ldexp(1.0, exp - 12));
+}
+
+bool CBORJSONWriter::flush()
+{
+	write_sink(staging, staged);
+
+	//Staging buffer is discarded if the sink failed
+	staged = 0;
+
+	return !write_error;
+}
+
+bool CBORJSONWriter::put(const char *str, size_t len)
+{
+	if (staged + len > CBOR_JSON_BUFFER_SIZE) {
+		if (!flush()) {
+			return false;
+		}
+
+		if (len > CBOR_JSON_BUFFER_SIZE) {
+			//Does not fit in the staging buffer: write it as is
+			return write_raw((const uint8_t*)str, len);
+		}
+	}
+
+	memcpy(staging + staged, str, len);
+	staged += len;
+
+	return true;
+}
+
+bool CBORJSONWriter::put_uint(uint64_t value)
+{
+	char digits[20];
+	char *ptr = digits + sizeof(digits);
+
+	//64-bit divisions are much slower on small targets
+	while (value > 0xFFFFFFFF) {
+		*(--ptr) = (char)('0' + value%10);
+		value /= 10;
+	}
+
+	uint32_t value32 = (uint32_t)value;
+	do {
+		*(--ptr) = (char)('0' + value32%10);
+		value32 /= 10;
+	} while (value32 != 0);
+
+	return put(ptr, digits + sizeof(digits) - ptr);
+}
+
+bool CBORJSONWriter::put_decimal(uint64_t mant, uint8_t decimals, bool negative)
+{
+	char digits[24];
+	char *ptr = digits + sizeof(digits);
+
+	//Digits after the decimal point
+	for (uint8_t i=0 ; i < decimals ; ++i) {
+		*(--ptr) = (char)('0' + mant%10);
+		mant /= 10;
+	}
+	if (decimals > 0) {
+		*(--ptr) = '.';
+	}
+
+	//Integer part
+	do {
+		*(--ptr) = (char)('0' + mant%10);
+		mant /= 10;
+	} while (mant != 0);
+
+	if (negative) {
+		*(--ptr) = '-';
+	}
+
+	return put(ptr, digits + sizeof(digits) - ptr);
+}
+
+bool CBORJSONWriter::put_float(double value, uint8_t size)
+{
+	//NaN and infinities
+	if ((value != value) || (value - value != 0)) {
+		return put("null", 4);
+	}
+
+	bool negative = (value < 0) || ((value == 0) && signbit(value));
+	double abs_val = negative?-value:value;
+
+	//Numbers with few decimals (most sensor values): smallest number of
+	//decimals that converts back to the same value
+	if (float_digits == 0) {
+		double scale = 1;
+		for (uint8_t decimals=0 ; decimals <= 9 ; ++decimals) {
+			double scaled = abs_val*scale + 0.5;
+			if (scaled >= 9007199254740992.0) {
+				break;
+			}
+
+			uint64_t mant = (uint64_t)scaled;
+			if (same_float((double)mant/scale, abs_val, size)) {
+				return put_decimal(mant, decimals, negative);
+			}
+
+			scale *= 10;
+		}
+	}
+
+	char buf[32];
+	uint8_t digits = float_digits;
+	uint8_t max_digits = float_digits;
+	if (digits == 0) {
+		digits = (size == 2)?3:((size == 4)?6:15);
+		max_digits = (size == 2)?5:((size == 4)?9:17);
+	}
+
+#if defined(__AVR__)
+	//No floating point support in printf()
+	dtostre(value, buf, (digits > 7)?6:(digits - 1), 0);
+
+	return put(buf, strlen(buf));
+#else
+	for (;;) {
+		int len = snprintf(buf, sizeof(buf), "%.*g", digits, value);
+
+		if ((digits >= max_digits) || same_float(strtod(buf, NULL), value, size)) {
+			return put(buf, len);
+		}
+		++digits;
+	}
+#endif
+}
+
+bool CBORJSONWriter::put_text(const uint8_t *str, size_t len)
+{
+	static const char hex[] = "0123456789abcdef";
+	const uint8_t *end = str + len;
+
+	while (str < end) {
+		//Run of characters written as is
+		const uint8_t *run = str;
+		while ((str < end) && (*str >= 0x20) && (*str != '"') && (*str != '\\')) {
+			++str;
+		}
+		if ((str > run) && !put((const char*)run, str - run)) {
+			return false;
+		}
+		if (str == end) {
+			break;
+		}
+
+		char esc[6] = {'\\', 0, 0, 0, 0, 0};
+		size_t esc_len = 2;
+		switch (*str) {
+			case '"':
+				esc[1] = '"';
+				break;
+			case '\\':
+				esc[1] = '\\';
+				break;
+			case '\b':
+				esc[1] = 'b';
+				break;
+			case '\f':
+				esc[1] = 'f';
+				break;
+			case '\n':
+				esc[1] = 'n';
+				break;
+			case '\r':
+				esc[1] = 'r';
+				break;
+			case '\t':
+				esc[1] = 't';
+				break;
+			default:
+				esc[1] = 'u';
+				esc[2] = '0';
+				esc[3] = '0';
+				esc[4] = hex[*str >> 4];
+				esc[5] = hex[*str & 0x0F];
+				esc_len = 6;
+				break;
+		}
+		if (!put(esc, esc_len)) {
+			return false;
+		}
+		++str;
+	}
+
+	return true;
+}
+
+static const char base64url[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+bool CBORJSONWriter::put_base64(const uint8_t *data, size_t len)
+{
+	//Complete the group started by the previous chunk
+	while ((b64_len > 0) && (len > 0)) {
+		b64_carry[b64_len++] = *(data++);
+		--len;
+
+		if (b64_len == 3) {
+			char group[4] = {base64url[b64_carry[0] >> 2],
+				base64url[((b64_carry[0] & 0x03) << 4) | (b64_carry[1] >> 4)],
+				base64url[((b64_carry[1] & 0x0F) << 2) | (b64_carry[2] >> 6)],
+				base64url[b64_carry[2] & 0x3F]};
+			b64_len = 0;
+			if (!put(group, 4)) {
+				return false;
+			}
+		}
+	}
+
+	//Whole groups, a block at a time
+	char block[64];
+	size_t block_len = 0;
+	while (len >= 3) {
+		block[block_len++] = base64url[data[0] >> 2];
+		block[block_len++] = base64url[((data[0] & 0x03) << 4) | (data[1] >> 4)];
+		block[block_len++] = base64url[((data[1] & 0x0F) << 2) | (data[2] >> 6)];
+		block[block_len++] = base64url[data[2] & 0x3F];
+		data += 3;
+		len -= 3;
+
+		if (block_len == sizeof(block)) {
+			if (!put(block, block_len)) {
+				return false;
+			}
+			block_len = 0;
+		}
+	}
+	if ((block_len > 0) && !put(block, block_len)) {
+		return false;
+	}
+
+	//Keep the remaining bytes
+	while (len > 0) {
+		b64_carry[b64_len++] = *(data++);
+		--len;
+	}
+
+	return true;
+}
+
+bool CBORJSONWriter::end_base64()
+{
+	char group[3];
+	size_t group_len = 0;
+
+	if (b64_len == 1) {
+		group[0] = base64url[b64_carry[0] >> 2];
+		group[1] = base64url[(b64_carry[0] & 0x03) << 4];
+		group_len = 2;
+	}
+	else if (b64_len == 2) {
+		group[0] = base64url[b64_carry[0] >> 2];
+		group[1] = base64url[((b64_carry[0] & 0x03) << 4) | (b64_carry[1] >> 4)];
+		group[2] = base64url[(b64_carry[1] & 0x0F) << 2];
+		group_len = 3;
+	}
+	b64_len = 0;
+
+	return (group_len == 0) || put(group, group_len);
+}
+
+const uint8_t* CBORJSONWriter::put_string(const uint8_t *ptr, const uint8_t *end, uint8_t type,
+		uint64_t len, bool indefinite)
+{
+	b64_len = 0;
+	if (!put('"')) {
+		return NULL;
+	}
+
+	for (;;) {
+		if (indefinite) {
+			//Next chunk: a definite-length string of the same type
+			if (ptr >= end) {
+				return NULL;
+			}
+			if (*ptr == CBOR_BREAK) {
+				++ptr;
+				break;
+			}
+			if (((*ptr & CBOR_TYPE_MASK) != type) || ((*ptr & CBOR_INFO_BITS) == CBOR_VAR_FOLLOWS)) {
+				return NULL;
+			}
+			ptr = CBOR::decode_header(ptr, end, len);
+			if (ptr == NULL) {
+				return NULL;
+			}
+		}
+
+		if (len > (uint64_t)(end - ptr)) {
+			return NULL;
+		}
+
+		bool ok = (type == CBOR_TEXT)?put_text(ptr, (size_t)len):put_base64(ptr, (size_t)len);
+		if (!ok) {
+			return NULL;
+		}
+		ptr += (size_t)len;
+
+		if (!indefinite) {
+			break;
+		}
+	}
+
+	if (((type == CBOR_BYTES) && !end_base64()) || !put('"')) {
+		return NULL;
+	}
+
+	return ptr;
+}
+
+bool CBORJSONWriter::write(const uint8_t *buffer, size_t buffer_len)
+{
+	const uint8_t *ptr = buffer;
+	const uint8_t *end = buffer + buffer_len;
+	uint8_t depth = 0;
+
+	if (write_error) {
+		return false;
+	}
+
+	for (;;) {
+		if (ptr >= end) {
+			return false;
+		}
+
+		bool key = false;
+		if ((depth > 0) && (*ptr == CBOR_BREAK)) {
+			//Close an indefinite-length item, after a value
+			uint8_t parent = stack_type[depth-1];
+			bool map = ((parent & CBOR_TYPE_MASK) == CBOR_MAP);
+			if (((parent & CBOR_INFO_BITS) != CBOR_VAR_FOLLOWS) || (map && (stack_count[depth-1] & 1))) {
+				return false;
+			}
+
+			++ptr;
+			--depth;
+			if (!put(map?'}':']')) {
+				return false;
+			}
+		}
+		else {
+			//Separator
+			if (depth > 0) {
+				size_t count = stack_count[depth-1];
+				bool map = ((stack_type[depth-1] & CBOR_TYPE_MASK) == CBOR_MAP);
+
+				key = map && !(count & 1);
+				if ((count > 0) && !put((map && (count & 1))?':':',')) {
+					return false;
+				}
+			}
+
+			//Tags are ignored
+			const uint8_t *head;
+			uint8_t type;
+			uint64_t arg;
+			do {
+				if (ptr >= end) {
+					return false;
+				}
+				head = ptr;
+				type = *ptr & CBOR_TYPE_MASK;
+				ptr = CBOR::decode_header(ptr, end, arg);
+				if (ptr == NULL) {
+					return false;
+				}
+			} while (type == CBOR_TAG);
+
+			bool indefinite = ((*head & CBOR_INFO_BITS) == CBOR_VAR_FOLLOWS);
+			bool ok = true;
+
+			switch (type) {
+				case CBOR_UINT:
+					ok = (!key || put('"')) && put_uint(arg) && (!key || put('"'));
+					break;
+
+				case CBOR_NEGINT:
+					ok = (!key || put('"')) && put('-')
+						&& ((arg == 0xFFFFFFFFFFFFFFFFULL)?put("18446744073709551616", 20):put_uint(arg + 1))
+						&& (!key || put('"'));
+					break;
+
+				case CBOR_BYTES:
+				case CBOR_TEXT:
+					ptr = put_string(ptr, end, type, arg, indefinite);
+					ok = (ptr != NULL);
+					break;
+
+				case CBOR_ARRAY:
+				case CBOR_MAP:
+					if (key || (depth == CBOR_JSON_MAX_DEPTH) || !put((type == CBOR_MAP)?'{':'[')) {
+						return false;
+					}
+
+					if (!indefinite) {
+						//Every element takes at least one byte
+						if ((arg > (uint64_t)(end - ptr)) || ((type == CBOR_MAP) && (arg > (uint64_t)(end - ptr)/2))) {
+							return false;
+						}
+						if (arg == 0) {
+							ok = put((type == CBOR_MAP)?'}':']');
+							break;
+						}
+					}
+
+					stack_type[depth] = indefinite?(type | CBOR_VAR_FOLLOWS):type;
+					stack_count[depth] = 0;
+					stack_total[depth] = indefinite?(size_t)(-1):(size_t)((type == CBOR_MAP)?2*arg:arg);
+					++depth;
+					continue;
+
+				default: //CBOR_7
+					if (indefinite) {
+						//Unexpected break
+						return false;
+					}
+
+					if ((*head >= CBOR_FLOAT16) && (*head <= CBOR_FLOAT64)) {
+						double value;
+						if (*head == CBOR_FLOAT16) {
+							value = CBOR::half_to_float((uint16_t)arg);
+						}
+						else if (*head == CBOR_FLOAT32) {
+							uint32_t bits = (uint32_t)arg;
+							float single;
+							memcpy(&single, &bits, sizeof(single));
+							value = single;
+						}
+						else {
+							value = CBOR::double_from_bits(arg);
+						}
+						ok = (!key || put('"')) && put_float(value, (uint8_t)(ptr - head - 1)) && (!key || put('"'));
+					}
+					else if (arg == (CBOR_FALSE & CBOR_INFO_BITS)) {
+						ok = (!key || put('"')) && put("false", 5) && (!key || put('"'));
+					}
+					else if (arg == (CBOR_TRUE & CBOR_INFO_BITS)) {
+						ok = (!key || put('"')) && put("true", 4) && (!key || put('"'));
+					}
+					else {
+						ok = (!key || put('"')) && put("null", 4) && (!key || put('"'));
+					}
+					break;
+			}
+
+			if (!ok) {
+				return false;
+			}
+		}
+
+		//An item is complete: close the definite-length items it completes
+		for (;;) {
+			if (depth == 0) {
+				return !write_error;
+			}
+
+			if (++stack_count[depth-1] != stack_total[depth-1]) {
+				break;
+			}
+
+			--depth;
+			if (!put(((stack_type[depth] & CBOR_TYPE_MASK) == CBOR_MAP)?'}':']')) {
+				return false;
+			}
+		}
+	}
+}
@@ -0,0 +1,178 @@
+#ifndef INCLUDED_CBORJSONWRITER_H
+#define INCLUDED_CBORJSONWRITER_H
+
+#include "CBORSink.h"
+
+//! Size (in bytes) of the staging buffer of CBORJSONWriter.
+#ifndef CBOR_JSON_BUFFER_SIZE
+#define CBOR_JSON_BUFFER_SIZE 64
+#endif
+
+//! A class to transcode CBOR data to JSON, directly to a sink.
+/*!
+ * CBOR items are read from their buffer, and written as JSON text to a small
+ * staging buffer, which is written to the sink whenever it is full. No CBOR
+ * object is built, and memory usage does not depend on the size of the
+ * message.
+ *
+ * ```
+ * CBORJSONWriter json(Serial);
+ * json.write(msg);
+ * json.flush();
+ * ```
+ *
+ * Items are converted as recommended by RFC 8949 (section 6.1):
+ * - integers and floats are written as JSON numbers (NaN and infinities
+ *   as `null`),
+ * - text strings are written as JSON strings, with `"`, `\` and control
+ *   characters escaped,
+ * - byte strings are written as base64url strings, without padding,
+ * - tags are ignored (only the tagged item is written),
+ * - `false`, `true` and `null` are written as such, and other simple
+ *   values as `null`,
+ * - keys that are not text strings are written as JSON strings: byte
+ *   strings in base64url, numbers and simple values in quotes. Arrays and
+ *   maps cannot be used as keys.
+ */
+class CBORJSONWriter: public CBORSink
+{
+	protected:
+		//! Staging buffer.
+		uint8_t staging[CBOR_JSON_BUFFER_SIZE];
+		//! Number of bytes in the staging buffer.
+		size_t staged = 0;
+		//! Significant digits of floats (0 for the shortest exact representation).
+		uint8_t float_digits = 0;
+
+		//! Type of each open item (CBOR_ARRAY or CBOR_MAP, ORed with
+		//! CBOR_VAR_FOLLOWS if indefinite-length).
+		uint8_t stack_type[CBOR_JSON_MAX_DEPTH];
+		//! Number of items already written in each open item (keys and
+		//! values are counted separately).
+		size_t stack_count[CBOR_JSON_MAX_DEPTH];
+		//! Number of items of each open definite-length item.
+		size_t stack_total[CBOR_JSON_MAX_DEPTH];
+
+		//! Bytes of a base64 group not written yet.
+		uint8_t b64_carry[3];
+		//! Number of bytes in `b64_carry`.
+		uint8_t b64_len = 0;
+
+		//! Write a single character.
+		bool put(char c)
+		{
+			if ((staged == CBOR_JSON_BUFFER_SIZE) && !flush()) {
+				return false;
+			}
+			staging[staged++] = (uint8_t)c;
+
+			return true;
+		}
+
+		//! Write characters.
+		bool put(const char *str, size_t len);
+
+		//! Write an unsigned integer.
+		bool put_uint(uint64_t value);
+
+		//! Write a float as a JSON number.
+		/*!
+		 * \param value The value to write.
+		 * \param size Size (in bytes) of the encoded float: 2, 4 or 8.
+		 */
+		bool put_float(double value, uint8_t size);
+
+		//! Write a decimal number.
+		/*!
+		 * \param mant Digits of the number.
+		 * \param decimals Number of digits after the decimal point.
+		 * \param negative True to write a minus sign.
+		 */
+		bool put_decimal(uint64_t mant, uint8_t decimals, bool negative);
+
+		//! Write the content of a text string, escaped.
+		bool put_text(const uint8_t *str, size_t len);
+
+		//! Write the content of a byte string, in base64url.
+		/*!
+		 * Up to 2 bytes are kept in `b64_carry` until the next call, or until
+		 * `end_base64()`.
+		 */
+		bool put_base64(const uint8_t *data, size_t len);
+
+		//! Write the bytes kept by `put_base64()`.
+		bool end_base64();
+
+		//! Write a string item, or all the chunks of an indefinite-length one.
+		/*!
+		 * \param ptr Pointer to the first byte after the header.
+		 * \param end Pointer to the end of the input.
+		 * \param type CBOR_TEXT or CBOR_BYTES.
+		 * \param len Length of the string.
+		 * \param indefinite True if the string is indefinite-length.
+		 * \return Pointer to the first byte after the string, or NULL if it
+		 * is malformed or truncated, or if the sink failed.
+		 */
+		const uint8_t* put_string(const uint8_t *ptr, const uint8_t *end, uint8_t type,
+				uint64_t len, bool indefinite);
+
+	public:
+		//! Construct a JSON writer using a callback as sink.
+		/*!
+		 * \param callback Function writing bytes to the sink.
+		 * \param context User pointer given to `callback`.
+		 */
+		CBORJSONWriter(cbor_write_callback callback, void *context = NULL)
+			: CBORSink(callback, context) {}
+
+		//! Construct a JSON writer using an object as sink.
+		/*!
+		 * \param sink Any object with a `write(const uint8_t*, size_t)` method,
+		 * such as `Serial` or a network client. It must outlive the writer.
+		 */
+		template <typename S> CBORJSONWriter(S &sink)
+			: CBORJSONWriter(write_to<S>, (void*)&sink) {}
+
+		//! Destructor (flushes the staging buffer).
+		~CBORJSONWriter() { flush(); }
+
+		//! Transcode a CBOR item to JSON.
+		/*!
+		 * Only the first item of the buffer is transcoded. If it is
+		 * malformed or truncated, the JSON text written so far is not
+		 * complete.
+		 *
+		 * \param buffer Pointer to the CBOR item.
+		 * \param buffer_len Size (in bytes) of the buffer.
+		 * \return False if the item is malformed, truncated, nested deeper
+		 * than `CBOR_JSON_MAX_DEPTH`, uses an array or a map as key, or if
+		 * the sink failed. True otherwise.
+		 */
+		bool write(const uint8_t *buffer, size_t buffer_len);
+
+		//! Transcode a CBOR object to JSON.
+		/*!
+		 * \param value The CBOR object to transcode.
+		 * \return False if anything goes wrong. True otherwise.
+		 */
+		bool write(const CBOR &value) { return write(value.to_CBOR(), value.length()); }
+
+		//! Write the content of the staging buffer to the sink.
+		/*!
+		 * \return False if the sink failed (now or before), true otherwise.
+		 */
+		bool flush();
+
+		//! Set the number of significant digits of floats.
+		/*!
+		 * \param digits Number of significant digits (1 to 17), or 0 (the
+		 * default) to write the shortest representation that converts back
+		 * to the same value, in the precision it was encoded with.
+		 */
+		void set_float_digits(uint8_t digits) { float_digits = (digits > 17)?17:digits; }
+
+		//! Get the number of significant digits of floats (0 for the shortest exact representation).
+		uint8_t get_float_digits() const { return float_digits; }
+};
+
+#endif
@@ -1,12 +1,18 @@
 #include "CBORPair.h"
 
 CBORPair::CBORPair(uint8_t* _buffer, size_t buffer_len, bool has_data)
+	: CBORComposed(_buffer, buffer_len)
 {
-	max_buf_len = buffer_len;
-	buffer_type = BUFFER_EXTERNAL;
+	if (has_data && ((_buffer[0] & CBOR_INFO_BITS) == CBOR_VAR_FOLLOWS)) {
+		buffer_begin = _buffer;
+		buffer_data_begin = buffer_begin + 1;
+		indefinite = true;
+		has_break = true;
 
-	if (has_data) {
-		ext_buffer_begin = _buffer;
+		//Jump to the end of the data chunk, after the break
+		w_ptr = buffer_begin + element_size(buffer_begin);
+	}
+	else if (has_data) {
 		buffer_begin = _buffer;
 
 		buffer_data_begin = buffer_begin + compute_type_num_len(n_elements());
@@ -20,7 +26,6 @@ CBORPair::CBORPair(uint8_t* _buffer, size_t buffer_len, bool has_data)
 	}
 	else {
 		//Reserve begining of buffer to store table length
-		ext_buffer_begin = _buffer;
 		buffer_data_begin = _buffer + NUM_ELE_PROVISION;
 		buffer_begin = _buffer + 8; //type_num_len is 1 for Pair size 0
 		w_ptr = buffer_data_begin;
@@ -31,17 +36,31 @@ CBORPair::CBORPair(uint8_t* _buffer, size_t buffer_len, bool has_data)
 }
 
 CBORPair::CBORPair(const uint8_t* _buffer, size_t buf_len)
+	: CBORPair(_buffer, buf_len, *CBORAllocator::get_default())
 {
-	size_t _num_ele = decode_abs_num(_buffer);
+}
 
-	//Init buffer
-	max_buf_len = buf_len + NUM_ELE_PROVISION;
-	init_buffer();
+CBORPair::CBORPair(const uint8_t* _buffer, size_t buf_len, CBORAllocator &_allocator)
+	: CBORComposed(buf_len, _allocator)
+{
+	if ((_buffer[0] & CBOR_INFO_BITS) == CBOR_VAR_FOLLOWS) {
+		//Keep the indefinite-length header and the break
+		begin_indefinite();
+		has_break = true;
+		memcpy(buffer_begin, _buffer, buf_len);
+		YACL_STAT(bytes_copied, buf_len);
+		w_ptr = buffer_begin + element_size(buffer_begin);
+
+		return;
+	}
+
+	size_t _num_ele = decode_abs_num(_buffer);
 
 	//Initialize number of elements, and copy data
 	init_num_ele(_num_ele);
 	memcpy(w_ptr, _buffer + compute_type_num_len(_num_ele),
 			buf_len - compute_type_num_len(_num_ele));
+	YACL_STAT(bytes_copied, buf_len - compute_type_num_len(_num_ele));
 
 	//Jump to the end of the data chunk
 	for (size_t i=0 ;  i < n_elements() ; ++i) {
@@ -2,6 +2,7 @@
 #define INCLUDED_CBORPAIR_H
 
 #include "CBORComposed.h"
+#include "CBORFields.h"
 
 //! A class to handle CBOR dictionaries of key/value pairs.
 /*!
@@ -25,9 +26,50 @@ class CBORPair: public CBORComposed<CBOR_MAP>
 		 */
 		CBORPair(size_t buf_len) : CBORComposed(buf_len) {};
 
+		//! Construct a CBOR PAIR with a DYNAMIC_INTERNAL buffer, using a custom allocator.
+		/*!
+		 * \param _allocator The allocator of the buffer.
+		 */
+		CBORPair(CBORAllocator &_allocator) : CBORComposed(1, _allocator) {};
+
+		//! Construct a CBOR PAIR with a custom length DYNAMIC_INTERNAL buffer, using a custom allocator.
+		/*!
+		 * \param buf_len Buffer size, in bytes, of the data section of the buffer.
+		 * \param _allocator The allocator of the buffer.
+		 */
+		CBORPair(size_t buf_len, CBORAllocator &_allocator) : CBORComposed(buf_len, _allocator) {};
+
 		//! Copy constructor.
 		CBORPair(const CBORPair &obj) : CBORComposed(obj) {};
 
+		//! Move constructor.
+		/*!
+		 * Takes over the buffer of `obj` without copying it. `obj` can then
+		 * only be destroyed or assigned to.
+		 */
+		CBORPair(CBORPair &&obj) : CBORComposed(static_cast<CBORComposed&&>(obj)) {};
+
+		//! Copy assignment operator.
+		/*!
+		 * The copy is allocated with the allocator of this object.
+		 */
+		CBORPair& operator=(const CBORPair &obj)
+		{
+			CBORComposed::operator=(obj);
+			return *this;
+		}
+
+		//! Move assignment operator.
+		/*!
+		 * Takes over the buffer (and allocator) of `obj` without copying it.
+		 * `obj` can then only be destroyed or assigned to.
+		 */
+		CBORPair& operator=(CBORPair &&obj)
+		{
+			CBORComposed::operator=(static_cast<CBORComposed&&>(obj));
+			return *this;
+		}
+
 		//! Construct a CBOR PAIR using an external buffer.
 		/*!
 		 * If has_data == true, then new elements can be added.
@@ -48,6 +90,14 @@ class CBORPair: public CBORComposed<CBOR_MAP>
 		 */
 		CBORPair(const uint8_t* _buffer, size_t buf_len);
 
+		//! Parse and create a CBOR PAIR from a byte array of CBOR data, using a custom allocator.
+		/*!
+		 * \param buffer Pointer to the beginning of the array.
+		 * \param buffer_len Size (in bytes) of the array.
+		 * \param _allocator The allocator of the copy.
+		 */
+		CBORPair(const uint8_t* _buffer, size_t buf_len, CBORAllocator &_allocator);
+
 		//! Appends an element to the end of this CBOR PAIR.
 		/*!
 		 * \param key The key of the element to append to this CBOR PAIR.
@@ -56,6 +106,8 @@ class CBORPair: public CBORComposed<CBOR_MAP>
 		 */
 		template <typename T, typename U> bool append(T key, U value)
 		{
+			YACL_PROFILE_SCOPE(CBOR_PROFILE_APPEND);
+
 			bool ret_val = true;
 
 			increment_num_ele();
@@ -64,6 +116,87 @@ class CBORPair: public CBORComposed<CBOR_MAP>
 
 			return ret_val;
 		}
+
+		//! Appends a key and an RFC 8746 typed array to the end of this CBOR PAIR.
+		/*!
+		 * The elements are encoded as a single byte string, instead of one
+		 * CBOR element each (see `CBOR::encode_typed_array()`).
+		 *
+		 * \param key The key of the element to append to this CBOR PAIR.
+		 * \param values Pointer to the elements.
+		 * \param num_ele Number of elements.
+		 * \param big_endian True to encode big-endian elements, false for
+		 * little-endian (defaults to the native byte order).
+		 * \return True if the operation was successful, false otherwise.
+		 */
+		template <typename K, typename T> bool append_typed_array(K key, const T *values,
+				size_t num_ele, bool big_endian = CBOR_BIG_ENDIAN)
+		{
+			bool ret_val = true;
+
+			increment_num_ele();
+			ret_val = add(key);
+			ret_val &= add_typed_array((const uint8_t*)values, num_ele, sizeof(T),
+					typed_array_tag<T>(big_endian), (sizeof(T) > 1) && (big_endian != CBOR_BIG_ENDIAN));
+
+			return ret_val;
+		}
+
+		//! Appends all the fields of a struct to the end of this CBOR PAIR.
+		/*!
+		 * The fields of `S` must be declared with `YACL_FIELDS()`. Each
+		 * field is appended with its name as key. The buffer is grown once,
+		 * to the exact size of the encoded fields.
+		 *
+		 * \param obj The struct to append.
+		 * \return True if the operation was successful, false otherwise.
+		 */
+		template <typename S> bool append_fields(const S &obj)
+		{
+			CBORFieldsLen fields_len;
+			CBORFields<S>::visit(obj, fields_len);
+
+			if (!reserve(length() + fields_len.len)) {
+				return false;
+			}
+
+			add_num_ele(CBORFields<S>::num_fields);
+			FieldWriter writer(*this);
+			CBORFields<S>::visit(obj, writer);
+
+			return writer.status;
+		}
+
+	protected:
+		//! Visitor adding the fields of a struct to a CBOR PAIR.
+		class FieldWriter
+		{
+			public:
+				CBORPair &pair;
+				bool status = true;
+
+				FieldWriter(CBORPair &_pair) : pair(_pair) {};
+
+				template <typename T> void operator()(size_t, const char *key, const T &value)
+				{
+					status &= pair.add(key);
+					add_value(value, 0);
+				}
+
+				template <typename T> auto add_value(const T &value, long)
+					-> decltype(CBOR::encoded_len(value), void())
+				{
+					status &= pair.add(value);
+				}
+
+				//Nested struct
+				template <typename T> auto add_value(const T &value, int)
+					-> decltype(CBORFields<T>::num_fields, void())
+				{
+					status &= pair.encode_type_num(CBOR_MAP, CBORFields<T>::num_fields);
+					CBORFields<T>::visit(value, *this);
+				}
+		};
 };
 
 #endif
@@ -0,0 +1,231 @@
+#include "CBORParser.h"
+
+void CBORParser::reset()
+{
+	in = NULL;
+	in_len = 0;
+	head_len = 0;
+	ev = CBOR_EVENT_SIMPLE;
+	arg = 0;
+	indefinite = false;
+	tag_pending = false;
+	chunk = NULL;
+	chunk_len = 0;
+	str_type = 0;
+	str_remaining = 0;
+	stack_depth = 0;
+	failed = false;
+}
+
+void CBORParser::item_done()
+{
+	if (stack_depth == 0) {
+		return;
+	}
+
+	//Definite-length items count their elements down, indefinite-length
+	//ones count them up
+	if ((stack_type[stack_depth-1] & CBOR_INFO_BITS) == 0) {
+		--stack_remaining[stack_depth-1];
+	}
+	else {
+		++stack_remaining[stack_depth-1];
+	}
+}
+
+void CBORParser::close_item()
+{
+	--stack_depth;
+	ev = CBOR_EVENT_END;
+	item_done();
+}
+
+bool CBORParser::open_item(uint8_t type, uint64_t num_items)
+{
+	if (stack_depth == CBOR_PARSER_MAX_DEPTH) {
+		return false;
+	}
+
+	//Keys and values are counted separately
+	if ((type == CBOR_MAP) && (num_items > (size_t)(-1)/2)) {
+		return false;
+	}
+	if (num_items > (size_t)(-1)) {
+		return false;
+	}
+
+	stack_type[stack_depth] = type;
+	stack_remaining[stack_depth] = (type == CBOR_MAP)?(size_t)(2*num_items):(size_t)num_items;
+	++stack_depth;
+
+	return true;
+}
+
+uint8_t CBORParser::next_chunk()
+{
+	if (in_len == 0) {
+		return CBOR_PARSER_NEED_MORE;
+	}
+
+	size_t len = (str_remaining < in_len)?(size_t)str_remaining:in_len;
+
+	ev = (str_type == CBOR_BYTES)?CBOR_EVENT_BYTES:CBOR_EVENT_TEXT;
+	chunk = in;
+	chunk_len = len;
+	in += len;
+	in_len -= len;
+	str_remaining -= len;
+
+	if (str_remaining == 0) {
+		str_type = 0;
+		item_done();
+	}
+
+	return CBOR_PARSER_EVENT;
+}
+
+uint8_t CBORParser::next()
+{
+	if (failed) {
+		return CBOR_PARSER_ERROR;
+	}
+
+	indefinite = false;
+	chunk = NULL;
+	chunk_len = 0;
+
+	//Resume a string
+	if (str_type != 0) {
+		return next_chunk();
+	}
+
+	//End of a definite-length array or map
+	if ((stack_depth > 0) && ((stack_type[stack_depth-1] & CBOR_INFO_BITS) == 0)
+			&& (stack_remaining[stack_depth-1] == 0)) {
+		close_item();
+		return CBOR_PARSER_EVENT;
+	}
+
+	//Reassemble header
+	if (head_len == 0) {
+		if (in_len == 0) {
+			return CBOR_PARSER_NEED_MORE;
+		}
+		head[head_len++] = *(in++);
+		--in_len;
+	}
+
+	uint8_t needed = CBOR::header_length(head[0]);
+	if (needed == 0) {
+		return fail();
+	}
+
+	while (head_len < needed) {
+		if (in_len == 0) {
+			return CBOR_PARSER_NEED_MORE;
+		}
+		head[head_len++] = *(in++);
+		--in_len;
+	}
+	head_len = 0;
+
+	uint8_t type = head[0] & CBOR_TYPE_MASK;
+	uint8_t info = head[0] & CBOR_INFO_BITS;
+
+	CBOR::decode_header(head, head + needed, arg);
+
+	//Indefinite-length strings only contain definite-length strings of the
+	//same type
+	if ((stack_depth > 0) && (head[0] != CBOR_BREAK)) {
+		uint8_t parent = stack_type[stack_depth-1];
+		if (((parent == (CBOR_TEXT | CBOR_VAR_FOLLOWS)) || (parent == (CBOR_BYTES | CBOR_VAR_FOLLOWS)))
+				&& ((type != (parent & CBOR_TYPE_MASK)) || (info == CBOR_VAR_FOLLOWS))) {
+			return fail();
+		}
+	}
+
+	//A break cannot follow a tag
+	bool after_tag = tag_pending;
+	tag_pending = (type == CBOR_TAG);
+
+	switch (type) {
+		case CBOR_UINT:
+			ev = CBOR_EVENT_UINT;
+			item_done();
+			break;
+
+		case CBOR_NEGINT:
+			ev = CBOR_EVENT_NEGINT;
+			item_done();
+			break;
+
+		case CBOR_BYTES:
+		case CBOR_TEXT:
+			ev = (type == CBOR_BYTES)?CBOR_EVENT_BYTES:CBOR_EVENT_TEXT;
+			if (info == CBOR_VAR_FOLLOWS) {
+				indefinite = true;
+				arg = 0;
+				if (!open_item(head[0], 0)) {
+					return fail();
+				}
+				break;
+			}
+
+			if (arg == 0) {
+				item_done();
+				break;
+			}
+
+			str_type = type;
+			str_remaining = arg;
+			return next_chunk();
+
+		case CBOR_ARRAY:
+		case CBOR_MAP:
+			ev = (type == CBOR_ARRAY)?CBOR_EVENT_ARRAY:CBOR_EVENT_MAP;
+			if (info == CBOR_VAR_FOLLOWS) {
+				indefinite = true;
+				arg = 0;
+			}
+			if (!open_item(indefinite?head[0]:type, arg)) {
+				return fail();
+			}
+			break;
+
+		case CBOR_TAG:
+			//The tagged item is the next one
+			ev = CBOR_EVENT_TAG;
+			break;
+
+		default: //CBOR_7
+			if (head[0] == CBOR_BREAK) {
+				if ((stack_depth == 0) || ((stack_type[stack_depth-1] & CBOR_INFO_BITS) == 0)
+						|| after_tag) {
+					return fail();
+				}
+				//A key without a value
+				if ((stack_type[stack_depth-1] == (CBOR_MAP | CBOR_VAR_FOLLOWS))
+						&& (stack_remaining[stack_depth-1] & 1)) {
+					return fail();
+				}
+				close_item();
+				break;
+			}
+
+			ev = (info >= CBOR_UINT16_FOLLOWS)?CBOR_EVENT_FLOAT:CBOR_EVENT_SIMPLE;
+			item_done();
+			break;
+	}
+
+	return CBOR_PARSER_EVENT;
+}
+
+double CBORParser::get_float() const
+{
+	if (ev != CBOR_EVENT_FLOAT) {
+		return 0.0;
+	}
+
+	//Header still holds the whole float item
+	return (double)CBOR((uint8_t*)head, CBOR::header_length(head[0]), true);
+}
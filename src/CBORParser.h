@@ -0,0 +1,204 @@
+#ifndef INCLUDED_CBORPARSER_H
+#define INCLUDED_CBORPARSER_H
+
+#include "CBOR.h"
+
+//! Maximum nesting depth of arrays, maps and indefinite-length strings.
+#ifndef CBOR_PARSER_MAX_DEPTH
+#define CBOR_PARSER_MAX_DEPTH 16
+#endif
+
+//! Status returned by CBORParser::next().
+#define CBOR_PARSER_NEED_MORE 0 //All input consumed, call feed()
+#define CBOR_PARSER_EVENT     1 //A new event is available
+#define CBOR_PARSER_ERROR     2 //Malformed input
+
+//! Events of CBORParser.
+#define CBOR_EVENT_UINT   0 //Positive integer: get_uint()
+#define CBOR_EVENT_NEGINT 1 //Negative integer: get_int()
+#define CBOR_EVENT_BYTES  2 //Byte string chunk: data(), data_len()
+#define CBOR_EVENT_TEXT   3 //Text string chunk: data(), data_len()
+#define CBOR_EVENT_ARRAY  4 //Start of an array of get_uint() elements
+#define CBOR_EVENT_MAP    5 //Start of a map of get_uint() key/value pairs
+#define CBOR_EVENT_TAG    6 //Tag get_uint(), applying to the next item
+#define CBOR_EVENT_SIMPLE 7 //Simple value get_simple() (false, true, null...)
+#define CBOR_EVENT_FLOAT  8 //Floating point number: get_float()
+#define CBOR_EVENT_END    9 //End of an array, a map or an indefinite-length string
+
+//! A class to decode CBOR data received in chunks.
+/*!
+ * The parser is fed with chunks of any size (down to one byte), and yields
+ * one event per item, without waiting for complete items: only item headers
+ * (at most 9 bytes) are buffered, strings are returned as chunks pointing
+ * into the input, and arrays and maps are returned as a start event, their
+ * elements, and an end event.
+ *
+ * ```
+ * CBORParser parser;
+ * uint8_t chunk[64];
+ *
+ * while (size_t len = Serial.readBytes(chunk, 64)) {
+ * 	parser.feed(chunk, len);
+ * 	while (parser.next() == CBOR_PARSER_EVENT) {
+ * 		switch (parser.event()) {
+ * 			...
+ * 		}
+ * 	}
+ * }
+ * ```
+ *
+ * Input chunks are not copied: string chunks (see `data()`) are only valid
+ * until the next call to `feed()`.
+ */
+class CBORParser
+{
+	protected:
+		//! Current input chunk.
+		const uint8_t *in = NULL;
+		//! Number of bytes left in the current input chunk.
+		size_t in_len = 0;
+
+		//! Header of the current item (reassembled across chunks).
+		uint8_t head[9];
+		//! Number of bytes in `head`.
+		uint8_t head_len = 0;
+
+		//! Current event.
+		uint8_t ev = CBOR_EVENT_SIMPLE;
+		//! Argument of the current event (value, length, count, tag...).
+		uint64_t arg = 0;
+		//! True if the current event starts an indefinite-length item.
+		bool indefinite = false;
+		//! True if the last header was a tag (its item has not started yet).
+		bool tag_pending = false;
+		//! Current string chunk.
+		const uint8_t *chunk = NULL;
+		//! Length of the current string chunk.
+		size_t chunk_len = 0;
+
+		//! Major type of the string being parsed (0 if none).
+		uint8_t str_type = 0;
+		//! Number of bytes of the current string not returned yet.
+		uint64_t str_remaining = 0;
+
+		//! Type of each open item (CBOR_ARRAY, CBOR_MAP, CBOR_TEXT or
+		//! CBOR_BYTES, ORed with CBOR_VAR_FOLLOWS if indefinite-length).
+		uint8_t stack_type[CBOR_PARSER_MAX_DEPTH];
+		//! Number of items left in each open definite-length item, or
+		//! read so far in each open indefinite-length item.
+		size_t stack_remaining[CBOR_PARSER_MAX_DEPTH];
+		//! Number of open items.
+		uint8_t stack_depth = 0;
+
+		//! True once malformed input was found.
+		bool failed = false;
+
+		//! Set the current event to be the end of the innermost open item.
+		void close_item();
+
+		//! Account for a complete item in the innermost open item.
+		void item_done();
+
+		//! Open a new array, map or indefinite-length string.
+		/*!
+		 * \return False if the maximum depth is reached.
+		 */
+		bool open_item(uint8_t type, uint64_t num_items);
+
+		//! Return the next chunk of the string being parsed.
+		uint8_t next_chunk();
+
+		//! Set the error flag.
+		uint8_t fail() { failed = true; return CBOR_PARSER_ERROR; }
+
+	public:
+		//! Construct a CBOR parser.
+		CBORParser() {};
+
+		//! Give a new chunk of input to the parser.
+		/*!
+		 * Any input left from the previous chunk is discarded: call `next()`
+		 * until it returns `CBOR_PARSER_NEED_MORE` before feeding a new chunk.
+		 *
+		 * \param buffer Pointer to the beginning of the chunk.
+		 * \param buffer_len Size (in bytes) of the chunk.
+		 */
+		void feed(const uint8_t *buffer, size_t buffer_len) { in = buffer; in_len = buffer_len; }
+
+		//! Parse the next event.
+		/*!
+		 * \return `CBOR_PARSER_EVENT` if a new event is available,
+		 * `CBOR_PARSER_NEED_MORE` if all the input was consumed, or
+		 * `CBOR_PARSER_ERROR` if the input is malformed (the parser must
+		 * then be reset).
+		 */
+		uint8_t next();
+
+		//! Reset the parser, to parse a new message.
+		void reset();
+
+		//! Get the type of the current event.
+		/*!
+		 * \return One of `CBOR_EVENT_UINT`, `CBOR_EVENT_NEGINT`,
+		 * `CBOR_EVENT_BYTES`, `CBOR_EVENT_TEXT`, `CBOR_EVENT_ARRAY`,
+		 * `CBOR_EVENT_MAP`, `CBOR_EVENT_TAG`, `CBOR_EVENT_SIMPLE`,
+		 * `CBOR_EVENT_FLOAT` or `CBOR_EVENT_END`.
+		 */
+		uint8_t event() const { return ev; }
+
+		//! Get the value of a UINT event, the count of an ARRAY or MAP event, or the tag of a TAG event.
+		uint64_t get_uint() const { return arg; }
+
+		//! Get the value of a UINT or NEGINT event.
+		/*!
+		 * Output is undefined if the value does not fit in a `long long`.
+		 */
+		long long get_int() const
+		{
+			return (ev == CBOR_EVENT_NEGINT)?(-1 - (long long)arg):(long long)arg;
+		}
+
+		//! Get the value of a FLOAT event.
+		double get_float() const;
+
+		//! Get the value of a SIMPLE event (CBOR_FALSE & 0x1F, CBOR_TRUE & 0x1F...).
+		uint8_t get_simple() const { return (uint8_t)arg; }
+
+		//! Get the value of a SIMPLE event, as a boolean.
+		bool get_bool() const { return (arg == (CBOR_TRUE & CBOR_INFO_BITS)); }
+
+		//! Return true if the current SIMPLE event is CBOR NULL.
+		bool is_null() const { return (ev == CBOR_EVENT_SIMPLE) && (arg == (CBOR_NULL & CBOR_INFO_BITS)); }
+
+		//! Return true if the current ARRAY, MAP, BYTES or TEXT event starts an indefinite-length item.
+		/*!
+		 * The chunks of an indefinite-length string are returned as BYTES or
+		 * TEXT events, followed by an END event.
+		 */
+		bool is_indefinite() const { return indefinite; }
+
+		//! Get the current string chunk.
+		/*!
+		 * \return Pointer to the chunk, valid until the next call to `feed()`.
+		 */
+		const uint8_t* data() const { return chunk; }
+
+		//! Get the length of the current string chunk.
+		size_t data_len() const { return chunk_len; }
+
+		//! Get the number of bytes of the current string still to come.
+		/*!
+		 * \return 0 if the current chunk is the last one of its (definite
+		 * length) string.
+		 */
+		uint64_t string_remaining() const { return str_remaining; }
+
+		//! Get the current nesting depth.
+		/*!
+		 * \return Number of arrays, maps and indefinite-length strings
+		 * currently open.
+		 */
+		uint8_t depth() const { return stack_depth; }
+};
+
+#endif
@@ -0,0 +1,40 @@
+#include "CBORProfile.h"
+
+cbor_profile_clock CBORProfile::clock = NULL;
+CBORProfileStats CBORProfile::stats[CBOR_PROFILE_N_API];
+
+const char* CBORProfile::name(uint8_t api)
+{
+	static const char* const names[CBOR_PROFILE_N_API] = {"add", "append", "at",
+		"find_by_key", "operator[]", "conversion"};
+
+	return (api < CBOR_PROFILE_N_API)?names[api]:"";
+}
+
+void CBORProfile::reset()
+{
+	for (uint8_t i=0 ; i < CBOR_PROFILE_N_API ; ++i) {
+		stats[i] = CBORProfileStats();
+	}
+}
+
+void CBORProfile::record(uint8_t api, unsigned long elapsed)
+{
+	CBORProfileStats &entry = stats[api];
+	uint8_t bucket = 0;
+
+	if ((entry.calls == 0) || (elapsed < entry.min)) {
+		entry.min = elapsed;
+	}
+	if (elapsed > entry.max) {
+		entry.max = elapsed;
+	}
+	++entry.calls;
+	entry.total += elapsed;
+
+	while ((elapsed > 0) && (bucket < CBOR_PROFILE_BUCKETS - 1)) {
+		elapsed >>= 1;
+		++bucket;
+	}
+	++entry.histogram[bucket];
+}
@@ -0,0 +1,128 @@
+#ifndef INCLUDED_CBORPROFILE_H
+#define INCLUDED_CBORPROFILE_H
+#include <stdint.h>
+#include <stddef.h>
+
+//! Define YACL_PROFILE (in the build flags, or here) to time the public entry points (see CBORProfile).
+/*!
+ * It must be defined for the library as well as for the sketch. When it is
+ * not defined, no timing code is compiled.
+ */
+//#define YACL_PROFILE
+
+//! Number of buckets of the latency histograms of CBORProfile.
+#ifndef CBOR_PROFILE_BUCKETS
+#define CBOR_PROFILE_BUCKETS 16
+#endif
+
+//! Entry points timed by CBORProfile.
+#define CBOR_PROFILE_ADD 0
+#define CBOR_PROFILE_APPEND 1
+#define CBOR_PROFILE_AT 2
+#define CBOR_PROFILE_FIND_BY_KEY 3
+#define CBOR_PROFILE_INDEX 4
+#define CBOR_PROFILE_CAST 5
+#define CBOR_PROFILE_N_API 6
+
+#ifdef YACL_PROFILE
+//! Time the rest of the enclosing block as a call to entry point `api`.
+#define YACL_PROFILE_SCOPE(api) CBORProfileScope yacl_profile_scope(api)
+#else
+#define YACL_PROFILE_SCOPE(api) ((void)0)
+#endif
+
+//! Function returning the current time, in ticks (such as Arduino `micros()`).
+typedef unsigned long (*cbor_profile_clock)();
+
+//! Latency statistics of an entry point.
+struct CBORProfileStats
+{
+	//! Number of calls.
+	unsigned long calls;
+	//! Total time spent, in ticks.
+	unsigned long long total;
+	//! Shortest call, in ticks.
+	unsigned long min;
+	//! Longest call, in ticks.
+	unsigned long max;
+	//! Number of calls per duration.
+	/*!
+	 * Bucket 0 counts calls shorter than 1 tick, and bucket i calls of
+	 * 2^(i-1) to 2^i - 1 ticks. The last bucket also counts longer calls.
+	 */
+	unsigned long histogram[CBOR_PROFILE_BUCKETS];
+};
+
+//! Latency profiling of the public entry points (see `YACL_PROFILE`).
+/*!
+ * Times `add()`, `append()`, `at()`, `find_by_key()`, `operator[]` and the
+ * conversion operators (including `as_num()`), with a clock given by the
+ * user:
+ * ```
+ * CBORProfile::set_clock(micros);
+ * ...
+ * CBORProfileStats stats = CBORProfile::get(CBOR_PROFILE_FIND_BY_KEY);
+ * Serial.println((unsigned long)(stats.total/stats.calls));
+ * ```
+ * Times are inclusive: the time of `operator[]` includes the time of the
+ * `find_by_key()` or `at()` it calls, which is also recorded. Nothing is
+ * recorded until a clock is set.
+ */
+class CBORProfile
+{
+	public:
+		//! Clock used to time calls (NULL if not set).
+		static cbor_profile_clock clock;
+		//! Statistics of each entry point.
+		static CBORProfileStats stats[CBOR_PROFILE_N_API];
+
+		//! Set the clock used to time calls.
+		/*!
+		 * \param _clock Function returning the current time in ticks, or
+		 * NULL to stop profiling.
+		 */
+		static void set_clock(cbor_profile_clock _clock) { clock = _clock; }
+
+		//! Get the statistics of an entry point.
+		/*!
+		 * \param api One of the `CBOR_PROFILE_*` entry points.
+		 */
+		static CBORProfileStats get(uint8_t api) { return stats[api]; }
+
+		//! Get the name of an entry point.
+		/*!
+		 * \param api One of the `CBOR_PROFILE_*` entry points.
+		 */
+		static const char* name(uint8_t api);
+
+		//! Clear the statistics of every entry point.
+		static void reset();
+
+		//! Record a call.
+		/*!
+		 * \param api One of the `CBOR_PROFILE_*` entry points.
+		 * \param elapsed Duration of the call, in ticks.
+		 */
+		static void record(uint8_t api, unsigned long elapsed);
+};
+
+//! Times a call from its construction to its destruction (see `YACL_PROFILE_SCOPE`).
+class CBORProfileScope
+{
+	protected:
+		uint8_t api;
+		unsigned long start;
+
+	public:
+		CBORProfileScope(uint8_t _api)
+			: api(_api), start((CBORProfile::clock != NULL)?CBORProfile::clock():0) {}
+
+		~CBORProfileScope()
+		{
+			if (CBORProfile::clock != NULL) {
+				CBORProfile::record(api, CBORProfile::clock() - start);
+			}
+		}
+};
+
+#endif
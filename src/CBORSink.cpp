@@ -0,0 +1,13 @@
+#include "CBORSink.h"
+
+bool CBORSink::write_sink(const uint8_t *data, size_t len)
+{
+	if ((len > 0) && !write_error) {
+		size_t written = write_cb(write_ctx, data, len);
+
+		n_written += written;
+		write_error = (written != len);
+	}
+
+	return !write_error;
+}
@@ -0,0 +1,88 @@
+#ifndef INCLUDED_CBORSINK_H
+#define INCLUDED_CBORSINK_H
+
+#include "CBOR.h"
+
+//! Function writing bytes to a sink (serial port, socket, file...).
+/*!
+ * \param context User pointer given to the writer constructor.
+ * \param data Pointer to the bytes to write.
+ * \param len Number of bytes to write.
+ * \return Number of bytes actually written.
+ */
+typedef size_t (*cbor_write_callback)(void *context, const uint8_t *data, size_t len);
+
+//! Base class of the writers to a sink (`CBORWriter` and `CBORJSONWriter`).
+/*!
+ * Holds the sink callback and its state. Derived classes stage their output
+ * in a buffer of their own, and write it to the sink with `flush()`.
+ */
+class CBORSink
+{
+	protected:
+		//! Sink callback.
+		cbor_write_callback write_cb;
+		//! Sink callback context.
+		void *write_ctx;
+		//! True if the sink failed to write some bytes.
+		bool write_error = false;
+		//! Number of bytes written to the sink so far.
+		size_t n_written = 0;
+
+		//! Sink callback adapter for objects with a `write(const uint8_t*, size_t)` method (such as Arduino `Print`).
+		template <typename S> static size_t write_to(void *sink, const uint8_t *data, size_t len)
+		{
+			return ((S*)sink)->write(data, len);
+		}
+
+		//! Construct a sink from a callback.
+		/*!
+		 * \param callback Function writing bytes to the sink.
+		 * \param context User pointer given to `callback`.
+		 */
+		CBORSink(cbor_write_callback callback, void *context)
+			: write_cb(callback), write_ctx(context) {}
+
+		//! Destructor (writers are not deleted through a CBORSink pointer).
+		~CBORSink() {}
+
+		//! Write bytes to the sink, unless it failed before.
+		/*!
+		 * \param data Pointer to the bytes to write.
+		 * \param len Number of bytes to write.
+		 * \return False if the sink failed (now or before), true otherwise.
+		 */
+		bool write_sink(const uint8_t *data, size_t len);
+
+		//! Write bytes to the sink, bypassing the staging buffer.
+		/*!
+		 * The staging buffer is flushed first.
+		 *
+		 * \param data Pointer to the bytes to write.
+		 * \param len Number of bytes to write.
+		 * \return False if the sink failed, true otherwise.
+		 */
+		bool write_raw(const uint8_t *data, size_t len) { return flush() && write_sink(data, len); }
+
+	public:
+		CBORSink(const CBORSink &obj) = delete;
+		CBORSink& operator=(const CBORSink &obj) = delete;
+
+		//! Write the content of the staging buffer to the sink.
+		/*!
+		 * \return False if the sink failed (now or before), true otherwise.
+		 */
+		virtual bool flush() = 0;
+
+		//! Get the number of bytes written to the sink so far.
+		/*!
+		 * \return Number of bytes written to the sink, not including the
+		 * bytes still in the staging buffer.
+		 */
+		size_t bytes_written() const { return n_written; }
+
+		//! Check if the sink failed to write some bytes.
+		bool error() const { return write_error; }
+};
+
+#endif
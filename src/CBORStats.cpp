@@ -0,0 +1,3 @@
+#include "CBORStats.h"
+
+CBORStats CBORStats::counters = CBORStats();
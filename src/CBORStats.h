@@ -0,0 +1,63 @@
+#ifndef INCLUDED_CBORSTATS_H
+#define INCLUDED_CBORSTATS_H
+#include <stddef.h>
+
+//! Define YACL_STATS (in the build flags, or here) to enable the counters of CBORStats.
+/*!
+ * It must be defined for the library as well as for the sketch. When it is
+ * not defined, the counters are never updated, and the library compiles to
+ * the same code as without instrumentation.
+ */
+//#define YACL_STATS
+
+#ifdef YACL_STATS
+//! Add `n` to a counter of CBORStats.
+#define YACL_STAT(counter, n) (CBORStats::counters.counter += (n))
+#else
+#define YACL_STAT(counter, n) ((void)0)
+#endif
+
+//! Instrumentation counters (see `YACL_STATS`).
+/*!
+ * Counts what encoding and decoding cost, for all CBOR objects since the
+ * last `reset()`:
+ * ```
+ * CBORStats::reset();
+ * CBORPair msg = ...;
+ * CBORStats stats = CBORStats::get();
+ * Serial.println(stats.allocations);
+ * ```
+ * Counters are not atomic: do not update CBOR objects from interrupts
+ * while reading them.
+ */
+struct CBORStats
+{
+	//! Number of blocks allocated (calls to `CBORAllocator::allocate()`).
+	size_t allocations;
+	//! Number of blocks resized (calls to `CBORAllocator::reallocate()`).
+	size_t reallocations;
+	//! Number of blocks freed (calls to `CBORAllocator::deallocate()`).
+	size_t deallocations;
+	//! Number of bytes allocated, or added to a block by `reallocate()`.
+	size_t bytes_allocated;
+	//! Number of bytes of encoded CBOR data copied.
+	/*!
+	 * Counts copies of already encoded items: copy constructors, parsing
+	 * constructors, `add(const CBOR&)` and `append(const CBOR&)`,
+	 * `canonicalize()`, and the elements moved by `encode_json()`.
+	 */
+	size_t bytes_copied;
+	//! Number of calls to `element_size()` (walks over encoded items).
+	size_t element_size_calls;
+
+	//! Counters updated by the library.
+	static CBORStats counters;
+
+	//! Get a snapshot of the counters.
+	static CBORStats get() { return counters; }
+
+	//! Set all the counters to 0.
+	static void reset() { counters = CBORStats(); }
+};
+
+#endif
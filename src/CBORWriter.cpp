@@ -0,0 +1,122 @@
+#include "CBORWriter.h"
+
+CBORWriter::CBORWriter(cbor_write_callback callback, void *context)
+	: CBORSink(callback, context)
+{
+	buffer_begin = staging;
+	w_ptr = staging;
+	max_buf_len = CBOR_WRITER_BUFFER_SIZE;
+	buffer_type = BUFFER_EXTERNAL;
+}
+
+bool CBORWriter::flush()
+{
+	write_sink(staging, length());
+
+	//Staging buffer is discarded if the sink failed
+	w_ptr = staging;
+
+	return !write_error;
+}
+
+bool CBORWriter::reserve(size_t len)
+{
+	if (write_error) {
+		return false;
+	}
+
+	if (len <= max_buf_len) {
+		return true;
+	}
+
+	//Bytes to be written after the current content
+	size_t requested_len = len - length();
+
+	if (!flush()) {
+		return false;
+	}
+
+	return (requested_len <= max_buf_len);
+}
+
+bool CBORWriter::add_byte(uint8_t byte)
+{
+	if (!reserve(length() + 1)) {
+		return false;
+	}
+
+	*(w_ptr++) = byte;
+
+	return true;
+}
+
+bool CBORWriter::add_string(uint8_t cbor_type, const uint8_t *value, size_t len)
+{
+	if (!encode_type_num(cbor_type, len)) {
+		return false;
+	}
+
+	if (len == 0) {
+		return true;
+	}
+
+	if (!reserve(length() + len)) {
+		//Does not fit in the staging buffer: write it as is
+		return write_raw(value, len);
+	}
+
+	memcpy(w_ptr, value, len*sizeof(uint8_t));
+	w_ptr += len;
+
+	return true;
+}
+
+bool CBORWriter::add_typed_array(const uint8_t *values, size_t num_ele, uint8_t elem_size,
+		uint8_t tag, bool swap)
+{
+	if (!swap) {
+		return encode_type_num(CBOR_TAG, tag)
+			&& add_string(CBOR_BYTES, values, num_ele*elem_size);
+	}
+
+	if (!encode_type_num(CBOR_TAG, tag) || !encode_type_num(CBOR_BYTES, num_ele*elem_size)) {
+		return false;
+	}
+
+	//Swap one element at a time in the staging buffer
+	for (size_t i=0 ; i < num_ele ; ++i) {
+		if (!reserve(length() + elem_size)) {
+			return false;
+		}
+		copy_typed_array(w_ptr, values, 1, elem_size, true);
+		w_ptr += elem_size;
+		values += elem_size;
+	}
+
+	return true;
+}
+
+bool CBORWriter::add(const char* value)
+{
+	return add_string(CBOR_TEXT, (const uint8_t*)value, strlen(value));
+}
+
+bool CBORWriter::add(const uint8_t* value, size_t len)
+{
+	return add_string(CBOR_BYTES, value, len);
+}
+
+bool CBORWriter::add(const CBOR &value)
+{
+	size_t len_cbor = value.length();
+
+	if (!reserve(length() + len_cbor)) {
+		return write_raw(value.to_CBOR(), len_cbor);
+	}
+
+	memcpy(w_ptr, value.to_CBOR(), len_cbor*sizeof(uint8_t));
+	YACL_STAT(bytes_copied, len_cbor);
+	w_ptr += len_cbor;
+
+	return true;
+}
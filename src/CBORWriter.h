@@ -0,0 +1,188 @@
+#ifndef INCLUDED_CBORWRITER_H
+#define INCLUDED_CBORWRITER_H
+
+#include "CBORSink.h"
+
+//! Size (in bytes) of the staging buffer of CBORWriter.
+#ifndef CBOR_WRITER_BUFFER_SIZE
+#define CBOR_WRITER_BUFFER_SIZE 32
+#endif
+
+//! A class to encode CBOR data directly to a sink.
+/*!
+ * Items are encoded into a small staging buffer, which is written to the
+ * sink whenever it is full. Strings and byte strings that do not fit in the
+ * staging buffer are written to the sink as is, so that memory usage does
+ * not depend on the size of the message.
+ *
+ * Composed items are encoded as a header followed by their elements:
+ * ```
+ * CBORWriter writer(Serial);
+ * writer.begin_map(2);
+ * writer.add("temp"); writer.add(21.5f);
+ * writer.add("samples"); writer.begin_array();
+ * for (int i=0 ; i < n ; ++i) {
+ * 	writer.add(samples[i]);
+ * }
+ * writer.end();
+ * writer.flush();
+ * ```
+ */
+class CBORWriter: protected CBOR, public CBORSink
+{
+	protected:
+		//! Staging buffer.
+		uint8_t staging[CBOR_WRITER_BUFFER_SIZE];
+
+		//! Add a single byte.
+		bool add_byte(uint8_t byte);
+
+		//! Add a header and a string (of type CBOR_TEXT or CBOR_BYTES).
+		bool add_string(uint8_t cbor_type, const uint8_t *value, size_t len);
+
+		//! Add an RFC 8746 typed array (see `CBOR::add_typed_array()`).
+		bool add_typed_array(const uint8_t *values, size_t num_ele, uint8_t elem_size,
+				uint8_t tag, bool swap);
+
+		//! Make room in the staging buffer.
+		/*!
+		 * Flushes the staging buffer if it cannot accomodate for the total
+		 * length given in parameter.
+		 *
+		 * \param len The requested buffer length.
+		 * \return True if the requested bytes fit in the staging buffer.
+		 */
+		bool reserve(size_t len);
+
+	public:
+		//! Construct a CBOR writer using a callback as sink.
+		/*!
+		 * \param callback Function writing bytes to the sink.
+		 * \param context User pointer given to `callback`.
+		 */
+		CBORWriter(cbor_write_callback callback, void *context = NULL);
+
+		//! Construct a CBOR writer using an object as sink.
+		/*!
+		 * \param sink Any object with a `write(const uint8_t*, size_t)` method,
+		 * such as `Serial` or a network client. It must outlive the writer.
+		 */
+		template <typename S> CBORWriter(S &sink)
+			: CBORWriter(write_to<S>, (void*)&sink) {}
+
+		//! Destructor (flushes the staging buffer).
+		~CBORWriter() { flush(); }
+
+		//! Write the content of the staging buffer to the sink.
+		/*!
+		 * \return False if the sink failed (now or before), true otherwise.
+		 */
+		bool flush();
+
+		using CBOR::add;
+
+		//! Add a CBOR TEXT (UTF-8 String).
+		/*!
+		 * \param value The string to encode.
+		 * \return False if anything goes wrong. True otherwise.
+		 */
+		bool add(const char* value);
+
+		//! Add a CBOR BYTES (Byte String).
+		/*!
+		 * \param value The byte string to encode.
+		 * \param len Length (in bytes) of the byte string.
+		 * \return False if anything goes wrong. True otherwise.
+		 */
+		bool add(const uint8_t* value, size_t len);
+
+		//! Add an already encoded CBOR object.
+		/*!
+		 * \param value The CBOR object to write.
+		 * \return False if anything goes wrong. True otherwise.
+		 */
+		bool add(const CBOR &value);
+
+		//! Add a CBOR TAG and its tagged item.
+		/*!
+		 * \param tag_value Tag value to be encoded.
+		 * \param tag_item The tagged CBOR item.
+		 * \return False if anything goes wrong. True otherwise.
+		 */
+		template <typename T> bool add(T tag_value, const CBOR& tag_item)
+		{
+			return add_tag(tag_value) && add(tag_item);
+		}
+
+		//! Add an RFC 8746 typed array.
+		/*!
+		 * In native byte order, elements that do not fit in the staging
+		 * buffer are written to the sink as is.
+		 *
+		 * \param values Pointer to the elements.
+		 * \param num_ele Number of elements.
+		 * \param big_endian True to encode big-endian elements, false for
+		 * little-endian (defaults to the native byte order).
+		 * \return False if anything goes wrong. True otherwise.
+		 */
+		template <typename T> bool add_typed_array(const T *values, size_t num_ele,
+				bool big_endian = CBOR_BIG_ENDIAN)
+		{
+			return add_typed_array((const uint8_t*)values, num_ele, sizeof(T),
+					typed_array_tag<T>(big_endian), (sizeof(T) > 1) && (big_endian != CBOR_BIG_ENDIAN));
+		}
+
+		//! Add a CBOR TAG header.
+		/*!
+		 * The tagged item is the next item added.
+		 *
+		 * \param tag_value Tag value to be encoded.
+		 * \return False if anything goes wrong. True otherwise.
+		 */
+		template <typename T> bool add_tag(T tag_value)
+		{
+			return encode_type_num(CBOR_TAG, tag_value);
+		}
+
+		//! Begin a CBOR ARRAY of known length.
+		/*!
+		 * The `num_ele` elements are the next `num_ele` items added.
+		 *
+		 * \param num_ele Number of elements of the array.
+		 * \return False if anything goes wrong. True otherwise.
+		 */
+		bool begin_array(size_t num_ele) { return encode_type_num(CBOR_ARRAY, num_ele); }
+
+		//! Begin a CBOR PAIR of known length.
+		/*!
+		 * The `num_ele` pairs are the next `2*num_ele` items added (key, value,
+		 * key, value...).
+		 *
+		 * \param num_ele Number of key/value pairs of the map.
+		 * \return False if anything goes wrong. True otherwise.
+		 */
+		bool begin_map(size_t num_ele) { return encode_type_num(CBOR_MAP, num_ele); }
+
+		//! Begin an indefinite-length CBOR ARRAY (to be closed with `end()`).
+		bool begin_array() { return add_byte(CBOR_ARRAY | CBOR_VAR_FOLLOWS); }
+
+		//! Begin an indefinite-length CBOR PAIR (to be closed with `end()`).
+		bool begin_map() { return add_byte(CBOR_MAP | CBOR_VAR_FOLLOWS); }
+
+		//! Begin an indefinite-length CBOR TEXT (to be closed with `end()`).
+		/*!
+		 * Chunks are then added as definite-length strings with `add()`.
+		 */
+		bool begin_string() { return add_byte(CBOR_TEXT | CBOR_VAR_FOLLOWS); }
+
+		//! Begin an indefinite-length CBOR BYTES (to be closed with `end()`).
+		/*!
+		 * Chunks are then added as definite-length byte strings with `add()`.
+		 */
+		bool begin_bytes() { return add_byte(CBOR_BYTES | CBOR_VAR_FOLLOWS); }
+
+		//! Close the last indefinite-length item.
+		bool end() { return add_byte(CBOR_BREAK); }
+};
+
+#endif
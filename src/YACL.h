@@ -2,7 +2,14 @@
 #define INCLUDED_YACL_H
 
 #include "CBOR.h"
+#include "CBORStats.h"
+#include "CBORProfile.h"
 #include "CBORArray.h"
 #include "CBORPair.h"
+#include "CBORFields.h"
+#include "CBORSink.h"
+#include "CBORWriter.h"
+#include "CBORParser.h"
+#include "CBORJSONWriter.h"
 
 #endif